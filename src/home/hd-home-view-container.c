@@ -73,6 +73,10 @@ struct _HdHomeViewContainerPrivate
 
   gboolean in_move;
 
+  /* whether the views taking part in a swipe are rendered from their
+   * TidyCachedGroup textures rather than live */
+  gboolean swipe_cached;
+
   /* GConf */
   GConfClient *gconf_client;
 
@@ -113,6 +117,49 @@ hd_home_view_container_update_previous_and_next_view (HdHomeViewContainer *self)
   priv->next_view = next_view;
 }
 
+/* Switch the current, previous and next views into swipe mode, where each
+ * of them is rendered once into a texture and scrolled as a whole, or back
+ * to live rendering. */
+static void
+hd_home_view_container_set_swipe_cached (HdHomeViewContainer *self,
+                                         gboolean             cached)
+{
+  HdHomeViewContainerPrivate *priv = self->priv;
+  guint i;
+
+  if (priv->swipe_cached == cached)
+    return;
+
+  /* The global live background is behind the views and their cache has
+   * no alpha, so we'd cover it up. */
+  if (cached && priv->live_bg)
+    return;
+
+  priv->swipe_cached = cached;
+  for (i = 0; i < MAX_HOME_VIEWS; i++)
+    {
+      HdHomeView *view = HD_HOME_VIEW (priv->views[i]);
+
+      if (!cached)
+        {
+          hd_home_view_set_swipe_cached (view, FALSE);
+          /* Don't keep caches of views we have left, and let the applets
+           * of the one we arrived at settle down again. */
+          if (i == priv->current_view)
+            hd_home_view_schedule_flatten (view);
+          else
+            hd_home_view_unflatten_applets (view);
+        }
+      else if (priv->active_views[i]
+               && (i == priv->current_view
+                   || i == priv->previous_view
+                   || i == priv->next_view)
+               /* keep animating live backgrounds */
+               && !hd_home_view_get_live_bg (view))
+        hd_home_view_set_swipe_cached (view, TRUE);
+    }
+}
+
 static void
 backgrounds_dir_changed (GFileMonitor		  *monitor,
                          GFile		          *monitor_file,
@@ -412,12 +459,14 @@ hd_home_view_container_set_live_bg (HdHomeViewContainer *container,
     {
       /* use this live background on all desktops and without scrolling */
       int i;
-      /* first remove all current live backgrounds */
+      /* first remove all current live backgrounds; flattened applets
+       * would hide this one behind the views' cache */
       for (i = 0; i < MAX_HOME_VIEWS; ++i)
         {
           hhview = HD_HOME_VIEW (priv->views[i]);
           if (hd_home_view_get_live_bg (hhview))
             hd_home_view_set_live_bg (hhview, NULL, FALSE);
+          hd_home_view_unflatten_applets (hhview);
         }
 
       if (priv->live_bg)
@@ -632,6 +681,7 @@ hd_home_view_container_allocate (ClutterActor          *self,
   guint i;
   ClutterActorBox child_box = { 0, };
   ClutterUnit offset = 0;
+  gboolean shown = FALSE;
 
   /* Chain up */
   CLUTTER_ACTOR_CLASS (hd_home_view_container_parent_class)->allocate (self,
@@ -675,18 +725,22 @@ hd_home_view_container_allocate (ClutterActor          *self,
             child_box.y2 += offset;
           }
 
-        clutter_actor_allocate (priv->views[i], &child_box, absolute_origin_changed);
-
         /* Make sure offscreen views are hidden. Views positioned offscreen
          * wouldn't be seen anyway, but they introduce extra overheads in
          * Clutter/GLES if they are CLUTTER_ACTOR_IS_VISIBLE. We use < rather
          * than <= here because given the positioning above, the clause would
-         * always be true otherwise */
+         * always be true otherwise. Don't bother allocating them either,
+         * they'll be allocated when they come back onscreen. */
         if ((child_box.y1 < width) &&
             (child_box.y2 > 0))
           {
             if (!CLUTTER_ACTOR_IS_VISIBLE(priv->views[i]))
-              clutter_actor_show(priv->views[i]);
+              {
+                clutter_actor_show(priv->views[i]);
+                shown = TRUE;
+              }
+            clutter_actor_allocate (priv->views[i], &child_box,
+                                    absolute_origin_changed);
           }
         else
           {
@@ -723,18 +777,22 @@ hd_home_view_container_allocate (ClutterActor          *self,
             child_box.x2 += offset;
           }
 
-        clutter_actor_allocate (priv->views[i], &child_box, absolute_origin_changed);
-
         /* Make sure offscreen views are hidden. Views positioned offscreen
          * wouldn't be seen anyway, but they introduce extra overheads in
          * Clutter/GLES if they are CLUTTER_ACTOR_IS_VISIBLE. We use < rather
          * than <= here because given the positioning above, the clause would
-         * always be true otherwise */
+         * always be true otherwise. Don't bother allocating them either,
+         * they'll be allocated when they come back onscreen. */
         if ((child_box.x1 < width) &&
             (child_box.x2 > 0))
           {
             if (!CLUTTER_ACTOR_IS_VISIBLE(priv->views[i]))
-              clutter_actor_show(priv->views[i]);
+              {
+                clutter_actor_show(priv->views[i]);
+                shown = TRUE;
+              }
+            clutter_actor_allocate (priv->views[i], &child_box,
+                                    absolute_origin_changed);
           }
         else
           {
@@ -743,6 +801,10 @@ hd_home_view_container_allocate (ClutterActor          *self,
           }
       }
   }
+
+  /* A live background may have come into sight. */
+  if (shown)
+    hd_comp_mgr_update_live_bgs (priv->comp_mgr);
 }
 
 static void
@@ -926,6 +988,11 @@ hd_home_view_container_set_offset (HdHomeViewContainer *container,
 
   priv->offset = CLUTTER_UNITS_TO_INT(offset);
 
+  /* The user started panning, it's fine to freeze the views until we have
+   * scrolled back. */
+  if (priv->offset)
+    hd_home_view_container_set_swipe_cached (container, TRUE);
+
   clutter_actor_queue_relayout (CLUTTER_ACTOR (container));
 }
 
@@ -950,8 +1017,7 @@ scroll_back_new_frame_cb (ClutterTimeline     *timeline,
 }
 
 static void
-scroll_back_completed_cb (ClutterTimeline     *timeline,
-                          HdHomeViewContainer *container)
+scroll_back_finish (HdHomeViewContainer *container)
 {
   HdHomeViewContainerPrivate *priv = container->priv;
   HdCompMgr *hmgr = HD_COMP_MGR (priv->comp_mgr);
@@ -972,6 +1038,16 @@ scroll_back_completed_cb (ClutterTimeline     *timeline,
   priv->in_move = FALSE;
 }
 
+static void
+scroll_back_completed_cb (ClutterTimeline     *timeline,
+                          HdHomeViewContainer *container)
+{
+  scroll_back_finish (container);
+
+  /* Views are at rest, render them live again. */
+  hd_home_view_container_set_swipe_cached (container, FALSE);
+}
+
 /* Velocity is the speed in pixels/second, and we attempt to set the scroll
  * speed accordingly */
 void
@@ -988,8 +1064,9 @@ hd_home_view_container_scroll_back (HdHomeViewContainer *container, gint velocit
   if (priv->timeline) {
     clutter_timeline_stop(priv->timeline);
     /* This will unref the timeline and switch desktops to what everything
-     * else is expecting */
-    scroll_back_completed_cb(priv->timeline, container);
+     * else is expecting.  Keep the views cached, we're about to move them
+     * again. */
+    scroll_back_finish(container);
   }
 
   offset = priv->offset + priv->offset_anim;
@@ -1037,6 +1114,7 @@ hd_home_view_container_scroll_back (HdHomeViewContainer *container, gint velocit
   scroll_back_new_frame_cb(priv->timeline, 0, container);
 
   priv->in_move = TRUE;
+  hd_home_view_container_set_swipe_cached (container, TRUE);
   clutter_timeline_start (priv->timeline);
 }
 
@@ -65,6 +65,10 @@
 
 #define HD_HOME_VIEW_PARALLAX_AMOUNT (hd_transition_get_double("home", "parallax", 1.3))
 
+/* Seconds an applet has to be without damage before it is flattened into
+ * the background; 0 disables flattening. */
+#define HD_HOME_VIEW_FLATTEN_TIMEOUT (hd_transition_get_int("home", "flatten_timeout", 5))
+
 enum
 {
   PROP_COMP_MGR = 1,
@@ -81,6 +85,10 @@ struct _HdHomeViewPrivate
   HdHomeViewContainer      *view_container;
   ClutterActor             *background_container;
   ClutterActor             *applets_container;
+  /* Applets which haven't changed for a while are moved here, so they are
+   * rendered into our cache together with the background. */
+  ClutterActor             *flat_applets;
+  guint                     n_flat_applets;
 
   ClutterActor             *background;
   TidySubTexture           *background_sub;
@@ -90,6 +98,11 @@ struct _HdHomeViewPrivate
   TidySubTexture           *background_sub_temp;
   MBWindowManagerClient    *live_bg;
 
+  /* While swiping, applets_container is moved into the view so that it is
+   * rendered into our cache; this is its sibling below it in 'front'. */
+  gboolean                  swipe_cached;
+  ClutterActor             *applets_container_below;
+
   GHashTable               *applets;
 
   gboolean                  is_portrait;
@@ -157,6 +170,7 @@ typedef struct _HdHomeViewAppletData HdHomeViewAppletData;
 
 struct _HdHomeViewAppletData
 {
+  HdHomeView   *view;
   ClutterActor *actor;
 
   MBWMCompMgrClient *cc;
@@ -169,12 +183,25 @@ struct _HdHomeViewAppletData
   ClutterActor *close_button;
   ClutterActor *configure_button;
   ClutterActor *resize_button;
+
+  /* Whether the applet is in flat_applets and when it will be moved there.
+   * The timeout keeps running while the applet changes, and just checks
+   * @last_change when it expires. */
+  gboolean flat;
+  guint flatten_source;
+  GTimeVal last_change;
 };
 
 static HdHomeViewAppletData *applet_data_new  (ClutterActor *actor);
 static void                  applet_data_free (HdHomeViewAppletData *data);
 
-G_DEFINE_TYPE (HdHomeView, hd_home_view, CLUTTER_TYPE_GROUP);
+static void applet_hook_damage      (HdHomeViewAppletData *data,
+                                     gboolean hook);
+static void applet_schedule_flatten (HdHomeViewAppletData *data);
+static void unflatten_applet        (HdHomeViewAppletData *data);
+static void hd_home_view_update_cache (HdHomeView *view);
+
+G_DEFINE_TYPE (HdHomeView, hd_home_view, TIDY_TYPE_CACHED_GROUP);
 
 static void
 hd_home_view_allocate (ClutterActor          *actor,
@@ -382,6 +409,11 @@ hd_home_view_constructed (GObject *object)
                            priv->background_container);
   clutter_container_add_actor (CLUTTER_CONTAINER (object), priv->background_container);
 
+  priv->flat_applets = clutter_group_new ();
+  clutter_actor_set_name (priv->flat_applets, "HdHomeView::flat-applets");
+  clutter_actor_set_visibility_detect(priv->flat_applets, FALSE);
+  clutter_container_add_actor (CLUTTER_CONTAINER (object), priv->flat_applets);
+
   priv->applets_container = clutter_group_new ();
   clutter_actor_set_name (priv->applets_container, "HdHomeView::applets-container");
   clutter_actor_set_visibility_detect(priv->applets_container, FALSE);
@@ -560,7 +592,7 @@ set_background_common (HdHomeView *hview, ClutterActor *new_bg)
 
     priv->background = new_bg;
     priv->background_sub = new_bg_sub;
-    
+    tidy_cached_group_changed (CLUTTER_ACTOR (hview));
 }
 
 static gboolean
@@ -765,6 +797,9 @@ hd_home_view_set_live_bg (HdHomeView *view,
         /* remove the old one */
         hd_home_view_set_live_bg (view, NULL, FALSE);
 
+      /* We'd freeze the live background by flattening applets over it */
+      hd_home_view_unflatten_applets (view);
+
       cclient = MB_WM_COMP_MGR_CLUTTER_CLIENT (client->cm_client);
       new_bg = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
       clutter_actor_set_reactive (new_bg, FALSE);
@@ -1572,6 +1607,7 @@ close_applet (HdHomeView *view, HdHomeViewAppletData *data)
   gchar *applet_key;
 
   /* Hide clutter actor */
+  unflatten_applet (data);
   clutter_actor_hide (data->actor);
 
   /* Unset GConf configuration */
@@ -1690,6 +1726,8 @@ hd_home_view_add_applet (HdHomeView   *view,
   clutter_actor_set_reactive (applet, TRUE);
 
   data = applet_data_new (applet);
+  data->view = view;
+  applet_hook_damage (data, TRUE);
 
   /* Add close button */
   close_button = hd_clutter_cache_get_texture ("AppletCloseButton.png", TRUE);
@@ -1790,6 +1828,9 @@ hd_home_view_add_applet (HdHomeView   *view,
       mb_wm_sync (MB_WM_COMP_MGR (priv->comp_mgr)->wm);
     }
   hd_home_view_restack_applets (view);
+
+  if (!STATE_IN_EDIT_MODE (hd_render_manager_get_state ()))
+    applet_schedule_flatten (data);
 }
 
 void
@@ -1829,6 +1870,11 @@ void
 hd_home_view_unregister_applet (HdHomeView *view, ClutterActor *applet)
 {
   HdHomeViewPrivate *priv = view->priv;
+  HdHomeViewAppletData *data;
+
+  /* Get it out of our cache */
+  if ((data = g_hash_table_lookup (priv->applets, applet)) != NULL)
+    unflatten_applet (data);
 
   g_hash_table_remove (priv->applets, applet);
 
@@ -1976,6 +2022,215 @@ hd_home_view_update_state (HdHomeView *view)
 	    clutter_actor_hide (data->resize_button);
         }
     }
+
+  /* The layout may have changed, start counting again. Applets are live
+   * in edit mode. */
+  hd_home_view_unflatten_applets (view);
+  if (!STATE_IN_EDIT_MODE (hd_render_manager_get_state ()))
+    hd_home_view_schedule_flatten (view);
+}
+
+/* Whether @data's applet overlaps any other visible applet of the view.
+ * Flattened applets are always below the live ones, so we can't flatten
+ * these without breaking the stacking. */
+static gboolean
+applet_overlaps_others (HdHomeViewAppletData *data)
+{
+  GHashTableIter iter;
+  gpointer value;
+  ClutterGeometry a, b;
+
+  clutter_actor_get_geometry (data->actor, &a);
+  g_hash_table_iter_init (&iter, data->view->priv->applets);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      HdHomeViewAppletData *other = value;
+
+      if (other == data || !CLUTTER_ACTOR_IS_VISIBLE (other->actor))
+        continue;
+
+      clutter_actor_get_geometry (other->actor, &b);
+      if (a.x < b.x + (gint)b.width && b.x < a.x + (gint)a.width &&
+          a.y < b.y + (gint)b.height && b.y < a.y + (gint)a.height)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+applet_flatten_timeout (HdHomeViewAppletData *data)
+{
+  HdHomeView *view = data->view;
+  HdHomeViewPrivate *priv = view->priv;
+  GTimeVal now;
+  glong quiet, timeout;
+
+  data->flatten_source = 0;
+
+  /* Has it changed since we were started?  Then wait for the rest. */
+  g_get_current_time (&now);
+  quiet = (now.tv_sec  - data->last_change.tv_sec)  * 1000
+        + (now.tv_usec - data->last_change.tv_usec) / 1000;
+  timeout = HD_HOME_VIEW_FLATTEN_TIMEOUT * 1000;
+  if (timeout <= 0)
+    return FALSE;
+  if (quiet >= 0 && quiet < timeout)
+    {
+      data->flatten_source = g_timeout_add (timeout - quiet,
+                                    (GSourceFunc) applet_flatten_timeout,
+                                    data);
+      return FALSE;
+    }
+
+  /* Only when home is at rest; in other states the applets are moved to
+   * the front (or faded) separately from the background. We're rescheduled
+   * by hd_home_view_update_state() when we get back to home. */
+  if (data->flat
+      || !STATE_IS_HOME (hd_render_manager_get_state ())
+      || priv->live_bg || priv->swipe_cached
+      || hd_home_view_container_get_live_bg (
+                                    hd_home_get_view_container (priv->home))
+      || !CLUTTER_ACTOR_IS_VISIBLE (data->actor)
+      || applet_overlaps_others (data))
+    return FALSE;
+
+  clutter_actor_reparent (data->actor, priv->flat_applets);
+  data->flat = TRUE;
+  priv->n_flat_applets++;
+
+  tidy_cached_group_changed (CLUTTER_ACTOR (view));
+  hd_home_view_update_cache (view);
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (view));
+
+  return FALSE;
+}
+
+/* (Re)start counting the time since the applet last changed.  This is
+ * called for every damage, so only start a timeout if none is running. */
+static void
+applet_schedule_flatten (HdHomeViewAppletData *data)
+{
+  guint timeout = HD_HOME_VIEW_FLATTEN_TIMEOUT;
+
+  g_get_current_time (&data->last_change);
+  if (!data->flatten_source && timeout > 0)
+    data->flatten_source = g_timeout_add_seconds (timeout,
+                                   (GSourceFunc) applet_flatten_timeout,
+                                   data);
+}
+
+/* Move the applet back among the live ones. */
+static void
+unflatten_applet (HdHomeViewAppletData *data)
+{
+  HdHomeView *view = data->view;
+  HdHomeViewPrivate *priv = view->priv;
+
+  if (data->flatten_source)
+    data->flatten_source = (g_source_remove (data->flatten_source), 0);
+  if (!data->flat)
+    return;
+
+  data->flat = FALSE;
+  priv->n_flat_applets--;
+  clutter_actor_reparent (data->actor, priv->applets_container);
+  hd_home_view_restack_applets (view);
+
+  tidy_cached_group_changed (CLUTTER_ACTOR (view));
+  hd_home_view_update_cache (view);
+  clutter_actor_queue_redraw (CLUTTER_ACTOR (view));
+}
+
+/* ClutterX11TexturePixmap::update-area handler.  The applet has changed,
+ * so it can't stay in the cache. */
+static void
+applet_damaged (HdHomeViewAppletData *data,
+                gint x, gint y, gint width, gint height,
+                ClutterActor *texture)
+{
+  if (data->flat)
+    unflatten_applet (data);
+  if (!STATE_IN_EDIT_MODE (hd_render_manager_get_state ()))
+    applet_schedule_flatten (data);
+}
+
+/* Connect or disconnect applet_damaged() to the texture pixmaps of
+ * the applet's actor, like hd_comp_mgr_hook_update_area() does. */
+static void
+applet_hook_damage (HdHomeViewAppletData *data, gboolean hook)
+{
+  ClutterActor *child;
+  gint i;
+
+  if (!data->actor || !CLUTTER_IS_GROUP (data->actor))
+    return;
+
+  for (i = 0, child = clutter_group_get_nth_child (CLUTTER_GROUP (data->actor), 0);
+       child;
+       child = clutter_group_get_nth_child (CLUTTER_GROUP (data->actor), ++i))
+    {
+      if (!CLUTTER_X11_IS_TEXTURE_PIXMAP (child))
+        continue;
+      if (hook)
+        g_signal_connect_swapped (child, "update-area",
+                                  G_CALLBACK (applet_damaged), data);
+      else
+        g_signal_handlers_disconnect_by_func (child, applet_damaged, data);
+    }
+}
+
+/* Use our TidyCachedGroup cache if there is anything to gain by it:
+ * while swiping or when some applets are flattened. */
+static void
+hd_home_view_update_cache (HdHomeView *view)
+{
+  HdHomeViewPrivate *priv = view->priv;
+  ClutterActor *actor = CLUTTER_ACTOR (view);
+
+  if (priv->swipe_cached || priv->n_flat_applets > 0)
+    {
+      tidy_cached_group_set_downsampling_factor (actor, 1);
+      tidy_cached_group_set_render_cache (actor, 1);
+    }
+  else
+    {
+      tidy_cached_group_set_render_cache (actor, 0);
+      tidy_cached_group_release_cache (actor);
+    }
+}
+
+/* Bring all flattened applets back to life and stop counting. */
+void
+hd_home_view_unflatten_applets (HdHomeView *view)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_return_if_fail (HD_IS_HOME_VIEW (view));
+
+  g_hash_table_iter_init (&iter, view->priv->applets);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    unflatten_applet (value);
+}
+
+/* Start counting for all live applets which aren't counting already. */
+void
+hd_home_view_schedule_flatten (HdHomeView *view)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_return_if_fail (HD_IS_HOME_VIEW (view));
+
+  g_hash_table_iter_init (&iter, view->priv->applets);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      HdHomeViewAppletData *data = value;
+
+      if (!data->flat && !data->flatten_source)
+        applet_schedule_flatten (data);
+    }
 }
 
 static HdHomeViewAppletData *
@@ -2005,6 +2260,9 @@ applet_data_free (HdHomeViewAppletData *data)
     data->resize_cb = (g_signal_handler_disconnect (data->actor, data->resize_cb), 0);
   if (data->motion_cb)
     data->motion_cb = (g_signal_handler_disconnect (data->actor, data->motion_cb), 0);
+  if (data->flatten_source)
+    data->flatten_source = (g_source_remove (data->flatten_source), 0);
+  applet_hook_damage (data, FALSE);
 
   data->actor = NULL;
   data->cc = NULL;
@@ -2028,6 +2286,10 @@ hd_home_view_allocation_changed (HdHomeView    *view,
   HdHomeViewPrivate *priv = view->priv;
   ClutterGeometry geom;
 
+  /* The applets are part of our cached texture, they follow us anyway. */
+  if (priv->swipe_cached)
+    return;
+
   /* We need to update the position of the applets container,
    * as it is not a child of ours. Rather than just setting
    * the X and Y to that of ourselves, we'll modify the offset
@@ -2072,6 +2334,64 @@ hd_home_view_allocation_changed (HdHomeView    *view,
   clutter_actor_set_position(priv->applets_container, geom.x, geom.y);
 }
 
+/* Render the background and the applets of @view into a single cached
+ * texture (or go back to rendering them live if !@cached). Used by the view
+ * container while swiping, so that every frame only has to draw one texture
+ * per view. The applets lose their parallax for the duration. */
+void
+hd_home_view_set_swipe_cached (HdHomeView *view, gboolean cached)
+{
+  HdHomeViewPrivate *priv;
+  ClutterActor *actor, *front;
+  GList *children, *l;
+
+  g_return_if_fail (HD_IS_HOME_VIEW (view));
+
+  priv = view->priv;
+  actor = CLUTTER_ACTOR (view);
+  if (priv->swipe_cached == cached)
+    return;
+
+  front = hd_home_get_front (priv->home);
+  if (cached)
+    {
+      /* Remember where the applets were in the stacking order of 'front' */
+      priv->applets_container_below = NULL;
+      children = clutter_container_get_children (CLUTTER_CONTAINER (front));
+      for (l = children; l && l->data != priv->applets_container; l = l->next)
+        priv->applets_container_below = l->data;
+      g_list_free (children);
+
+      priv->swipe_cached = TRUE;
+      clutter_actor_reparent (priv->applets_container, actor);
+      clutter_actor_set_position (priv->applets_container, 0, 0);
+
+      tidy_cached_group_changed (actor);
+      hd_home_view_update_cache (view);
+    }
+  else
+    {
+      priv->swipe_cached = FALSE;
+      tidy_cached_group_changed (actor);
+      hd_home_view_update_cache (view);
+
+      clutter_actor_reparent (priv->applets_container, front);
+
+      /* The sibling may have gone away in the meantime. */
+      children = clutter_container_get_children (CLUTTER_CONTAINER (front));
+      if (priv->applets_container_below
+          && g_list_find (children, priv->applets_container_below))
+        clutter_actor_raise (priv->applets_container,
+                             priv->applets_container_below);
+      else
+        clutter_actor_lower_bottom (priv->applets_container);
+      g_list_free (children);
+      priv->applets_container_below = NULL;
+
+      hd_home_view_allocation_changed (view, NULL, NULL);
+    }
+}
+
 /* ClutterStage::notify::allocation handler to rotate a background
  * container when we're going to or coming from portrait mode. */
 static void
@@ -2157,4 +2477,5 @@ hd_home_view_change_wallpaper(HdHomeView *view)
 
   priv->background = new_bg;
   priv->background_sub = new_bg_sub;
+  tidy_cached_group_changed (CLUTTER_ACTOR (view));
 }
@@ -32,6 +32,8 @@
 #include <matchbox/core/mb-wm.h>
 #include <matchbox/core/mb-wm-client.h>
 
+#include "../tidy/tidy-cached-group.h"
+
 #define MAX_HOME_VIEWS 9
 
 G_BEGIN_DECLS
@@ -49,12 +51,12 @@ typedef struct _HdHomeViewPrivate HdHomeViewPrivate;
 
 struct _HdHomeViewClass
 {
-  ClutterGroupClass parent_class;
+  TidyCachedGroupClass parent_class;
 };
 
 struct _HdHomeView
 {
-  ClutterGroup          parent;
+  TidyCachedGroup       parent;
 
   HdHomeViewPrivate    *priv;
 };
@@ -94,6 +96,10 @@ void hd_home_view_update_state (HdHomeView *view);
 void hd_home_view_change_applets_position (HdHomeView *view);
 void hd_home_view_change_wallpaper(HdHomeView *view);
 
+void hd_home_view_set_swipe_cached (HdHomeView *view, gboolean cached);
+void hd_home_view_unflatten_applets (HdHomeView *view);
+void hd_home_view_schedule_flatten (HdHomeView *view);
+
 G_END_DECLS
 
 #endif
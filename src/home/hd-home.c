@@ -42,6 +42,7 @@
 #include "hd-launcher-app.h"
 #include "hd-dbus.h"
 #include "hd-title-bar.h"
+#include "hd-screenshot.h"
 
 #include <clutter/clutter.h>
 #include <clutter/x11/clutter-x11.h>
@@ -51,7 +52,6 @@
 
 #include <gconf/gconf-client.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
-#include <gdk-pixbuf-xlib/gdk-pixbuf-xlib.h>
 
 #include <dbus/dbus-glib.h>
 #include <dbus/dbus-glib-bindings.h>
@@ -62,7 +62,6 @@
 #include <X11/XKBlib.h>
 #include <gdk/gdkx.h>
 #include <gdk/gdkkeysyms.h>
-#include <libhildondesktop/hd-pvr-texture.h>
 
 #define HDH_EDIT_BUTTON_DURATION 200
 #define HDH_EDIT_BUTTON_TIMEOUT 3000
@@ -1146,17 +1145,61 @@ hd_home_reset_fn_state (HdHome *home)
   home->priv->ignore_next_shift_release = FALSE;
 }
 
+/* Who to tell when a loading screenshot is finished. */
+typedef struct
+{
+  HdCompMgr *hmgr;
+  Window     xwin;
+  long       serial;
+} ScreenshotReply;
+
+/* Tell @xwin whether the operation it asked for has succeeded. */
+static void
+loading_screenshot_reply (HdCompMgr *hmgr, Window xwin, long serial,
+                          gboolean isok)
+{
+  MBWindowManager *wm = MB_WM_COMP_MGR (hmgr)->wm;
+  XEvent reply;
+
+  reply.xclient.type = ClientMessage;
+  reply.xclient.window = xwin;
+  reply.xclient.message_type = hd_comp_mgr_get_atom (hmgr,
+                               HD_ATOM_HILDON_LOADING_SCREENSHOT);
+  reply.xclient.format = 32;
+  reply.xclient.data.l[0] = serial;
+  reply.xclient.data.l[1] = isok;
+
+  mb_wm_util_async_trap_x_errors (wm->xdpy);
+  XSendEvent (wm->xdpy, reply.xclient.window, False,
+              NoEventMask, &reply);
+  XFlush (wm->xdpy);
+  mb_wm_util_async_untrap_x_errors ();
+}
+
+static void
+loading_screenshot_saved (const gchar *filename, gboolean saved,
+                          gpointer user_data)
+{
+  ScreenshotReply *reply = user_data;
+
+  loading_screenshot_reply (reply->hmgr, reply->xwin, reply->serial, saved);
+  g_free (reply);
+}
+
 /*
  * Create the loading screenshot of the application of @xwin which will
  * be put up the the application is started next or remove it.  If the
  * application already has a screenshot it's retained and we don't create
- * a new one.  If @take was requested returns whether a new screenshot
- * was taken, otherwise whether the screenshot was removed successfully.
- * Does nothing if @xwin doesn't have an application we know about.
+ * a new one.  @xwin is replied to with @serial when we're finished: if
+ * @take was requested whether a new screenshot was taken, otherwise
+ * whether the screenshot was removed successfully.  The screenshot is
+ * encoded and saved in the background.  Does nothing but reply if @xwin
+ * doesn't have an application we know about.
  */
-static gboolean
-take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
+static void
+take_screenshot (HdCompMgr *hmgr, Window xwin, gboolean take, long serial)
 {
+  MBWindowManager *wm = MB_WM_COMP_MGR (hmgr)->wm;
   MBWindowManagerClient *client;
   HdLauncherApp *launcher_app;
   const char *service_name;
@@ -1165,7 +1208,7 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
 
   client = mb_wm_managed_client_from_xwindow (wm, xwin);
   if (!client || !client->window)
-    return FALSE;
+    goto out;
 
   launcher_app = hd_comp_mgr_client_get_launcher (
                                 HD_COMP_MGR_CLIENT (client->cm_client));
@@ -1173,7 +1216,7 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
     {
       g_warning ("Window 0x%lx did not have an application associated"
                  " with it", client->window->xwindow);
-      return FALSE;
+      goto out;
     }
 
   service_name = hd_launcher_app_get_service (launcher_app);
@@ -1181,15 +1224,13 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
     {
       g_warning ("Window 0x%lx has no sane service name",
                  client->window->xwindow);
-      return FALSE; /* daft service name, don't get a loading pic */
+      goto out; /* daft service name, don't get a loading pic */
     }
 
   filename = g_strdup_printf ("%s/.cache/launch", getenv("HOME"));
   g_mkdir_with_parents (filename, 0770);
   g_free (filename);
 
-  isok = FALSE;
-
   if (STATE_IS_PORTRAIT(hd_render_manager_get_state()))
     filename = g_strdup_printf ("%s/.cache/launch/%s_portrait.pvr",
                                 getenv("HOME"), service_name);
@@ -1200,17 +1241,18 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
   if (take)
   {
     Pixmap                          pixmap;
-    GdkPixbuf                      *pixbuf;
     guint                           depth;
     guint                           width, height;
     ClutterActor                   *actor, *texture;
+    ScreenshotReply                *reply;
 
-    if (g_file_test (filename, G_FILE_TEST_EXISTS))
+    if (g_file_test (filename, G_FILE_TEST_EXISTS)
+        || hd_screenshot_is_pending (filename))
       {
         g_debug ("%s: not creating '%s', already exists",
                  __func__, filename);
         g_free (filename);
-        return FALSE;
+        goto out;
       }
 
     actor = mb_wm_comp_mgr_clutter_client_get_actor (
@@ -1226,16 +1268,28 @@ take_screenshot (MBWindowManager *wm, Window xwin, gboolean take)
     /* We could call mb_wm_theme_get_decor_dimensions() here and take out
      * the titlebar, etc, but in practice these aren't drawn on the loading
      * image so we have to keep them on. */
-    pixbuf = gdk_pixbuf_xlib_get_from_drawable (NULL, pixmap,
-                             xlib_rgb_get_cmap(), xlib_rgb_get_visual(),
-                             0, 0, 0, 0, width, height);
-    isok = hd_pvr_texture_save (filename, pixbuf, NULL);
-    g_object_unref (pixbuf);
-  } else
-    isok = unlink (filename) == 0;
+    reply = g_new (ScreenshotReply, 1);
+    reply->hmgr = hmgr;
+    reply->xwin = xwin;
+    reply->serial = serial;
+    isok = hd_screenshot_save (wm->xdpy, pixmap, depth, width, height,
+                               filename, HD_SCREENSHOT_PVR,
+                               loading_screenshot_saved, reply);
+    g_free (filename);
+    if (isok)
+      /* loading_screenshot_saved() will reply */
+      return;
+    g_free (reply);
+    goto out;
+  }
 
+  isok = unlink (filename) == 0;
   g_free (filename);
-  return isok;
+  loading_screenshot_reply (hmgr, xwin, serial, isok);
+  return;
+
+out:
+  loading_screenshot_reply (hmgr, xwin, serial, FALSE);
 }
 
 void
@@ -1266,25 +1320,9 @@ root_window_client_message (XClientMessageEvent *event, HdHome *home)
 
   if (event->message_type == hd_comp_mgr_get_atom (hmgr,
                                      HD_ATOM_HILDON_LOADING_SCREENSHOT))
-    {
-      XEvent reply;
-
-      /* Tell the client when the operation is complete. */
-      reply.xclient.type = ClientMessage;
-      reply.xclient.window = event->data.l[1];
-      reply.xclient.message_type = hd_comp_mgr_get_atom (hmgr,
-                                   HD_ATOM_HILDON_LOADING_SCREENSHOT);
-      reply.xclient.format = 32;
-      reply.xclient.data.l[0] = event->serial;
-      reply.xclient.data.l[1] = take_screenshot (wm, event->data.l[1],
-                                                 event->data.l[0] != 1);
-
-      mb_wm_util_async_trap_x_errors (wm->xdpy);
-      XSendEvent (wm->xdpy, reply.xclient.window, False,
-                  NoEventMask, &reply);
-      XFlush (wm->xdpy);
-      mb_wm_util_async_untrap_x_errors ();
-    }
+    /* Tell the client when the operation is complete. */
+    take_screenshot (hmgr, event->data.l[1], event->data.l[0] != 1,
+                     event->serial);
 }
 
 static ClutterActor *
@@ -2833,6 +2871,24 @@ hd_home_unregister_applet (HdHome       *home,
     hd_home_view_unregister_applet (view, applet);
 }
 
+/* Make all applets of all views live again, for states where the applets
+ * are moved to the front and can't be part of the background. */
+void
+hd_home_unflatten_applets (HdHome *home)
+{
+  HdHomePrivate *priv = home->priv;
+  guint i;
+
+  for (i = 0; i < MAX_VIEWS; i++)
+    {
+      ClutterActor *view;
+
+      view = hd_home_view_container_get_view (HD_HOME_VIEW_CONTAINER (priv->view_container),
+                                              i);
+      hd_home_view_unflatten_applets (HD_HOME_VIEW (view));
+    }
+}
+
 HdHomeViewContainer *hd_home_get_view_container(HdHome *home) {
 	return HD_HOME_VIEW_CONTAINER (home->priv->view_container);
 }
@@ -104,6 +104,7 @@ void hd_home_unregister_applet (HdHome       *home,
 void hd_home_set_live_background (HdHome *home, MBWindowManagerClient *client);
 
 void hd_home_update_applets_position (HdHome *home);
+void hd_home_unflatten_applets (HdHome *home);
 
 gboolean hd_home_is_portrait_capable (void);
 void hd_home_update_wallpaper (HdHome *home);
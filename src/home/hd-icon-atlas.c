@@ -0,0 +1,295 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include <string.h>
+
+#include "tidy/tidy-sub-texture.h"
+
+#include "hd-icon-atlas.h"
+
+/*
+ * The atlas is made of pages, each a square texture divided into equal
+ * cells.  Images are put into the pages whose cells they fit best,
+ * with a transparent gutter around them so filtering doesn't pick up
+ * the neighbours.  Entries are refcounted; unused ones are kept until
+ * their cell is needed for something else, least recently used first.
+ * Everything happens in the main thread.
+ */
+#define HD_ICON_ATLAS_PAGE_SIZE   512
+#define HD_ICON_ATLAS_MAX_CELL    (HD_ICON_ATLAS_PAGE_SIZE / 4)
+#define HD_ICON_ATLAS_GUTTER      1
+#define HD_ICON_ATLAS_ACTOR_ENTRY "HD-IconAtlasEntry"
+
+typedef struct
+{
+  ClutterActor       *texture;
+  guint               cell;
+  guint               per_row;
+  guint               n_used;
+  HdIconAtlasEntry  **slots;
+} HdIconAtlasPage;
+
+struct _HdIconAtlasEntry
+{
+  gchar              *key;
+  HdIconAtlasPage    *page;
+  guint               slot;
+  ClutterGeometry     region;
+
+  guint               refs;
+  GList              *unused_link;
+};
+
+static GHashTable *entries;                  /* key -> HdIconAtlasEntry */
+static GList      *pages;
+static GQueue      unused = { NULL, NULL, 0 }; /* most recently used first */
+
+#define N_SLOTS(page) ((page)->per_row * (page)->per_row)
+
+static HdIconAtlasPage *
+hd_icon_atlas_page_new (guint cell)
+{
+  HdIconAtlasPage *page;
+  CoglHandle handle;
+  guchar *clear;
+
+  handle = cogl_texture_new_with_size (HD_ICON_ATLAS_PAGE_SIZE,
+                                       HD_ICON_ATLAS_PAGE_SIZE, -1, FALSE,
+                                       COGL_PIXEL_FORMAT_RGBA_8888);
+  if (handle == COGL_INVALID_HANDLE)
+    return NULL;
+
+  /* New textures have undefined contents. */
+  clear = g_malloc0 (HD_ICON_ATLAS_PAGE_SIZE * HD_ICON_ATLAS_PAGE_SIZE * 4);
+  cogl_texture_set_region (handle, 0, 0, 0, 0,
+                           HD_ICON_ATLAS_PAGE_SIZE, HD_ICON_ATLAS_PAGE_SIZE,
+                           HD_ICON_ATLAS_PAGE_SIZE, HD_ICON_ATLAS_PAGE_SIZE,
+                           COGL_PIXEL_FORMAT_RGBA_8888,
+                           HD_ICON_ATLAS_PAGE_SIZE * 4, clear);
+  g_free (clear);
+
+  page = g_new0 (HdIconAtlasPage, 1);
+  page->texture = g_object_ref_sink (clutter_texture_new ());
+  clutter_actor_set_name (page->texture, "HdIconAtlas::page");
+  clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (page->texture), handle);
+  cogl_texture_unref (handle);
+
+  page->cell = cell;
+  page->per_row = HD_ICON_ATLAS_PAGE_SIZE / cell;
+  page->slots = g_new0 (HdIconAtlasEntry *, N_SLOTS (page));
+  pages = g_list_prepend (pages, page);
+
+  g_debug ("%s: %u pages, new one has %u cells of %u pixels", __FUNCTION__,
+           g_list_length (pages), N_SLOTS (page), cell);
+  return page;
+}
+
+static void
+hd_icon_atlas_entry_free (HdIconAtlasEntry *entry)
+{
+  entry->page->slots[entry->slot] = NULL;
+  entry->page->n_used--;
+  g_hash_table_remove (entries, entry->key);
+  g_free (entry->key);
+  g_free (entry);
+}
+
+/* Find a free cell of @cell pixels, making room if needed. */
+static gboolean
+hd_icon_atlas_find_slot (guint cell, HdIconAtlasPage **pagep, guint *slotp)
+{
+  HdIconAtlasPage *page;
+  GList *li;
+  guint i;
+
+  for (li = pages; li; li = li->next)
+    {
+      page = li->data;
+      if (page->cell != cell || page->n_used >= N_SLOTS (page))
+        continue;
+      for (i = 0; i < N_SLOTS (page); i++)
+        if (!page->slots[i])
+          {
+            *pagep = page;
+            *slotp = i;
+            return TRUE;
+          }
+    }
+
+  /* Take the cell of the least recently used entry of the same size. */
+  for (li = unused.tail; li; li = li->prev)
+    {
+      HdIconAtlasEntry *victim = li->data;
+
+      if (victim->page->cell != cell)
+        continue;
+
+      *pagep = victim->page;
+      *slotp = victim->slot;
+      g_queue_delete_link (&unused, li);
+      hd_icon_atlas_entry_free (victim);
+      return TRUE;
+    }
+
+  if (!(page = hd_icon_atlas_page_new (cell)))
+    return FALSE;
+  *pagep = page;
+  *slotp = 0;
+  return TRUE;
+}
+
+/* Returns a new reference to the entry of @key, or %NULL if it is not
+ * in the atlas. */
+HdIconAtlasEntry *
+hd_icon_atlas_lookup (const gchar *key)
+{
+  HdIconAtlasEntry *entry;
+
+  if (!entries || !(entry = g_hash_table_lookup (entries, key)))
+    return NULL;
+  return hd_icon_atlas_entry_ref (entry);
+}
+
+/*
+ * Put the @width x @height RGBA image @rgba in the atlas under @key and
+ * returns a reference to it.  @key must identify the contents; if it's
+ * already in the atlas, that entry is returned.  Returns %NULL if the
+ * image is too large for the atlas.
+ */
+HdIconAtlasEntry *
+hd_icon_atlas_insert (const gchar *key, guint width, guint height,
+                      const guchar *rgba, guint rowstride)
+{
+  HdIconAtlasEntry *entry;
+  HdIconAtlasPage *page;
+  CoglHandle handle;
+  guchar *pixels;
+  guint cell, slot, x, y, i;
+
+  if ((entry = hd_icon_atlas_lookup (key)) != NULL)
+    return entry;
+
+  cell = MAX (width, height) + 2 * HD_ICON_ATLAS_GUTTER;
+  cell = (cell + 7) & ~7;
+  if (cell > HD_ICON_ATLAS_MAX_CELL
+      || !hd_icon_atlas_find_slot (cell, &page, &slot))
+    return NULL;
+
+  /* Upload the whole cell, so the gutter and the rest are cleared. */
+  pixels = g_malloc0 (cell * cell * 4);
+  for (i = 0; i < height; i++)
+    memcpy (pixels + ((i + HD_ICON_ATLAS_GUTTER) * cell
+                      + HD_ICON_ATLAS_GUTTER) * 4,
+            rgba + i * rowstride, width * 4);
+  x = (slot % page->per_row) * cell;
+  y = (slot / page->per_row) * cell;
+  handle = clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (page->texture));
+  cogl_texture_set_region (handle, 0, 0, x, y, cell, cell, cell, cell,
+                           COGL_PIXEL_FORMAT_RGBA_8888, cell * 4, pixels);
+  g_free (pixels);
+
+  entry = g_new0 (HdIconAtlasEntry, 1);
+  entry->key = g_strdup (key);
+  entry->page = page;
+  entry->slot = slot;
+  entry->region.x = x + HD_ICON_ATLAS_GUTTER;
+  entry->region.y = y + HD_ICON_ATLAS_GUTTER;
+  entry->region.width = width;
+  entry->region.height = height;
+  entry->refs = 1;
+  page->slots[slot] = entry;
+  page->n_used++;
+
+  if (!entries)
+    entries = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_insert (entries, entry->key, entry);
+
+  return entry;
+}
+
+HdIconAtlasEntry *
+hd_icon_atlas_entry_ref (HdIconAtlasEntry *entry)
+{
+  if (entry->unused_link)
+    {
+      g_queue_delete_link (&unused, entry->unused_link);
+      entry->unused_link = NULL;
+    }
+  entry->refs++;
+  return entry;
+}
+
+/* Unused entries stay in the atlas until their cell is reused. */
+void
+hd_icon_atlas_entry_unref (HdIconAtlasEntry *entry)
+{
+  g_return_if_fail (entry->refs > 0);
+
+  if (--entry->refs > 0)
+    return;
+  g_queue_push_head (&unused, entry);
+  entry->unused_link = unused.head;
+}
+
+const gchar *
+hd_icon_atlas_entry_get_key (HdIconAtlasEntry *entry)
+{
+  return entry->key;
+}
+
+void
+hd_icon_atlas_entry_get_size (HdIconAtlasEntry *entry,
+                              guint *width, guint *height)
+{
+  *width = entry->region.width;
+  *height = entry->region.height;
+}
+
+/* Returns a new actor showing @entry, at its natural size.  The actor
+ * keeps a reference to @entry. */
+ClutterActor *
+hd_icon_atlas_entry_new_actor (HdIconAtlasEntry *entry)
+{
+  ClutterActor *actor;
+
+  actor = CLUTTER_ACTOR (tidy_sub_texture_new (NULL));
+  clutter_actor_set_name (actor, entry->key);
+  hd_icon_atlas_set_actor_entry (actor, entry);
+  clutter_actor_set_size (actor, entry->region.width, entry->region.height);
+  return actor;
+}
+
+/* Make @actor, from hd_icon_atlas_entry_new_actor(), show @entry.
+ * Its size is left alone. */
+void
+hd_icon_atlas_set_actor_entry (ClutterActor *actor, HdIconAtlasEntry *entry)
+{
+  TidySubTexture *sub = TIDY_SUB_TEXTURE (actor);
+
+  tidy_sub_texture_set_parent_texture (sub,
+                                       CLUTTER_TEXTURE (entry->page->texture));
+  tidy_sub_texture_set_region (sub, &entry->region);
+  /* This releases the previous entry, if any. */
+  g_object_set_data_full (G_OBJECT (actor), HD_ICON_ATLAS_ACTOR_ENTRY,
+                          hd_icon_atlas_entry_ref (entry),
+                          (GDestroyNotify) hd_icon_atlas_entry_unref);
+  clutter_actor_queue_redraw (actor);
+}
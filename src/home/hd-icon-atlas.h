@@ -0,0 +1,56 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Packs small images (icons) into a few large textures, so that drawing
+ * many of them doesn't need as many texture binds.  Images are shown
+ * with TidySubTextures of the atlas pages.
+ */
+
+#ifndef _HAVE_HD_ICON_ATLAS_H
+#define _HAVE_HD_ICON_ATLAS_H
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+typedef struct _HdIconAtlasEntry HdIconAtlasEntry;
+
+HdIconAtlasEntry *hd_icon_atlas_lookup      (const gchar *key);
+HdIconAtlasEntry *hd_icon_atlas_insert      (const gchar  *key,
+                                             guint         width,
+                                             guint         height,
+                                             const guchar *rgba,
+                                             guint         rowstride);
+HdIconAtlasEntry *hd_icon_atlas_entry_ref   (HdIconAtlasEntry *entry);
+void              hd_icon_atlas_entry_unref (HdIconAtlasEntry *entry);
+const gchar      *hd_icon_atlas_entry_get_key (HdIconAtlasEntry *entry);
+void              hd_icon_atlas_entry_get_size (HdIconAtlasEntry *entry,
+                                                guint *width,
+                                                guint *height);
+
+ClutterActor     *hd_icon_atlas_entry_new_actor (HdIconAtlasEntry *entry);
+void              hd_icon_atlas_set_actor_entry (ClutterActor     *actor,
+                                                 HdIconAtlasEntry *entry);
+
+G_END_DECLS
+
+#endif
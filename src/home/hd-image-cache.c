@@ -0,0 +1,412 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "hildon-desktop.h"
+#include "hd-image-cache.h"
+
+#undef  G_LOG_DOMAIN
+#define G_LOG_DOMAIN "hd-image-cache"
+
+/*
+ * Images are scaled to cover the requested size, keeping their aspect
+ * ratio, and the middle is cut out.  They are never scaled up.
+ *
+ * We watch the directories of the files rather than the files, because
+ * they may not exist yet, and are usually replaced rather than written.
+ * Every load has a serial number, so that if a file changes again while
+ * it's being loaded only the last version is taken.  Decoded images are
+ * kept for as long as somebody watches them.
+ */
+#define HD_IMAGE_CACHE_EVENTS \
+  (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+
+typedef struct
+{
+  gchar            *path;
+  gint              wd;
+  guint             users;
+} HdImageCacheDir;
+
+typedef struct
+{
+  HdImageCacheFunc  func;
+  gpointer          data;
+} HdImageCacheWatcher;
+
+typedef struct
+{
+  gchar            *fname;
+  HdImageCacheDir  *dir;
+  guint             width, height;
+
+  GdkPixbuf        *pixbuf;
+  guint             serial;
+  GSList           *watchers;
+} HdImageCacheEntry;
+
+typedef struct
+{
+  gchar            *fname;
+  guint             width, height;
+  guint             serial;
+  GdkPixbuf        *pixbuf;
+} HdImageCacheJob;
+
+static GHashTable *entries;  /* fname -> HdImageCacheEntry */
+static GHashTable *dirs;     /* path -> HdImageCacheDir */
+static GHashTable *wds;      /* wd -> HdImageCacheDir */
+static gint inofd = -1;
+
+static void
+hd_image_cache_notify (HdImageCacheEntry *entry)
+{
+  GSList *li, *next;
+
+  for (li = entry->watchers; li; li = next)
+    {
+      HdImageCacheWatcher *watcher = li->data;
+
+      next = li->next;
+      watcher->func (entry->fname, entry->pixbuf, watcher->data);
+    }
+}
+
+/* Runs in the main thread. */
+static gboolean
+hd_image_cache_loaded (gpointer data)
+{
+  HdImageCacheJob *job = data;
+  HdImageCacheEntry *entry;
+
+  entry = entries ? g_hash_table_lookup (entries, job->fname) : NULL;
+  if (entry && entry->serial == job->serial)
+    {
+      if (entry->pixbuf)
+        g_object_unref (entry->pixbuf);
+      entry->pixbuf = job->pixbuf;
+      g_debug ("%s: %s %s", __FUNCTION__, job->fname,
+               job->pixbuf ? "loaded" : "not there");
+      hd_image_cache_notify (entry);
+    }
+  else if (job->pixbuf)
+    /* Forgotten or outdated. */
+    g_object_unref (job->pixbuf);
+
+  g_free (job->fname);
+  g_slice_free (HdImageCacheJob, job);
+  return FALSE;
+}
+
+/* Runs in the worker thread, except if threads are disabled. */
+static void
+hd_image_cache_decode (gpointer data, gpointer unused)
+{
+  HdImageCacheJob *job = data;
+  GdkPixbuf *pixbuf;
+  GError *error;
+  guint sw, sh, dw, dh, cw, ch;
+  gdouble scale;
+
+  error = NULL;
+  if (!(pixbuf = gdk_pixbuf_new_from_file (job->fname, &error)))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("%s: %s", job->fname, error->message);
+      g_error_free (error);
+      goto out;
+    }
+
+  /* @dw x @dh is the scaled image, of which @cw x @ch is kept. */
+  sw = gdk_pixbuf_get_width (pixbuf);
+  sh = gdk_pixbuf_get_height (pixbuf);
+  scale = MAX ((gdouble)job->width / sw, (gdouble)job->height / sh);
+  scale = MIN (scale, 1);
+  dw = MAX (sw * scale, 1);
+  dh = MAX (sh * scale, 1);
+  cw = MIN (dw, job->width);
+  ch = MIN (dh, job->height);
+
+  if (scale < 1 || cw < dw || ch < dh)
+    {
+      /* Allocate the new pixbuf with the same properties as the old
+       * one has, gdk_pixbuf_scale() may not like it otherwise. */
+      job->pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
+                                    gdk_pixbuf_get_has_alpha (pixbuf),
+                                    gdk_pixbuf_get_bits_per_sample (pixbuf),
+                                    cw, ch);
+      gdk_pixbuf_scale (pixbuf, job->pixbuf, 0, 0, cw, ch,
+                        -(gdouble)(dw - cw) / 2, -(gdouble)(dh - ch) / 2,
+                        scale, scale, GDK_INTERP_BILINEAR);
+      g_object_unref (pixbuf);
+    }
+  else
+    job->pixbuf = pixbuf;
+
+out:
+  g_idle_add (hd_image_cache_loaded, job);
+}
+
+static void
+hd_image_cache_load (HdImageCacheEntry *entry)
+{
+  static GThreadPool *pool;
+  HdImageCacheJob *job;
+
+  job = g_slice_new0 (HdImageCacheJob);
+  job->fname  = g_strdup (entry->fname);
+  job->width  = entry->width;
+  job->height = entry->height;
+  job->serial = ++entry->serial;
+
+  /* One thread is enough, we don't want to compete with the compositor. */
+  if (!pool && !hd_disable_threads ())
+    pool = g_thread_pool_new (hd_image_cache_decode, NULL, 1, FALSE, NULL);
+  if (pool)
+    g_thread_pool_push (pool, job, NULL);
+  else
+    hd_image_cache_decode (job, NULL);
+}
+
+/* @entry's file is gone. */
+static void
+hd_image_cache_forget (HdImageCacheEntry *entry)
+{
+  /* Ignore what's being loaded. */
+  entry->serial++;
+  if (!entry->pixbuf)
+    return;
+
+  g_object_unref (entry->pixbuf);
+  entry->pixbuf = NULL;
+  hd_image_cache_notify (entry);
+}
+
+static gboolean
+hd_image_cache_inotified (GIOChannel *chnl, GIOCondition cond, gpointer unused)
+{
+  gchar buf[4096]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  const struct inotify_event *ev;
+  const gchar *p;
+  gssize len;
+
+  if ((len = read (inofd, buf, sizeof (buf))) < 0)
+    {
+      if (errno != EINTR && errno != EAGAIN)
+        g_warning ("%s: read: %s", __FUNCTION__, strerror (errno));
+      return TRUE;
+    }
+
+  for (p = buf; p < buf + len; p += sizeof (*ev) + ev->len)
+    {
+      HdImageCacheDir *dir;
+      HdImageCacheEntry *entry;
+      gchar *fname;
+
+      ev = (const struct inotify_event *)p;
+      if (!(dir = g_hash_table_lookup (wds, GINT_TO_POINTER (ev->wd))))
+        continue;
+
+      if (ev->mask & IN_IGNORED)
+        { /* The directory is gone. */
+          g_hash_table_remove (wds, GINT_TO_POINTER (ev->wd));
+          dir->wd = -1;
+          continue;
+        }
+      if (!ev->len)
+        continue;
+
+      fname = g_build_filename (dir->path, ev->name, NULL);
+      if ((entry = g_hash_table_lookup (entries, fname)) != NULL)
+        {
+          if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            hd_image_cache_load (entry);
+          else if (ev->mask & (IN_DELETE | IN_MOVED_FROM))
+            hd_image_cache_forget (entry);
+        }
+      g_free (fname);
+    }
+
+  return TRUE;
+}
+
+/* Start watching @dir if we aren't.  It may not exist yet, in which case
+ * we try again the next time it's asked for. */
+static void
+hd_image_cache_watch_dir (HdImageCacheDir *dir)
+{
+  if (dir->wd >= 0)
+    return;
+
+  if (inofd < 0)
+    {
+      GIOChannel *chnl;
+
+      if ((inofd = inotify_init ()) < 0)
+        {
+          g_warning ("inotify_init: %s", strerror (errno));
+          return;
+        }
+
+      chnl = g_io_channel_unix_new (inofd);
+      g_io_add_watch (chnl, G_IO_IN, hd_image_cache_inotified, NULL);
+      g_io_channel_unref (chnl);
+      wds = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+  if ((dir->wd = inotify_add_watch (inofd, dir->path,
+                                    HD_IMAGE_CACHE_EVENTS)) < 0)
+    {
+      if (errno != ENOENT)
+        g_warning ("inotify_add_watch(%s): %s", dir->path, strerror (errno));
+      return;
+    }
+
+  g_hash_table_insert (wds, GINT_TO_POINTER (dir->wd), dir);
+}
+
+static HdImageCacheDir *
+hd_image_cache_dir_ref (const gchar *fname)
+{
+  HdImageCacheDir *dir;
+  gchar *path;
+
+  if (!dirs)
+    dirs = g_hash_table_new (g_str_hash, g_str_equal);
+
+  path = g_path_get_dirname (fname);
+  if (!(dir = g_hash_table_lookup (dirs, path)))
+    {
+      dir = g_slice_new0 (HdImageCacheDir);
+      dir->path = path;
+      dir->wd = -1;
+      g_hash_table_insert (dirs, dir->path, dir);
+    }
+  else
+    g_free (path);
+
+  dir->users++;
+  hd_image_cache_watch_dir (dir);
+  return dir;
+}
+
+static void
+hd_image_cache_dir_unref (HdImageCacheDir *dir)
+{
+  if (--dir->users > 0)
+    return;
+
+  if (dir->wd >= 0)
+    {
+      inotify_rm_watch (inofd, dir->wd);
+      g_hash_table_remove (wds, GINT_TO_POINTER (dir->wd));
+    }
+  g_hash_table_remove (dirs, dir->path);
+  g_free (dir->path);
+  g_slice_free (HdImageCacheDir, dir);
+}
+
+/*
+ * Start watching @fname, which is to be shown at @width x @height.
+ * The image is loaded in the background and @func is called when it's
+ * ready or whenever it changes afterwards.  Returns the image if it's
+ * been loaded already, which you should ref if you want to keep.
+ * Everybody watching the same file should ask for the same size.
+ */
+GdkPixbuf *
+hd_image_cache_watch (const gchar *fname, guint width, guint height,
+                      HdImageCacheFunc func, gpointer data)
+{
+  HdImageCacheEntry *entry;
+  HdImageCacheWatcher *watcher;
+
+  g_return_val_if_fail (fname && func, NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+
+  if (!entries)
+    entries = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (!(entry = g_hash_table_lookup (entries, fname)))
+    {
+      entry = g_slice_new0 (HdImageCacheEntry);
+      entry->fname  = g_strdup (fname);
+      entry->dir    = hd_image_cache_dir_ref (fname);
+      entry->width  = width;
+      entry->height = height;
+      g_hash_table_insert (entries, entry->fname, entry);
+      hd_image_cache_load (entry);
+    }
+  else if (entry->dir->wd < 0)
+    { /* We may have missed changes. */
+      hd_image_cache_watch_dir (entry->dir);
+      hd_image_cache_load (entry);
+    }
+
+  watcher = g_slice_new (HdImageCacheWatcher);
+  watcher->func = func;
+  watcher->data = data;
+  entry->watchers = g_slist_append (entry->watchers, watcher);
+
+  return entry->pixbuf;
+}
+
+/* Undo hd_image_cache_watch(). */
+void
+hd_image_cache_unwatch (const gchar *fname, HdImageCacheFunc func,
+                        gpointer data)
+{
+  HdImageCacheEntry *entry;
+  GSList *li;
+
+  if (!entries || !(entry = g_hash_table_lookup (entries, fname)))
+    return;
+
+  for (li = entry->watchers; li; li = li->next)
+    {
+      HdImageCacheWatcher *watcher = li->data;
+
+      if (watcher->func == func && watcher->data == data)
+        {
+          entry->watchers = g_slist_delete_link (entry->watchers, li);
+          g_slice_free (HdImageCacheWatcher, watcher);
+          break;
+        }
+    }
+
+  if (entry->watchers)
+    return;
+
+  g_hash_table_remove (entries, entry->fname);
+  hd_image_cache_dir_unref (entry->dir);
+  if (entry->pixbuf)
+    g_object_unref (entry->pixbuf);
+  g_free (entry->fname);
+  g_slice_free (HdImageCacheEntry, entry);
+}
@@ -0,0 +1,52 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Keeps images from files decoded at the size they are shown, and
+ * reloads them when the files change.  Decoding and scaling is done
+ * in a worker thread, the files are watched with inotify.
+ */
+
+#ifndef _HAVE_HD_IMAGE_CACHE_H
+#define _HAVE_HD_IMAGE_CACHE_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+/* @pixbuf is the new image of @fname or %NULL if it's gone.
+ * Take a reference if you want to keep it. */
+typedef void (*HdImageCacheFunc) (const gchar *fname,
+                                  GdkPixbuf   *pixbuf,
+                                  gpointer     data);
+
+GdkPixbuf *hd_image_cache_watch   (const gchar      *fname,
+                                   guint             width,
+                                   guint             height,
+                                   HdImageCacheFunc  func,
+                                   gpointer          data);
+void       hd_image_cache_unwatch (const gchar      *fname,
+                                   HdImageCacheFunc  func,
+                                   gpointer          data);
+
+G_END_DECLS
+
+#endif
@@ -1010,6 +1010,8 @@ void hd_render_manager_sync_clutter_before ()
     ClutterActor *home_front = hd_home_get_front (priv->home);
     if (STATE_HOME_FRONT (priv->state))
       {
+        /* flattened applets would stay behind in the background */
+        hd_home_unflatten_applets (priv->home);
         if (clutter_actor_get_parent(home_front) !=
             CLUTTER_ACTOR (priv->blur_front))
           {
@@ -1054,6 +1056,9 @@ void hd_render_manager_sync_clutter_before ()
       STATE_IS_NON_COMP (priv->previous_state))
     hd_render_manager_set_visibilities();
 
+  /* The live background may be shown again or be allowed more frames. */
+  hd_comp_mgr_update_live_bgs (HD_COMP_MGR (priv->comp_mgr));
+
   /* Now look at what buttons we have showing, and add each visible button X
    * to the X input viewport. FIXME: Do we need this now HdTitleBar does it? */
   hd_render_manager_set_input_viewport();
@@ -1509,6 +1514,12 @@ void hd_render_manager_set_state(HDRMStateEnum state)
               if (mb_wm_comp_mgr_clutter_client_is_unredirected (c->cm_client))
                 mb_wm_comp_mgr_clutter_set_client_redirection (c->cm_client,
                                                                TRUE);
+
+              /* Unless a snapshot stands in for it in the switcher. */
+              if (hd_task_navigator_window_released (priv->task_nav,
+                    mb_wm_comp_mgr_clutter_client_get_actor (
+                          MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client))))
+                continue;
               mb_wm_comp_mgr_clutter_client_track_damage (
                     MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client), True);
             }
@@ -2928,6 +2939,9 @@ void hd_render_manager_set_visibilities()
 
   hd_render_manager_update_status_area(has_fullscreen);
   hd_render_manager_set_input_viewport();
+
+  /* Live backgrounds may have been uncovered. */
+  hd_comp_mgr_update_live_bgs (HD_COMP_MGR (priv->comp_mgr));
 }
 
 /* Called by hd-task-navigator when its state changes, as when notifications
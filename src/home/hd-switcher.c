@@ -950,6 +950,15 @@ hd_switcher_hibernate_window_actor (HdSwitcher   * switcher,
   hd_task_navigator_hibernate_window (priv->task_nav, actor);
 }
 
+void
+hd_switcher_current_window_actor_changed (HdSwitcher   * switcher,
+					  ClutterActor * old,
+					  ClutterActor * new)
+{
+  HdSwitcherPrivate *priv = HD_SWITCHER (switcher)->priv;
+  hd_task_navigator_current_window_changed (priv->task_nav, old, new);
+}
+
 static void
 hd_switcher_group_background_clicked (HdSwitcher   *switcher,
 				      ClutterActor *actor)
@@ -86,6 +86,10 @@ void hd_switcher_replace_window_actor (HdSwitcher   * switcher,
 void
 hd_switcher_hibernate_window_actor (HdSwitcher   * switcher,
 				    ClutterActor * actor);
+void
+hd_switcher_current_window_actor_changed (HdSwitcher   * switcher,
+					  ClutterActor * old,
+					  ClutterActor * new);
 
 void hd_switcher_item_selected (HdSwitcher *switcher,
                                 ClutterActor *actor);
@@ -17,6 +17,7 @@
  *     .windows                 #ClutterGroup
  *       .apwin                 #ClutterActor
  *       .dialogs               #ClutterActor
+ *       .snapshot              #ClutterTexture
  *     .video                   #ClutterTexture
  *   .notwin                    #ClutterGroup         notifications
  *     .background              #ClutterCloneTexture  or apps w/notifs
@@ -38,15 +39,16 @@
 
 /* Include files {{{ */
 #include <math.h>
-#include <errno.h>
 #include <string.h>
-#include <sys/stat.h>
 #include <sys/time.h>
 
 #include <gtk/gtk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <clutter/clutter.h>
+#include <clutter/x11/clutter-x11.h>
 #include <tidy/tidy-finger-scroll.h>
+#include <tidy/tidy-scrollable.h>
+#include <tidy/tidy-adjustment.h>
 
 #include <matchbox/core/mb-wm.h>
 #include <matchbox/comp-mgr/mb-wm-comp-mgr.h>
@@ -61,10 +63,13 @@
 #include "hd-render-manager.h"
 #include "hd-title-bar.h"
 #include "hd-clutter-cache.h"
+#include "hd-icon-atlas.h"
+#include "hd-image-cache.h"
 #include "hd-transition.h"
 #include "hd-theme.h"
 #include "hd-util.h"
 #include "hd-gtk-style.h"
+#include "hd-screenshot.h"
 #include "hd-app-mgr.h"
 /* }}} */
 
@@ -183,6 +188,22 @@
 #define NOTIFADE_OUT_DURATION     \
   hd_transition_get_int("task_nav", "notifade_out", 250)
 
+/* How many %EffectClosure:s to allocate at once. */
+#define EFFECT_POOL_CHUNK         64
+
+/* How many times a second to refresh the snapshots at most. */
+#define LIVE_THUMBS_RATE          \
+  hd_transition_get_int("task_nav", "live_thumbs_rate", 2)
+
+/* How often to check whether the transitions snapshot_work() waits for
+ * are over, in milliseconds. */
+#define SNAPSHOT_WORK_DELAY       100
+
+/* If this is set in the environment layout() reports how long it took
+ * for each number of thumbnails up to %LAYOUT_BENCHMARK_MAX. */
+#define LAYOUT_BENCHMARK_ENV_VAR  "HILDON_DESKTOP_LAYOUT_BENCHMARK"
+#define LAYOUT_BENCHMARK_MAX      30
+
 /*
  *  These are based on the UX Guidance.
  *
@@ -336,10 +357,17 @@ typedef struct
    *                  normally opaque.  Otherwise if thumb_has_notification()
    *                  @close_app_icon is normally transparent and hidden,
    *                  and the other is opaque.  Otherwise the opposit holds.
+   * -- @culled:      Whether @thwin is hidden because it's out of sight.
+   * -- @slot_x, @slot_y, @slot_size: Where and how large layout_thumbs()
+   *                  last laid out @thwin.  @slot_size is %NULL until
+   *                  it's laid out first.
    */
   ClutterActor        *thwin, *plate;
   ClutterActor        *title, *close;
   ClutterActor        *close_app_icon, *close_notif_icon;
+  gboolean             culled;
+  guint                slot_x, slot_y;
+  const GtkRequisition *slot_size;
 
   /* TODO This should go to a dynamically allocated structure like .tnote. */
   union
@@ -447,14 +475,34 @@ typedef struct
        * -- @video_fname: Where to look for the last-frame video screenshot
        *                  for this application.  Deduced from some property
        *                  in the application's .desktop file.
-       * -- @video_mtime: The last modification time of the image loaded as
-       *                  .video.  Used to decide if it should be refreshed.
+       *                  Watched through hd_image_cache_watch() for as
+       *                  long as the %Thumbnail lives.
        * -- @video:       The downsampled texture of the image loaded from
        *                  .video_fname or %NULL.
        */
       ClutterActor        *video;
-      const gchar         *video_fname;
-      time_t               video_mtime;
+      gchar               *video_fname;
+
+      /*
+       * -- @snapshot:    What .apwin looked like when the application last
+       *                  left the foreground, scaled down to thumbnail size
+       *                  and placed over .apwin in .windows, or %NULL.
+       *                  Shown instead of .apwin unless we're zooming in.
+       *                  Dropped when the application is back in the
+       *                  foreground, unless it's in hibernation.
+       * -- @snapshot_pending: Whether we're waiting for a snapshot.
+       * -- @snapshot_due: Whether snapshot_work() is to take a snapshot.
+       * -- @snapshot_dirty: Whether .apwin has changed since .snapshot
+       *                  was taken.  Such snapshots are retaken by
+       *                  refresh_snapshots() while we're active.
+       * -- @apwin_released: Whether the texture of .apwin is freed and
+       *                  not updated because .snapshot stands in for it.
+       */
+      ClutterActor        *snapshot;
+      gboolean             snapshot_pending;
+      gboolean             snapshot_due;
+      gboolean             snapshot_dirty;
+      gboolean             apwin_released;
     };
 
     /* Currently we don't have notification-specific fields. */
@@ -494,7 +542,8 @@ typedef struct
 } Flyops;
 
 /* For linear_effect(), resize_effect() and turnoff_effect(). */
-typedef struct
+typedef struct _EffectClosure EffectClosure;
+struct _EffectClosure
 {
   /*
    * @actor:                    The actor to be animated (refed).
@@ -502,16 +551,21 @@ typedef struct
    *                            a thwin.
    * @timeline:                 Used when one wants to cancel an effect
    *                            outside of the timeline.
-   * @new_frame_cb_id, @timeline_complete_cb_id:
-   *                            %ClutterTimeline signal handler IDs
-   *                            @new_frame_cb_id can be 0.
-   * @frame_fun:                Just about any value that can identify
+   * @frame_fun, @complete_fun: Called by effects_new_frame() and
+   *                            effects_completed() when @timeline
+   *                            ticks or completes.  @frame_fun can
+   *                            be %NULL.
+   * @completing:               Whether effects_completed() is about
+   *                            to call @complete_fun.
+   * @effectid:                 Just about any value that can identify
    *                            an effect.  Typically the effect's
-   *                            new-frame callback.  Can be %NULL.
+   *                            @frame_fun.  Can be %NULL.
    */
   ClutterActor *actor;
   ClutterTimeline *timeline;
-  gulong new_frame_cb_id, timeline_complete_cb_id;
+  void (*frame_fun)(ClutterTimeline *, gint, EffectClosure *);
+  void (*complete_fun)(ClutterTimeline *, EffectClosure *);
+  gboolean completing;
   gconstpointer effectid;
 
   /* Effect-specific context */
@@ -581,7 +635,7 @@ typedef struct
       ClutterActor *all_particles;
     };
   };
-} EffectClosure;
+};
 
 /* Used by add_effect_closure() to store what to call when the effect
  * completes. */
@@ -589,11 +643,11 @@ typedef struct
 {
   /* @fun(@actor, @funparam) is what is called eventually.
    * @fun is not %NULL, @actor is g_object_ref()ed.
-   * @handler_id identifies the signal handler. */
+   * @timeline is what it's waiting for, also refed. */
   ClutterEffectCompleteFunc    fun;
   ClutterActor                *actor;
   gpointer                     funparam;
-  gulong                       handler_id;
+  ClutterTimeline             *timeline;
 } EffectCompleteClosure;
 /* Clutter effect data structures }}} */
 /* Type definitions }}} */
@@ -725,6 +779,17 @@ static ClutterActor *Navigator, *Scroller;
 static GList *Thumbnails, *Notifications;
 static guint NThumbnails;
 static const GtkRequisition *Thumbsize;
+
+/*
+ * -- @Last_layout:       What @Thumbnails were last laid out by.
+ * -- @Shown_first, @Shown_last: The range of rows of @Last_layout
+ *                        that cull_thumbs() last left shown.
+ * -- @Recull_pending:    Whether cull_thumbs() will be called when
+ *                        the thumbnails land.
+ */
+static Layout Last_layout;
+static gint Shown_first, Shown_last = -1;
+static gboolean Recull_pending;
 /* Do we have notifications since we were last in task navigator? */
 static gboolean UnseenNotifications = FALSE;
 
@@ -740,14 +805,43 @@ static gboolean UnseenNotifications = FALSE;
 static ClutterTimeline *Fly_effect_timeline, *Zoom_effect_timeline;
 static ClutterEffectTemplate *Fly_effect, *Zoom_effect;
 
+/* The source of refresh_snapshots() while it's scheduled. */
+static guint Live_thumbs_timer;
+
+/* The source of snapshot_work() while it's scheduled. */
+static guint Snapshot_worker;
+
+/*
+ * Relayout costs if %LAYOUT_BENCHMARK_ENV_VAR is set, otherwise .timer
+ * is %NULL.  .touched is the number of thumbnails layout_thumbs() didn't
+ * leave alone last time, .nlayouts and .total are the number of layouts
+ * and the total time they took in seconds by the number of thumbnails.
+ */
+static struct
+{
+  GTimer *timer;
+  guint   touched;
+  guint   nlayouts[LAYOUT_BENCHMARK_MAX + 1];
+  gdouble total[LAYOUT_BENCHMARK_MAX + 1];
+} Layout_benchmark;
+
 /*
  * The list of currently running effects created with new_effect().
  * Practically these are all effects used for flying.  Used to learn
  * if a particular effect is already running and if so change it,
  * rather than dumbly adding a new effect and create races between
- * then two of them.  Contains pointers to %EffectClosure:s.
+ * then two of them, and to drive them.  Contains pointers to
+ * %EffectClosure:s.
+ *
+ * -- @Effect_pool:       Free %EffectClosure:s, allocated in chunks
+ *                        of %EFFECT_POOL_CHUNK and never freed.
+ * -- @Effect_closures:   %EffectCompleteClosure:s of add_effect_closure()
+ *                        waiting for their timelines to complete.
+ * -- @Completing:        Scratch space of effects_completed().
  */
 static GPtrArray *Effects;
+static GTrashStack *Effect_pool;
+static GPtrArray *Effect_closures, *Completing;
 
 /* gtkrc articles */
 static const gchar *LargeSystemFont, *SystemFont, *SmallSystemFont;
@@ -757,10 +851,10 @@ static ClutterColor NotificationTextColor, NotificationSecondaryTextColor;
 
 /* Program code */
 /* Graphics loading {{{ */
-/* Destroying @pixbuf, turns it into a #ClutterTexture.
+/* Destroying @pixbuf, turns it into a #ClutterTexture with @flags.
  * Returns %NULL on failure. */
 static ClutterActor *
-pixbuf2texture (GdkPixbuf *pixbuf)
+pixbuf2texture (GdkPixbuf *pixbuf, ClutterTextureFlags flags)
 {
   GError *err;
   gboolean isok;
@@ -786,7 +880,7 @@ pixbuf2texture (GdkPixbuf *pixbuf)
                                             gdk_pixbuf_get_height (pixbuf),
                                             gdk_pixbuf_get_rowstride (pixbuf),
                                             gdk_pixbuf_get_n_channels (pixbuf),
-                                            0, &err);
+                                            flags, &err);
   if (!isok)
     {
       g_warning ("clutter_texture_set_from_rgb_data: %s", err->message);
@@ -799,95 +893,25 @@ damage_control: __attribute__((unused))
   return texture;
 }
 
-/* Loads @fname, resizing and cropping it as necessary to fit
- * in a @aw x @ah rectangle.  Returns %NULL on error. */
+/* Returns an actor showing @pixbuf, which hd_image_cache_watch() has
+ * cropped to at most @aw/2 x @ah/2, as if it were @aw x @ah large. */
 static ClutterActor *
-load_image (char const * fname, guint aw, guint ah)
+pixbuf2video (GdkPixbuf * pixbuf, guint aw, guint ah)
 {
-  GError *err;
-  GdkPixbuf *pixbuf;
-  gint dx, dy;
-  gdouble dsx, dsy, scale;
-  guint vw, vh, sw, sh, dw, dh;
+  guint vw, vh, dw, dh;
   ClutterActor *final;
   ClutterActor *texture;
 
-  /* On error the caller sure has better recovery plan than an
-   * empty rectangle.  (ie. showing the real application window). */
-  err = NULL;
-  if (!(pixbuf = gdk_pixbuf_new_from_file (fname, &err)))
-    {
-      g_warning ("%s: %s", fname, err->message);
-      return NULL;
-    }
-
-  /* @sw, @sh := size in pixels of the untransformed image. */
-  sw = gdk_pixbuf_get_width (pixbuf);
-  sh = gdk_pixbuf_get_height (pixbuf);
+  /* pixbuf2texture() takes it over. */
+  if (!(texture = pixbuf2texture (g_object_ref (pixbuf), 0)))
+    return NULL;
 
-  /*
-   * @vw and @wh tell how many pixels should the image have at most
-   * in horizontal and vertical dimensions.  If the image would have
-   * more we will scale it down before we create its #ClutterTexture.
-   * This is to reduce texture memory consumption.
-   */
+  /* @vw x @vh is what the image was scaled for, @dw x @dh is what
+   * we've got.  They only differ if the image is smaller than that. */
   vw = aw / 2;
   vh = ah / 2;
-
-  /*
-   * Detemine if we need to and how much to scale @pixbuf.  If the image
-   * is larger than requested (@aw and @ah) then scale to the requested
-   * amount but do not scale more than @vw/@aw ie. what the memory saving
-   * would demand.  Instead crop it later.  If one direction needs more
-   * scaling than the other choose that factor.
-   */
-  dsx = dsy = 1;
-  if (sw > vw)
-    dsx = (gdouble)vw / MIN (aw, sw);
-  if (sh > vh)
-    dsy = (gdouble)vh / MIN (ah, sh);
-  scale = MIN (dsx, dsy);
-
-  /* If the image is too large (even if we scale it) crop the center.
-   * These are the final parameters to gdk_pixbuf_scale().
-   * @dw, @dh := the final pixel width and height. */
-  dx = dy = 0;
-  dw = sw * scale;
-  dh = sh * scale;
-
-  if (dw > vw)
-    {
-      dx = -(gint)(dw - vw) / 2;
-      dw = vw;
-    }
-
-  if (dh > vh)
-    {
-      dy = -(gint)(dh - vh) / 2;
-      dh = vh;
-    }
-
-  /* Crop and scale @pixbuf if we need to. */
-  if (scale < 1)
-    {
-      GdkPixbuf *tmp;
-
-      /* Make sure to allocate the new pixbuf with the same
-       * properties as the old one has, gdk_pixbuf_scale()
-       * may not like it otherwise. */
-      tmp = gdk_pixbuf_new (GDK_COLORSPACE_RGB,
-                            gdk_pixbuf_get_has_alpha (pixbuf),
-                            gdk_pixbuf_get_bits_per_sample (pixbuf),
-                            dw, dh);
-      gdk_pixbuf_scale (pixbuf, tmp, 0, 0,
-                        dw, dh, dx, dy, scale, scale,
-                        GDK_INTERP_BILINEAR);
-      g_object_unref (pixbuf);
-      pixbuf = tmp;
-    }
-
-  if (!(texture = pixbuf2texture (pixbuf)))
-    return NULL;
+  dw = gdk_pixbuf_get_width (pixbuf);
+  dh = gdk_pixbuf_get_height (pixbuf);
 
   /* If @pixbuf is smaller than desired place it centered
    * on a @vw x @vh size black background. */
@@ -917,58 +941,146 @@ load_image (char const * fname, guint aw, guint ah)
   return final;
 }
 
-/* Loads an icon as a #ClutterTexture.  Returns %NULL on error. */
-static ClutterActor *
+/* Make @apthumb's .video show @pixbuf, or drop it if it's %NULL. */
+static void
+set_video (Thumbnail * apthumb, GdkPixbuf * pixbuf)
+{
+  if (apthumb->video)
+    {
+      clutter_container_remove_actor (CLUTTER_CONTAINER (apthumb->prison),
+                                      apthumb->video);
+      apthumb->video = NULL;
+    }
+
+  if (pixbuf)
+    {
+      /* Make it appear as if .video were .apwin,
+       * having the same geometry. */
+      apthumb->video = pixbuf2video (pixbuf,
+                                     App_window_geometry_width,
+                                     App_window_geometry_height);
+      if (apthumb->video)
+        {
+          clutter_actor_set_name (apthumb->video, "video");
+          clutter_actor_set_position (apthumb->video,
+                                      App_window_geometry_x,
+                                      App_window_geometry_y);
+          clutter_container_add_actor (CLUTTER_CONTAINER (apthumb->prison),
+                                       apthumb->video);
+        }
+    }
+
+  /* If we have claimed .apwin show either it or the .video. */
+  if (hd_task_navigator_is_active ())
+    {
+      if (!apthumb->video)
+        clutter_actor_show (apthumb->windows);
+      else
+        clutter_actor_hide (apthumb->windows);
+    }
+}
+
+/* #HdImageCacheFunc for an application's video screenshot. */
+static void
+video_changed (const gchar * fname, GdkPixbuf * pixbuf, Thumbnail * apthumb)
+{
+  set_video (apthumb, pixbuf);
+}
+
+/* Loads an icon for the icon atlas, scaled down to @isize if it's
+ * larger.  Returns %NULL on error. */
+static GdkPixbuf *
 load_icon (const gchar * iname, guint isize)
 {
   static const gchar *anyad[2];
   GtkIconInfo *icinf;
-  ClutterActor *icon;
+  GdkPixbuf *pixbuf;
+  const gchar *fname;
+  gint w, h;
 
   anyad[0] = iname;
   if (!(icinf = gtk_icon_theme_choose_icon (gtk_icon_theme_get_default (),
                                            anyad, isize, 0)))
     return NULL;
 
-  icon = (iname = gtk_icon_info_get_filename (icinf)) != NULL
-    ? clutter_texture_new_from_file (iname, NULL) : NULL;
+  /* Scalable and oversized icons are loaded at @isize, others as they
+   * are, like clutter_texture_new_from_file() used to. */
+  pixbuf = NULL;
+  if ((fname = gtk_icon_info_get_filename (icinf)) != NULL)
+    pixbuf = gdk_pixbuf_get_file_info (fname, &w, &h)
+        && ((guint)w > isize || (guint)h > isize)
+      ? gdk_pixbuf_new_from_file_at_size (fname, isize, isize, NULL)
+      : gdk_pixbuf_new_from_file (fname, NULL);
   gtk_icon_info_free (icinf);
+  if (!pixbuf)
+    return NULL;
 
-  return icon;
+  if (!gdk_pixbuf_get_has_alpha (pixbuf))
+    {
+      GdkPixbuf *rgba;
+
+      rgba = gdk_pixbuf_add_alpha (pixbuf, FALSE, 0, 0, 0);
+      g_object_unref (pixbuf);
+      pixbuf = rgba;
+    }
+
+  return pixbuf;
 }
 
 /* Searches for an icon with name @iname and size @isize.
  * If it can't find or load it returns a hidden actor.
- * Otherwise the icon's texture is cached. */
+ * Otherwise the icon is put in the icon atlas, or if it doesn't fit
+ * there, in a texture of its own. */
 static ClutterActor *
 get_icon (const gchar * iname, guint isize)
 {
-  static GHashTable *cache;
-  ClutterActor *icon;
+  static GHashTable *textures;
+  HdIconAtlasEntry *entry;
+  ClutterActor *icon, *texture;
+  GdkPixbuf *pixbuf;
   gchar *ikey;
   guint w, h;
 
   if (!iname)
     goto out;
 
-  /* Is it cached?  We can't use %HdClutterCache because that doesn't
-   * handle icons and we may need to load the same icon with different
-   * sizes. */
+  /* Is it loaded?  We may need to load the same icon with different
+   * sizes, so they are kept separately. */
+  icon = NULL;
   ikey = g_strdup_printf ("%s-%u", iname, isize);
-  if (cache && (icon = g_hash_table_lookup (cache, ikey)) != NULL)
-    { /* Yeah */
-      g_free (ikey);
+  if ((entry = hd_icon_atlas_lookup (ikey)) != NULL)
+    {
+      icon = hd_icon_atlas_entry_new_actor (entry);
+      hd_icon_atlas_entry_unref (entry);
     }
-  else if ((icon = load_icon (iname, isize)) != NULL)
-    { /* No, but we could load it. */
-      if (!cache)
-        cache = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                       g_free, g_object_unref);
-      g_hash_table_insert (cache, ikey, icon);
+  else if (textures && (texture = g_hash_table_lookup (textures, ikey)))
+    icon = clutter_clone_texture_new (CLUTTER_TEXTURE (texture));
+  else if ((pixbuf = load_icon (iname, isize)) != NULL)
+    {
+      if ((entry = hd_icon_atlas_insert (ikey,
+                                         gdk_pixbuf_get_width (pixbuf),
+                                         gdk_pixbuf_get_height (pixbuf),
+                                         gdk_pixbuf_get_pixels (pixbuf),
+                                         gdk_pixbuf_get_rowstride (pixbuf))))
+        {
+          g_object_unref (pixbuf);
+          icon = hd_icon_atlas_entry_new_actor (entry);
+          hd_icon_atlas_entry_unref (entry);
+        }
+      else if ((texture = pixbuf2texture (pixbuf, 0)) != NULL)
+        { /* The atlas didn't take it. */
+          if (!textures)
+            textures = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, g_object_unref);
+          g_hash_table_insert (textures, g_strdup (ikey),
+                               g_object_ref_sink (texture));
+          icon = clutter_clone_texture_new (CLUTTER_TEXTURE (texture));
+        }
     }
-  else
+  g_free (ikey);
+
+  if (!icon)
     { /* Couldn't load it. */
-      g_free (ikey);
       g_critical ("%s: failed to load icon", iname);
       goto out;
     }
@@ -976,7 +1088,6 @@ get_icon (const gchar * iname, guint isize)
   /* Icon found.  Set its anchor such that if @icon's real size differs
    * from the requested @isize then @icon would look as if centered on
    * an @isize large area. */
-  icon = clutter_clone_texture_new (CLUTTER_TEXTURE (icon));
   clutter_actor_set_name (icon, iname);
   clutter_actor_get_size (icon, &w, &h);
   clutter_actor_move_anchor_point (icon,
@@ -1062,8 +1173,105 @@ has_effect (ClutterActor * actor, gconstpointer effectid)
   return NULL;
 }
 
-/* Allocates an #EffectClosure and fills in the common fields.
- * Adds signals to @timeline. */
+/* @timeline's "new-frame" handler driving all of its effects. */
+static void
+effects_new_frame (ClutterTimeline * timeline, gint frame, gpointer unused)
+{
+  guint i;
+  EffectClosure *closure;
+
+  /* Frame functions don't start or stop effects. */
+  for (i = 0; i < Effects->len; i++)
+    {
+      closure = g_ptr_array_index (Effects, i);
+      if (closure->timeline == timeline && closure->frame_fun)
+        closure->frame_fun (timeline, frame, closure);
+    }
+}
+
+/* @timeline's "completed" handler.  Completes all of its effects,
+ * then calls what add_effect_closure() has been asked to. */
+static void
+effects_completed (ClutterTimeline * timeline, gpointer unused)
+{
+  guint i, base, end;
+  EffectClosure *closure;
+  EffectCompleteClosure *ecc;
+
+  /* Completion functions may start and stop effects, possibly of other
+   * timelines, so collect what to complete first.  Those stopped in the
+   * meantime are unmarked by free_effect(). */
+  base = Completing->len;
+  for (i = 0; i < Effects->len; i++)
+    {
+      closure = g_ptr_array_index (Effects, i);
+      if (closure->timeline == timeline)
+        {
+          closure->completing = TRUE;
+          g_ptr_array_add (Completing, closure);
+        }
+    }
+
+  end = Completing->len;
+  for (i = base; i < end; i++)
+    {
+      closure = g_ptr_array_index (Completing, i);
+      if (closure->completing)
+        {
+          closure->completing = FALSE;
+          closure->complete_fun (timeline, closure);
+        }
+    }
+
+  /* Likewise, those added in the meantime wait for the next time. */
+  for (i = 0; i < Effect_closures->len; )
+    {
+      ecc = g_ptr_array_index (Effect_closures, i);
+      if (ecc->timeline == timeline)
+        {
+          g_ptr_array_remove_index_fast (Effect_closures, i);
+          g_ptr_array_add (Completing, ecc);
+        }
+      else
+        i++;
+    }
+
+  for (i = end; i < Completing->len; i++)
+    {
+      ecc = g_ptr_array_index (Completing, i);
+      ecc->fun (ecc->actor, ecc->funparam);
+      g_object_unref (ecc->actor);
+      g_object_unref (ecc->timeline);
+      g_slice_free (EffectCompleteClosure, ecc);
+    }
+
+  g_ptr_array_set_size (Completing, base);
+}
+
+/* Have effects_new_frame() and effects_completed() drive @timeline's
+ * effects unless they do already. */
+static void
+hook_timeline (ClutterTimeline * timeline)
+{
+  if (G_UNLIKELY (!Effects))
+    {
+      Effects = g_ptr_array_sized_new (EFFECT_POOL_CHUNK);
+      Effect_closures = g_ptr_array_new ();
+      Completing = g_ptr_array_sized_new (EFFECT_POOL_CHUNK);
+    }
+
+  if (g_object_get_data (G_OBJECT (timeline), "HD-Effects-Hooked"))
+    return;
+  g_signal_connect (timeline, "new-frame",
+                    G_CALLBACK (effects_new_frame), NULL);
+  g_signal_connect (timeline, "completed",
+                    G_CALLBACK (effects_completed), NULL);
+  g_object_set_data (G_OBJECT (timeline), "HD-Effects-Hooked",
+                     GINT_TO_POINTER (TRUE));
+}
+
+/* Takes an #EffectClosure from @Effect_pool and fills in the common
+ * fields.  Starts @timeline. */
 static EffectClosure *
 new_effect (ClutterTimeline * timeline, ClutterActor * actor,
   void (*frame_fun)(ClutterTimeline *, gint, EffectClosure *),
@@ -1071,25 +1279,27 @@ new_effect (ClutterTimeline * timeline, ClutterActor * actor,
 {
   EffectClosure *closure;
 
-  closure = g_slice_new0 (EffectClosure);
-  closure->actor = g_object_ref (actor);
+  if (G_UNLIKELY (!Effect_pool))
+    {
+      EffectClosure *chunk;
+      guint i;
 
-  if (frame_fun)
-    closure->new_frame_cb_id = g_signal_connect (timeline, "new-frame",
-                                                 G_CALLBACK (frame_fun),
-                                                 closure);
-  else
-    closure->new_frame_cb_id = 0;
-  closure->timeline_complete_cb_id = g_signal_connect (timeline, "completed",
-                                              G_CALLBACK (complete_fun),
-                                              closure);
+      chunk = g_new (EffectClosure, EFFECT_POOL_CHUNK);
+      for (i = 0; i < EFFECT_POOL_CHUNK; i++)
+        g_trash_stack_push (&Effect_pool, &chunk[i]);
+    }
+
+  closure = g_trash_stack_pop (&Effect_pool);
+  memset (closure, 0, sizeof (*closure));
+  closure->actor = g_object_ref (actor);
+  closure->frame_fun = frame_fun;
+  closure->complete_fun = complete_fun;
 
+  hook_timeline (timeline);
   closure->timeline = g_object_ref (timeline);
   clutter_timeline_start (timeline);
 
   /* Register @closure in @Effects. */
-  if (G_UNLIKELY (!Effects))
-    Effects = g_ptr_array_new ();
   closure->effectid = frame_fun;
   g_ptr_array_add (Effects, closure);
 
@@ -1108,12 +1318,10 @@ free_effect (ClutterTimeline * timeline, EffectClosure * closure)
     g_critical ("closure not in Effects");
   g_assert (timeline == closure->timeline);
 
-  if (closure->new_frame_cb_id)
-    g_signal_handler_disconnect (timeline, closure->new_frame_cb_id);
-  g_signal_handler_disconnect (timeline, closure->timeline_complete_cb_id);
+  closure->completing = FALSE;
   g_object_unref (timeline);
   g_object_unref (closure->actor);
-  g_slice_free (EffectClosure, closure);
+  g_trash_stack_push (&Effect_pool, closure);
 }
 /* General }}} */
 
@@ -1183,19 +1391,8 @@ linear_effect_value (const EffectClosure * closure, guint which, gfloat now)
 /* Linear effects }}} */
 
 /* Effect closures {{{ */
-/* add_effect_closure()'s #ClutterTimeline::completed handler. */
-static void
-call_effect_closure (ClutterTimeline * timeline,
-                     EffectCompleteClosure *closure)
-{
-  g_signal_handler_disconnect (timeline, closure->handler_id);
-  closure->fun (closure->actor, closure->funparam);
-  g_object_unref (closure->actor);
-  g_slice_free (EffectCompleteClosure, closure);
-}
-
 /* If @fun is not %NULL call it with @actor and @funparam when
- * @timeline is "completed".  Otherwise NOP. */
+ * @timeline is "completed", after its effects.  Otherwise NOP. */
 static void
 add_effect_closure (ClutterTimeline * timeline,
                     ClutterEffectCompleteFunc fun,
@@ -1206,13 +1403,13 @@ add_effect_closure (ClutterTimeline * timeline,
   if (!fun)
     return;
 
+  hook_timeline (timeline);
   closure = g_slice_new (EffectCompleteClosure);
   closure->fun        = fun;
   closure->actor      = g_object_ref (actor);
   closure->funparam   = funparam;
-  closure->handler_id = g_signal_connect (timeline, "completed",
-                                          G_CALLBACK (call_effect_closure),
-                                          closure);
+  closure->timeline   = g_object_ref (timeline);
+  g_ptr_array_add (Effect_closures, closure);
 }
 /* Effect closures }}} */
 /* }}} */
@@ -2212,7 +2409,9 @@ layout_notwin (Thumbnail * thumb, const GtkRequisition * oldthsize,
  * Lays out @Thumbnails on @Grid, and their inner portions.  Makes actors fly
  * if it's appropriate.  @newborn is either a new thumbnail or notification
  * to be displayed; it won't be animated.  Returns the position of the bottom
- * of the lowest thumbnail.  Also sets @Thumbsize.
+ * of the lowest thumbnail.  Also sets @Thumbsize.  Thumbnails which stay
+ * in their slots at the same size are not touched at all, so they don't
+ * get new effects either.
  */
 static guint
 layout_thumbs (ClutterActor * newborn)
@@ -2227,10 +2426,9 @@ layout_thumbs (ClutterActor * newborn)
   guint appwgw,appwgh;
   //guint apph_portrait_fix;
 
-  /* Save the old @Thumbsize to know if it's changed. */
   calc_layout (&lout);
-  oldthsize = Thumbsize;
   Thumbsize = lout.thumbsize;
+  Last_layout = lout;
 
   /* Clip titles longer than this. */
   maxwtitle = Thumbsize->width
@@ -2266,17 +2464,27 @@ layout_thumbs (ClutterActor * newborn)
             ? lout.xpos : lout.last_row_xpos;
         }
 
+      /* Has it stayed where it was? */
+      if (thumb->slot_size == Thumbsize && thumb->thwin != newborn
+          && thumb->slot_x == xthumb && thumb->slot_y == ythumb)
+        goto skip_the_circus;
+
       /* If @thwin's been there, animate as it's moving.  Otherwise if it's
        * a new one to enter the navigator, don't, it's hidden anyway. */
       ops = thumb->thwin == newborn ? &Fly_at_once : &Fly_smoothly;
+      Layout_benchmark.touched++;
 
       /* Place @thwin in any case. */
       ops->move (thumb->thwin, xthumb, ythumb);
+      thumb->slot_x = xthumb;
+      thumb->slot_y = ythumb;
 
-      /* If @Thumbnails are not changing size and this is not a newborn
-       * the inners of @thumb are already setup. */
-      if (oldthsize == Thumbsize && thumb->thwin != newborn)
+      /* If @thumb is not changing size and this is not a newborn
+       * its inners are already setup. */
+      if (thumb->slot_size == Thumbsize && thumb->thwin != newborn)
           goto skip_the_circus;
+      oldthsize = thumb->slot_size;
+      thumb->slot_size = Thumbsize;
 
       /* Set thumbnail's reaction area. */
       ops->resize (thumb->thwin, Thumbsize->width, Thumbsize->height);
@@ -2341,14 +2549,175 @@ skip_the_circus:
   return ythumb + Thumbsize->height+(/* No idea why */ IS_PORTRAIT?(SCREEN_HEIGHT-SCREEN_WIDTH):0);
 }
 
+/* Culling {{{
+ * Thumbnails out of the viewport, give or take a row, are hidden, so they
+ * cost nothing to paint or pick and their windows needn't be redrawn.
+ * As the @Grid is scrolled only the rows which come or go are touched.
+ * Thumbnails hidden for other reasons are left alone.  While thumbnails
+ * are flying we only show them and tidy up when they've landed.
+ */
+static void refresh_snapshots_later (void);
+static void schedule_snapshot_work (void);
+
+/* Tells the range of rows of @Last_layout in and around the viewport. */
+static void
+visible_rows (gint * firstp, gint * lastp)
+{
+  gint top, bottom, vspace;
+
+  vspace = MAX (Last_layout.vspace, 1);
+  top = (gint)hd_scrollable_group_get_viewport_y (Grid)
+    - vspace - (gint)Last_layout.ypos;
+  bottom = top + (gint)clutter_actor_get_height (Scroller) + 2*vspace;
+
+  /* A row is never higher than @vspace. */
+  *firstp = top > 0 ? top / vspace : 0;
+  *lastp = bottom > 0 ? (bottom - 1) / vspace : -1;
+}
+
+static void
+cull_thumb (Thumbnail * thumb, gboolean cull)
+{
+  if (cull)
+    {
+      if (!CLUTTER_ACTOR_IS_VISIBLE (thumb->thwin))
+        return;
+      clutter_actor_hide (thumb->thwin);
+      thumb->culled = TRUE;
+    }
+  else if (thumb->culled)
+    {
+      thumb->culled = FALSE;
+      clutter_actor_show (thumb->thwin);
+
+      /* It may have changed while it was out of sight. */
+      if (thumb_is_application (thumb) && thumb->snapshot_dirty)
+        refresh_snapshots_later ();
+    }
+  else
+    return;
+
+  /* Live thumbnails need their textures only while they're seen. */
+  if (thumb_is_application (thumb) && LIVE_THUMBS_RATE > 0)
+    schedule_snapshot_work ();
+}
+
+static void
+cull_row (gint row, gboolean cull)
+{
+  GList *li;
+  guint i;
+
+  li = g_list_nth (Thumbnails, row * Last_layout.cells_per_row);
+  for (i = 0; li && i < Last_layout.cells_per_row; li = li->next, i++)
+    cull_thumb (li->data, cull);
+}
+
+static void cull_thumbs (gboolean everything);
+
+/* add_effect_closure() callback to cull_thumbs() when they've landed. */
+static void
+recull_thumbs (ClutterActor * unused1, gpointer unused2)
+{
+  Recull_pending = FALSE;
+  cull_thumbs (TRUE);
+}
+
+/* Hide the thumbnails out of sight and show those in sight.  Unless
+ * @everything only the rows which have come or gone since the last
+ * time are looked at. */
+static void
+cull_thumbs (gboolean everything)
+{
+  gint first, last, from, to, row;
+  gboolean flying;
+
+  if (!Last_layout.cells_per_row)
+    /* Nothing's been laid out yet. */
+    return;
+
+  visible_rows (&first, &last);
+  if (everything)
+    {
+      from = 0;
+      to = NThumbnails > 0
+        ? (gint)((NThumbnails - 1) / Last_layout.cells_per_row) : -1;
+    }
+  else
+    {
+      from = MIN (first, Shown_first);
+      to   = MAX (last,  Shown_last);
+    }
+
+  flying = animation_in_progress (Fly_effect_timeline);
+  for (row = from; row <= to; row++)
+    if (first <= row && row <= last)
+      cull_row (row, FALSE);
+    else if (!flying)
+      cull_row (row, TRUE);
+
+  if (flying && !Recull_pending)
+    {
+      Recull_pending = TRUE;
+      add_effect_closure (Fly_effect_timeline, recull_thumbs,
+                          CLUTTER_ACTOR (Grid), NULL);
+    }
+
+  Shown_first = first;
+  Shown_last  = last;
+}
+
+/* @Grid's vertical #TidyAdjustment's "notify::value" handler. */
+static void
+grid_scrolled (TidyAdjustment * vadj, GParamSpec * unused1, gpointer unused2)
+{
+  cull_thumbs (FALSE);
+}
+/* Culling }}} */
+
+/* Tell how long the layout() just finished took, and how long it takes
+ * on average with as many thumbnails. */
+static void
+report_layout_cost (void)
+{
+  gdouble elapsed;
+  guint n;
+
+  elapsed = g_timer_elapsed (Layout_benchmark.timer, NULL);
+  if ((n = NThumbnails) <= LAYOUT_BENCHMARK_MAX)
+    {
+      Layout_benchmark.nlayouts[n]++;
+      Layout_benchmark.total[n] += elapsed;
+      g_message ("layout of %u thumbnails: %.3f ms, %u touched, "
+                 "%.3f ms on average of %u",
+                 n, elapsed * 1000, Layout_benchmark.touched,
+                 Layout_benchmark.total[n] * 1000
+                   / Layout_benchmark.nlayouts[n],
+                 Layout_benchmark.nlayouts[n]);
+    }
+  else
+    g_message ("layout of %u thumbnails: %.3f ms, %u touched",
+               n, elapsed * 1000, Layout_benchmark.touched);
+}
+
 /* Lays out the @Thumbnails in the @Grid. */
 static void
 layout (ClutterActor * newborn, gboolean newborn_is_notification)
 {
+  if (Layout_benchmark.timer)
+    {
+      Layout_benchmark.touched = 0;
+      g_timer_start (Layout_benchmark.timer);
+    }
+
   /* This layout machinery is based on invariants, which basically
    * means we don't pay much attention to what caused the layout
    * update, but we rely on the current state of matters. */
   set_navigator_height (layout_thumbs (newborn));
+  cull_thumbs (TRUE);
+
+  if (Layout_benchmark.timer)
+    report_layout_cost ();
 
   if (newborn && animation_in_progress (Fly_effect_timeline))
     {
@@ -2512,6 +2881,13 @@ free_thumb (Thumbnail * thumb, gboolean animate)
         mb_wm_object_signal_disconnect (MB_WM_OBJECT (thumb->win),
                                         thumb->win_changed_cb_id);
 
+      if (thumb->video_fname)
+        {
+          hd_image_cache_unwatch (thumb->video_fname,
+                                  (HdImageCacheFunc)video_changed, thumb);
+          g_free (thumb->video_fname);
+        }
+
       g_free(thumb->saved_title);
       if (thumb->nodest)
         XFree (thumb->nodest);
@@ -2523,62 +2899,383 @@ free_thumb (Thumbnail * thumb, gboolean animate)
 
 /* Application thumbnails {{{ */
 /* Child adoption {{{ */
-/* Returns whether the application represented by @apthumb has
- * a video screenshot and it should be loaded or reloaded.
- * If so it refreshes @apthumb->video_mtime. */
+/* Snapshots {{{
+ * Background applications are shown by a snapshot of their window taken
+ * when they left the foreground, so we needn't draw their full-size
+ * textures scaled down, and when they go to hibernation the textures
+ * can be released altogether.  Snapshots are scaled and converted by
+ * hd_screenshot_snapshot() in the background and uploaded as 16-bit
+ * textures.  While we're active the snapshots of the applications that
+ * keep drawing are retaken at most %LIVE_THUMBS_RATE times a second,
+ * and only those.  Meanwhile the textures of the others are freed and
+ * not updated, until they are needed again.  Snapshots are taken and
+ * textures are released by snapshot_work() when no transition is in
+ * progress.
+ */
+static Thumbnail *find_by_apwin (ClutterActor * apwin);
+
+/* Returns the texture of @apwin's client window or %NULL. */
+static ClutterActor *
+apwin_texture (ClutterActor * apwin)
+{
+  ClutterActor *texture;
+
+  if (!CLUTTER_IS_GROUP (apwin))
+    return NULL;
+  texture = clutter_group_get_nth_child (CLUTTER_GROUP (apwin), 0);
+  return texture && CLUTTER_X11_IS_TEXTURE_PIXMAP (texture) ? texture : NULL;
+}
+
+/* Show .snapshot in place of .apwin if we have one.  Only while we are
+ * active, otherwise .apwin is not ours to hide. */
+static void
+show_snapshot (Thumbnail * apthumb)
+{
+  if (!apthumb->snapshot || !hd_task_navigator_is_active ())
+    return;
+  clutter_actor_show (apthumb->snapshot);
+  clutter_actor_hide (apthumb->apwin);
+}
+
+/* Undo show_snapshot(). */
+static void
+hide_snapshot (Thumbnail * apthumb)
+{
+  if (!apthumb->snapshot)
+    return;
+  clutter_actor_hide (apthumb->snapshot);
+  clutter_actor_show (apthumb->apwin);
+}
+
+/* #ClutterEffectCompleteFunc to show_snapshot() after zooming. */
+static void
+show_snapshot_later (ClutterActor * apwin, gpointer unused)
+{
+  if (hd_task_navigator_has_window (HD_TASK_NAVIGATOR (Navigator), apwin))
+    show_snapshot (find_by_apwin (apwin));
+}
+
+/* Whether the texture of @apthumb->apwin should be kept up to date:
+ * unless .snapshot stands in for it, or while we're active and retake
+ * .snapshot when the texture is damaged. */
 static gboolean
-need_to_load_video (Thumbnail * apthumb)
+apwin_texture_needed (const Thumbnail * apthumb)
 {
-  /* Already has a video loaded? */
-  if (apthumb->video)
+  if (!apthumb->snapshot)
+    return TRUE;
+  if (!hd_task_navigator_is_active ())
+    return FALSE;
+  return !CLUTTER_ACTOR_IS_VISIBLE (apthumb->snapshot)
+    || (!apthumb->culled && LIVE_THUMBS_RATE > 0);
+}
+
+/* Free the texture of @apthumb->apwin and stop updating it while
+ * .snapshot stands in for it.  Undone by rebind_apwin_texture(). */
+static void
+release_apwin_texture (Thumbnail * apthumb)
+{
+  static const guchar blank[4];
+  MBWMCompMgrClutterClient *cmgrcc;
+  ClutterActor *texture;
+
+  if (apthumb->apwin_released || !apthumb->win
+      || !(texture = apwin_texture (apthumb->apwin))
+      || !(cmgrcc = g_object_get_data (G_OBJECT (apthumb->apwin),
+                                       "HD-MBWMCompMgrClutterClient")))
+    return;
+
+  mb_wm_comp_mgr_clutter_client_track_damage (cmgrcc, False);
+  clutter_actor_hide (texture);
+  clutter_texture_set_from_rgb_data (CLUTTER_TEXTURE (texture), blank, TRUE,
+                                     1, 1, sizeof (blank), 4, 0, NULL);
+  apthumb->apwin_released = TRUE;
+}
+
+/* Bring the texture of @apthumb->apwin up to date and keep it so. */
+static void
+rebind_apwin_texture (Thumbnail * apthumb)
+{
+  MBWMCompMgrClutterClient *cmgrcc;
+  ClutterActor *texture;
+  guint width, height;
+
+  if (!apthumb->apwin_released)
+    return;
+  apthumb->apwin_released = FALSE;
+
+  /* If it's in hibernation it can do with the snapshot. */
+  if (!apthumb->win || !(texture = apwin_texture (apthumb->apwin))
+      || !(cmgrcc = g_object_get_data (G_OBJECT (apthumb->apwin),
+                                       "HD-MBWMCompMgrClutterClient")))
+    return;
+
+  mb_wm_comp_mgr_clutter_client_track_damage (cmgrcc, True);
+  g_object_get (texture, "pixmap-width", &width,
+                "pixmap-height", &height, NULL);
+  clutter_x11_texture_pixmap_update_area (CLUTTER_X11_TEXTURE_PIXMAP (texture),
+                                          0, 0, width, height);
+  clutter_actor_show (texture);
+
+  /* We didn't see what it drew in the meantime. */
+  if (apthumb->snapshot)
     {
-      struct stat sbuf;
-      gboolean clear_video, load_video;
+      apthumb->snapshot_dirty = TRUE;
+      refresh_snapshots_later ();
+    }
+}
 
-      /* Refresh or unload it? */
-      load_video = clear_video = FALSE;
-      g_assert (apthumb->video_fname);
-      if (stat (apthumb->video_fname, &sbuf) < 0)
-        {
-          if (errno != ENOENT)
-            g_warning ("%s: %m", apthumb->video_fname);
-          clear_video = TRUE;
-        }
-      else if (sbuf.st_mtime > apthumb->video_mtime)
-        {
-          clear_video = load_video = TRUE;
-          apthumb->video_mtime = sbuf.st_mtime;
-        }
+/* Forget about @apthumb's snapshot, whether we have it or wait for it. */
+static void
+drop_snapshot (Thumbnail * apthumb)
+{
+  apthumb->snapshot_pending = apthumb->snapshot_due = FALSE;
+  if (apthumb->snapshot)
+    {
+      hide_snapshot (apthumb);
+      clutter_container_remove_actor (CLUTTER_CONTAINER (apthumb->windows),
+                                      apthumb->snapshot);
+      apthumb->snapshot = NULL;
+    }
 
-      if (clear_video)
-        {
-          clutter_container_remove_actor (CLUTTER_CONTAINER (apthumb->prison),
-                                          apthumb->video);
-          apthumb->video = NULL;
-        }
+  apthumb->snapshot_dirty = FALSE;
+  rebind_apwin_texture (apthumb);
+}
 
-      return load_video;
+/*
+ * The client of @apthumb is in hibernation, so its texture won't change
+ * anymore.  Replace it with a clone of .snapshot and free the full-size
+ * texture.  The clone keeps the snapshot alive for as long as .apwin is
+ * and it's shown wherever .apwin is until the client is woken up.
+ */
+static void
+retire_apwin_texture (Thumbnail * apthumb)
+{
+  static const guchar blank[4];
+  ClutterActor *texture, *standin;
+  gint x, y;
+  guint width, height;
+
+  if (!(texture = apwin_texture (apthumb->apwin))
+      || g_object_get_data (G_OBJECT (texture), "HD-Snapshot-Standin"))
+    return;
+
+  clutter_actor_get_position (texture, &x, &y);
+  clutter_actor_get_size (texture, &width, &height);
+  standin = clutter_clone_texture_new (CLUTTER_TEXTURE (apthumb->snapshot));
+  clutter_actor_set_name (standin, "snapshot standin");
+  clutter_actor_set_position (standin, x, y);
+  clutter_actor_set_size (standin, width, height);
+  clutter_container_add_actor (CLUTTER_CONTAINER (apthumb->apwin), standin);
+  g_object_set_data (G_OBJECT (texture), "HD-Snapshot-Standin", standin);
+
+  /* A 1x1 texture is as close as we can get to none. */
+  clutter_actor_hide (texture);
+  clutter_texture_set_from_rgb_data (CLUTTER_TEXTURE (texture), blank, TRUE,
+                                     1, 1, sizeof (blank), 4, 0, NULL);
+}
+
+/* hd_screenshot_snapshot() callback: place @pixbuf over @apwin. */
+static void
+snapshot_taken (GdkPixbuf * pixbuf, ClutterActor * apwin)
+{
+  Thumbnail *apthumb;
+  ClutterActor *texture, *snapshot;
+  gint x, y, tx, ty;
+  guint width, height;
+
+  apthumb = hd_task_navigator_has_window (HD_TASK_NAVIGATOR (Navigator),
+                                          apwin)
+    ? find_by_apwin (apwin) : NULL;
+  if (!apthumb || !apthumb->snapshot_pending
+      || !(texture = apwin_texture (apwin)))
+    { /* It's gone or back in the foreground. */
+      if (pixbuf)
+        g_object_unref (pixbuf);
+      goto out;
     }
-  else if (apthumb->video_fname)
+
+  apthumb->snapshot_pending = FALSE;
+  if (!pixbuf || !(snapshot = pixbuf2texture (pixbuf,
+                                              CLUTTER_TEXTURE_FLAG_16_BIT)))
+    goto out;
+
+  /* Make it appear as if it were the @apwin's texture. */
+  drop_snapshot (apthumb);
+  clutter_actor_get_position (apwin, &x, &y);
+  clutter_actor_get_position (texture, &tx, &ty);
+  clutter_actor_get_size (texture, &width, &height);
+  clutter_actor_set_name (snapshot, "snapshot");
+  clutter_actor_set_position (snapshot, x + tx, y + ty);
+  clutter_actor_set_size (snapshot, width, height);
+  clutter_actor_hide (snapshot);
+  clutter_container_add_actor (CLUTTER_CONTAINER (apthumb->windows),
+                               snapshot);
+  apthumb->snapshot = snapshot;
+
+  if (!apthumb->win)
+    retire_apwin_texture (apthumb);
+
+  /* Don't change what's being zoomed. */
+  if (animation_in_progress (Zoom_effect_timeline))
+    add_effect_closure (Zoom_effect_timeline,
+                        (ClutterEffectCompleteFunc)show_snapshot_later,
+                        apwin, NULL);
+  else
+    show_snapshot (apthumb);
+
+  /* Now the texture can go. */
+  schedule_snapshot_work ();
+
+out:
+  g_object_unref (apwin);
+}
+
+/* Take a snapshot of @apthumb->apwin as it is now, at the size
+ * of the thumbnails. */
+static void
+take_snapshot (Thumbnail * apthumb)
+{
+  ClutterActor *texture;
+  Pixmap pixmap;
+  guint depth, width, height;
+  gdouble scale;
+
+  if (apthumb->snapshot_pending || !(texture = apwin_texture (apthumb->apwin))
+      || g_object_get_data (G_OBJECT (texture), "HD-Snapshot-Standin"))
+    return;
+
+  pixmap = None;
+  g_object_get (texture,
+                "pixmap", &pixmap,
+                "pixmap-depth", &depth,
+                "pixmap-width", &width,
+                "pixmap-height", &height,
+                NULL);
+  if (pixmap == None || !width || !height)
+    return;
+
+  /* Thumbnails may be rotated, so take the larger side. */
+  scale = Thumbsize
+    ? (gdouble)MAX (Thumbsize->width, Thumbsize->height) / SCREEN_WIDTH
+    : (gdouble)THUMB_LARGE_WIDTH / SCREEN_WIDTH;
+  scale = MIN (scale, 1);
+
+  if (hd_screenshot_snapshot (clutter_x11_get_default_display (), pixmap,
+                              depth, width, height,
+                              MAX (width * scale, 1), MAX (height * scale, 1),
+                              (HdSnapshotCallback)snapshot_taken,
+                              g_object_ref (apthumb->apwin)))
     {
-      struct stat sbuf;
+      apthumb->snapshot_pending = TRUE;
+      apthumb->snapshot_dirty = FALSE;
+    }
+  else
+    g_object_unref (apthumb->apwin);
+}
 
-      /* Do we need to load it? */
-      if (stat (apthumb->video_fname, &sbuf) == 0)
+/* Take the snapshots that are due and release or rebind the textures
+ * of the windows as apwin_texture_needed(), but neither while a
+ * transition is in progress, so as not to slow it down. */
+static gboolean
+snapshot_work (gpointer unused)
+{
+  GList *li;
+  Thumbnail *apthumb;
+
+  if (animation_in_progress (Zoom_effect_timeline)
+      || hd_render_manager_in_transition ())
+    return TRUE;
+
+  for_each_appthumb (li, apthumb)
+    {
+      if (apthumb->snapshot_due)
         {
-          apthumb->video_mtime = sbuf.st_mtime;
-          return TRUE;
+          apthumb->snapshot_due = FALSE;
+          take_snapshot (apthumb);
         }
-      else if (errno != ENOENT)
-        g_warning ("%s: %m", apthumb->video_fname);
+
+      if (apwin_texture_needed (apthumb))
+        rebind_apwin_texture (apthumb);
+      else
+        release_apwin_texture (apthumb);
     }
 
+  Snapshot_worker = 0;
   return FALSE;
 }
 
-/* Start managing @apthumb's application window and loads/reloads its
- * last-frame video screenshot if necessary.  Called when we enter
- * the switcher or when a new window is added in switcher view. */
+/* Schedule snapshot_work() unless it's scheduled. */
+static void
+schedule_snapshot_work (void)
+{
+  if (!Snapshot_worker)
+    Snapshot_worker = g_timeout_add_full (G_PRIORITY_LOW,
+                                          SNAPSHOT_WORK_DELAY,
+                                          snapshot_work, NULL, NULL);
+}
+
+/* Have snapshot_work() take a snapshot of @apthumb. */
+static void
+take_snapshot_later (Thumbnail * apthumb)
+{
+  apthumb->snapshot_due = TRUE;
+  schedule_snapshot_work ();
+}
+
+/* Retake the snapshots that are out of date.  Unschedules itself
+ * when there are none. */
+static gboolean
+refresh_snapshots (gpointer unused)
+{
+  GList *li;
+  Thumbnail *apthumb;
+  gboolean dirty;
+
+  /* Don't change what's being zoomed, but try again later. */
+  if (animation_in_progress (Zoom_effect_timeline))
+    return TRUE;
+
+  /* Those out of sight are refreshed when they come back. */
+  dirty = FALSE;
+  for_each_appthumb (li, apthumb)
+    if (apthumb->snapshot_dirty && apthumb->win && !apthumb->culled)
+      {
+        dirty = TRUE;
+        take_snapshot (apthumb);
+      }
+
+  if (!dirty)
+    Live_thumbs_timer = 0;
+  return dirty;
+}
+
+/* Schedule refresh_snapshots() unless it's scheduled or disabled. */
+static void
+refresh_snapshots_later (void)
+{
+  gint rate;
+
+  if (Live_thumbs_timer || !hd_task_navigator_is_active ())
+    return;
+  if ((rate = LIVE_THUMBS_RATE) > 0)
+    Live_thumbs_timer = g_timeout_add (1000 / rate, refresh_snapshots, NULL);
+}
+
+/* Stop refreshing the snapshots. */
+static void
+stop_refreshing_snapshots (void)
+{
+  if (!Live_thumbs_timer)
+    return;
+  g_source_remove (Live_thumbs_timer);
+  Live_thumbs_timer = 0;
+}
+/* Snapshots }}} */
+
+/* Start managing @apthumb's application window and show either it or
+ * its video screenshot, which the image cache keeps up to date.  Called
+ * when we enter the switcher or when a new window is added in switcher
+ * view. */
 static void
 claim_win (Thumbnail * apthumb)
 {
@@ -2609,26 +3306,7 @@ claim_win (Thumbnail * apthumb)
                          (GFunc)clutter_actor_reparent,
                          apthumb->windows);
 
-  /* Load the video screenshot and place its actor in the hierarchy. */
-  if (need_to_load_video (apthumb))
-    {
-      /* Make it appear as if .video were .apwin,
-       * having the same geometry. */
-      g_assert (!apthumb->video);
-      apthumb->video = load_image (apthumb->video_fname,
-				   App_window_geometry_width,
-				   App_window_geometry_height);
-      if (apthumb->video)
-        {
-          clutter_actor_set_name (apthumb->video, "video");
-          clutter_actor_set_position (apthumb->video,
-				      App_window_geometry_x,
-				      App_window_geometry_y);
-          clutter_container_add_actor (CLUTTER_CONTAINER (apthumb->prison),
-                                       apthumb->video);
-        }
-    }
-
+  show_snapshot (apthumb);
   if (!apthumb->video)
     /* Needn't bother with show_all() the contents of .windows,
      * they are shown anyway because of reparent(). */
@@ -2654,6 +3332,7 @@ claim_win (Thumbnail * apthumb)
 static void
 release_win (const Thumbnail * apthumb)
 {
+  hide_snapshot ((Thumbnail *)apthumb);
   hd_render_manager_return_app (apthumb->apwin);
   if (apthumb->cemetery)
     g_ptr_array_foreach (apthumb->cemetery,
@@ -2878,6 +3557,11 @@ zoom_in_complete (ClutterActor * navigator, const Thumbnail * apthumb)
                                         rezoom, (Thumbnail *)apthumb);
   g_signal_handlers_disconnect_by_func (apthumb->thwin,
                                         rezoom, (Thumbnail *)apthumb);
+
+  /* It's in the foreground again, the snapshot is history. */
+  if (apthumb->win)
+    drop_snapshot ((Thumbnail *)apthumb);
+
   g_signal_emit_by_name (Navigator, "zoom-in-complete", apthumb->apwin);
 }
 
@@ -2901,6 +3585,14 @@ hd_task_navigator_zoom_in (HdTaskNavigator * self, ClutterActor * win,
   if (animation_in_progress (Zoom_effect_timeline))
     goto damage_control;
 
+  /* Zoom into the real thing unless it's in hibernation. */
+  cull_thumb ((Thumbnail *)apthumb, FALSE);
+  if (apthumb->win)
+    {
+      hide_snapshot ((Thumbnail *)apthumb);
+      rebind_apwin_texture ((Thumbnail *)apthumb);
+    }
+
   /* This is the actual zooming, but we do other effects as well. */
   hd_render_manager_unzoom_background ();
   zoom_in (apthumb);
@@ -2956,15 +3648,23 @@ void
 hd_task_navigator_zoom_out (HdTaskNavigator * self, ClutterActor * win,
                             ClutterEffectCompleteFunc fun, gpointer funparam)
 { g_debug (__FUNCTION__);
-  const Thumbnail *apthumb;
+  Thumbnail *apthumb;
   gdouble xscale, yscale;
   gint yarea, xpos, ypos;
 
+  /* Zoom out of what @win looks like now, not of an old snapshot. */
+  apthumb = find_by_apwin (win);
+  if (apthumb && apthumb->win)
+    drop_snapshot (apthumb);
+
   /* Our "show" callback will grab the butts of @win. */
   clutter_actor_show (Navigator);
-  if (!(apthumb = find_by_apwin (win)))
+  if (!apthumb)
     goto damage_control;
 
+  /* It's leaving the foreground for us, but don't hold up the zooming. */
+  take_snapshot_later (apthumb);
+
   /* @xpos, @ypos:= intended real position of @apthumb */
   g_assert (Thumbsize != NULL);
   clutter_actor_get_position (apthumb->thwin,  &xpos, &ypos);
@@ -3204,7 +3904,8 @@ create_appthumb (ClutterActor * apwin)
 
   /* .video_fname */
   if ((app = hd_comp_mgr_client_get_launcher (HD_COMP_MGR_CLIENT (hmgrc))) != NULL)
-    apthumb->video_fname = hd_launcher_app_get_switcher_icon (HD_LAUNCHER_APP (app));
+    apthumb->video_fname = g_strdup (
+                hd_launcher_app_get_switcher_icon (HD_LAUNCHER_APP (app)));
 
   /* Now the actors: .apwin, .titlebar, .windows. */
   apthumb->apwin = g_object_ref (apwin);
@@ -3255,6 +3956,21 @@ create_appthumb (ClutterActor * apwin)
   if (!thumb_has_notification (apthumb))
     reset_thumb_title (apthumb);
 
+  /* Have the video screenshot loaded in the background, at the size
+   * it's shown, and reloaded whenever it changes. */
+  if (apthumb->video_fname)
+    {
+      GdkPixbuf *pixbuf;
+
+      pixbuf = hd_image_cache_watch (apthumb->video_fname,
+                                     App_window_geometry_width / 2,
+                                     App_window_geometry_height / 2,
+                                     (HdImageCacheFunc)video_changed,
+                                     apthumb);
+      if (pixbuf)
+        set_video (apthumb, pixbuf);
+    }
+
   return apthumb;
 }
 
@@ -3509,6 +4225,74 @@ hd_task_navigator_hibernate_window (HdTaskNavigator * self,
   mb_wm_object_signal_disconnect (MB_WM_OBJECT (apthumb->win),
                                   apthumb->win_changed_cb_id);
   apthumb->win = NULL;
+
+  /* Its texture won't change anymore, we can do with a snapshot. */
+  if (apthumb->snapshot)
+    retire_apwin_texture (apthumb);
+  else
+    take_snapshot_later (apthumb);
+}
+
+/* The current application window in application view changed from
+ * @old_win to @new_win, either of which can be %NULL or something we
+ * don't know about.  Have @old_win snapshotted now that it's in the
+ * background. */
+void
+hd_task_navigator_current_window_changed (HdTaskNavigator * self,
+                                          ClutterActor * old_win,
+                                          ClutterActor * new_win)
+{
+  Thumbnail *apthumb;
+
+  if (new_win && hd_task_navigator_has_window (self, new_win)
+      && (apthumb = find_by_apwin (new_win))->win)
+    drop_snapshot (apthumb);
+  if (old_win && hd_task_navigator_has_window (self, old_win))
+    take_snapshot_later (find_by_apwin (old_win));
+}
+
+/*
+ * @win has drawn something.  If it's shown by a snapshot make a note
+ * to retake it.  Returns whether @win is out of sight or its snapshot
+ * is shown in its place at the moment, in which case there's no point
+ * redrawing @win.
+ */
+gboolean
+hd_task_navigator_window_damaged (HdTaskNavigator * self, ClutterActor * win)
+{
+  GList *li;
+  Thumbnail *apthumb;
+
+  for_each_appthumb (li, apthumb)
+    if (apthumb->apwin == win)
+      break;
+  if (!apthumb || !apthumb->win)
+    return FALSE;
+
+  if (apthumb->snapshot)
+    {
+      apthumb->snapshot_dirty = TRUE;
+      refresh_snapshots_later ();
+    }
+
+  if (apthumb->culled && hd_task_navigator_is_active ())
+    return TRUE;
+  return apthumb->snapshot && CLUTTER_ACTOR_IS_VISIBLE (apthumb->snapshot);
+}
+
+/* Returns whether the texture of @win is released because a snapshot
+ * stands in for it, in which case its damage must not be tracked. */
+gboolean
+hd_task_navigator_window_released (HdTaskNavigator * self,
+                                   ClutterActor * win)
+{
+  GList *li;
+  Thumbnail *apthumb;
+
+  for_each_appthumb (li, apthumb)
+    if (apthumb->apwin == win)
+      return apthumb->apwin_released;
+  return FALSE;
 }
 
 /* Tells us to show @new_win in place of @old_win, and forget about
@@ -3541,6 +4325,9 @@ hd_task_navigator_replace_window (HdTaskNavigator * self,
   else
     apthumb->cemetery = g_ptr_array_new ();
 
+  /* .snapshot was of @old_win. */
+  drop_snapshot (apthumb);
+
   /* Add @old_win to .cemetery.  Do it before we unref @old_win,
    * so we don't possibly add a dangling pointer there. */
   g_ptr_array_add (apthumb->cemetery, old_win);
@@ -4118,6 +4905,11 @@ navigator_shown (ClutterActor * navigator, gpointer unused)
   for_each_appthumb (li, thumb)
     claim_win (thumb);
 
+  /* Some applications may have changed while they were out of sight. */
+  cull_thumbs (TRUE);
+  refresh_snapshots_later ();
+  schedule_snapshot_work ();
+
   /* Because we're just about to show them */
   UnseenNotifications = FALSE;
 }
@@ -4145,8 +4937,10 @@ navigator_hidden (ClutterActor * navigator, gpointer unused)
     }
 
   /* Undo navigator_shown(). */
+  stop_refreshing_snapshots ();
   for_each_appthumb (li, thumb)
     release_win (thumb);
+  schedule_snapshot_work ();
 }
 /* Entering and exiting @Navigator }}} */
 
@@ -4300,6 +5094,8 @@ new_animation (ClutterTimeline ** timelinep, guint duration)
 static void
 hd_task_navigator_init (HdTaskNavigator * self)
 {
+  TidyAdjustment *vadj;
+
   Navigator = CLUTTER_ACTOR (self);
   clutter_actor_set_reactive (Navigator, TRUE);
   clutter_actor_set_size (Navigator, SCREEN_WIDTH, SCREEN_HEIGHT);
@@ -4337,11 +5133,17 @@ hd_task_navigator_init (HdTaskNavigator * self)
                     G_CALLBACK (grid_clicked), NULL);
   clutter_container_add_actor (CLUTTER_CONTAINER (Scroller),
                                CLUTTER_ACTOR (Grid));
+  tidy_scrollable_get_adjustments (TIDY_SCROLLABLE (Grid), NULL, &vadj);
+  g_signal_connect (vadj, "notify::value", G_CALLBACK (grid_scrolled), NULL);
 
   /* Effect timelines */
   Fly_effect  = new_animation (&Fly_effect_timeline,  FLY_EFFECT_DURATION);
   Zoom_effect = new_animation (&Zoom_effect_timeline, ZOOM_EFFECT_DURATION);
 
+  /* Open 1 to %LAYOUT_BENCHMARK_MAX windows to see how layout() fares. */
+  if (g_getenv (LAYOUT_BENCHMARK_ENV_VAR))
+    Layout_benchmark.timer = g_timer_new ();
+
   /* Master pieces */
   LargeSystemFont = hd_gtk_style_resolve_logical_font ("LargeSystemFont");
   SystemFont = hd_gtk_style_resolve_logical_font ("SystemFont");
@@ -63,6 +63,13 @@ void hd_task_navigator_hibernate_window (HdTaskNavigator *self,
 void hd_task_navigator_replace_window   (HdTaskNavigator *self,
                                          ClutterActor *old_win,
                                          ClutterActor *new_win);
+void hd_task_navigator_current_window_changed (HdTaskNavigator *self,
+                                               ClutterActor *old_win,
+                                               ClutterActor *new_win);
+gboolean hd_task_navigator_window_damaged (HdTaskNavigator *self,
+                                           ClutterActor *win);
+gboolean hd_task_navigator_window_released (HdTaskNavigator *self,
+                                            ClutterActor *win);
 void hd_task_navigator_notification_thread_changed (HdTaskNavigator *self,
                                                     ClutterActor *win,
                                                     char *nothread);
@@ -49,6 +49,11 @@
 #endif
 #include "hd-launcher.h"
 #include "hd-launcher-tree.h"
+#include "hd-launch-helper.h"
+#include "hd-app-victims.h"
+#include "hd-app-stats.h"
+#include "hd-mem-pressure.h"
+#include "hd-launch-trace.h"
 #include "home/hd-render-manager.h"
 #include "home/hd-home-view-container.h"
 #include "hd-transition.h"
@@ -100,12 +105,18 @@ struct _HdAppMgrPrivate
 
   /* All the running apps we know about. */
   GList *running_apps;
+  GHashTable *pids;   /* pid -> HdRunningApp in running_apps */
 
   /* Each one of these lists contain different HdRunningApps. */
   GQueue *queues[NUM_QUEUES];
+  /* The same apps by how good it is to hibernate or kill them,
+   * for the queues we take them from. */
+  HdAppVictims *victims[NUM_QUEUES];
 
-  /* Is the state check already looping? */
-  gboolean state_check_looping;
+  /* The state check loop's timeout while it's looping, and the idle
+   * of the next check to come before the loop gets there. */
+  guint state_check_id;
+  guint state_check_now_id;
 
   /* Memory limits. */
   HdAppMgrPrestartMode prestart_mode;
@@ -122,6 +133,11 @@ struct _HdAppMgrPrivate
   gboolean prestarting_stopped:1;
   gboolean prestarting;
 
+  /* Don't prestart while the user's launch of this app (not referenced)
+   * is under way, until it's shown or the timeout expires. */
+  HdRunningApp *launching;
+  guint launching_timeout;
+
   /* Flags for showing CallUI. */
   GConfClient *gconf_client;
   gboolean portrait;
@@ -267,7 +283,11 @@ static void     hd_app_mgr_hdrm_state_change (gpointer hdrm,
                                               GParamSpec *pspec,
                                               HdAppMgrPrivate *priv);
 static void hd_app_mgr_state_check (void);
+static void hd_app_mgr_state_check_at_once (void);
+static void hd_app_mgr_launch_started (HdRunningApp *app);
+static void hd_app_mgr_launch_settled (void);
 static gboolean hd_app_mgr_state_check_loop (gpointer data);
+static gboolean hd_app_mgr_state_check_timeout (gpointer data);
 
 static void hd_app_mgr_dbus_name_owner_changed (DBusGProxy *proxy,
                                                 const char *name,
@@ -280,6 +300,8 @@ static DBusHandlerResult hd_app_mgr_dbus_app_died (DBusConnection *conn,
 static DBusHandlerResult hd_app_mgr_dbus_signal_handler (DBusConnection *conn,
                                                     DBusMessage *msg,
                                                     void *data);
+static void hd_app_mgr_mem_pressure_changed (HdMemPressureLevel level,
+                                             gpointer data);
 static void hd_app_mgr_gconf_value_changed (GConfClient *client,
                                             guint cnxn_id,
                                             GConfEntry *entry,
@@ -288,6 +310,7 @@ static gboolean hd_app_mgr_show_callui_cb (gpointer data);
 //gboolean hd_app_mgr_check_show_callui (void);
 
 static void     hd_app_mgr_request_app_pid (HdRunningApp *app);
+static void     hd_app_mgr_set_app_pid (HdRunningApp *app, GPid pid);
 static gboolean hd_app_mgr_loading_timeout (HdRunningApp *app);
 static gboolean hd_app_mgr_init_done_timeout (HdAppMgr *self);
 
@@ -416,6 +439,10 @@ hd_app_mgr_init (HdAppMgr *self)
   /* Initialize the queues. */
   for (int i = 0; i < NUM_QUEUES; i++)
     priv->queues[i] = g_queue_new ();
+  priv->victims[QUEUE_PRESTARTED] = hd_app_victims_new ();
+  priv->victims[QUEUE_HIBERNATABLE] = hd_app_victims_new ();
+  priv->pids = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                      NULL, g_object_unref);
 
   priv->tree = hd_launcher_tree_new ();
   hd_launcher_tree_ensure_user_menu ();
@@ -589,6 +616,9 @@ hd_app_mgr_init (HdAppMgr *self)
   else
     g_warning ("%s: Failed to connect to system dbus.\n", __FUNCTION__);
 
+  /* The kernel can tell us about memory pressure as it happens. */
+  hd_mem_pressure_start (hd_app_mgr_mem_pressure_changed, self);
+
   /* Add a timeout in case init_done is never received. That can happen
    * when restarting, for example.
    */
@@ -635,6 +665,7 @@ hd_app_mgr_stop ()
     return;
 
   hd_app_mgr_kill_all_prestarted ();
+  hd_app_stats_flush ();
 }
 
 static void
@@ -649,12 +680,36 @@ hd_app_mgr_dispose (GObject *gobject)
       priv->dbus_proxy = NULL;
     }
 
+  if (priv->launching_timeout)
+    {
+      g_source_remove (priv->launching_timeout);
+      priv->launching_timeout = 0;
+    }
+  priv->launching = NULL;
+
+  if (priv->state_check_id)
+    {
+      g_source_remove (priv->state_check_id);
+      priv->state_check_id = 0;
+    }
+  if (priv->state_check_now_id)
+    {
+      g_source_remove (priv->state_check_now_id);
+      priv->state_check_now_id = 0;
+    }
+
   if (priv->tree)
     {
       g_object_unref (priv->tree);
       priv->tree = NULL;
     }
 
+  if (priv->pids)
+    {
+      g_hash_table_destroy (priv->pids);
+      priv->pids = NULL;
+    }
+
   if (priv->running_apps)
     {
       g_list_foreach (priv->running_apps, (GFunc)g_object_unref, NULL);
@@ -670,6 +725,11 @@ hd_app_mgr_dispose (GObject *gobject)
           g_queue_free (priv->queues[i]);
           priv->queues[i] = NULL;
         }
+      if (priv->victims[i])
+        {
+          hd_app_victims_free (priv->victims[i]);
+          priv->victims[i] = NULL;
+        }
     }
 
   if (priv->gconf_client)
@@ -705,6 +765,23 @@ _hd_app_mgr_compare_app_priority (gconstpointer a,
   return b_priority - a_priority;
 }
 
+/* Most likely to be started next first, then by priority. */
+static gint
+_hd_app_mgr_compare_app_likelihood (gconstpointer a,
+                                    gconstpointer b,
+                                    gpointer user_data)
+{
+  gdouble a_likelihood = hd_app_stats_get_likelihood (
+                                hd_running_app_get_service (HD_RUNNING_APP (a)));
+  gdouble b_likelihood = hd_app_stats_get_likelihood (
+                                hd_running_app_get_service (HD_RUNNING_APP (b)));
+
+  if (a_likelihood != b_likelihood)
+    return a_likelihood < b_likelihood ? 1 : -1;
+
+  return _hd_app_mgr_compare_app_priority (a, b, user_data);
+}
+
 static void
 hd_app_mgr_add_to_queue (HdAppMgrQueue queue, HdRunningApp *app)
 {
@@ -722,6 +799,8 @@ hd_app_mgr_add_to_queue (HdAppMgrQueue queue, HdRunningApp *app)
                          g_object_ref (app),
                          _hd_app_mgr_compare_app_priority,
                          NULL);
+  if (priv->victims[queue])
+    hd_app_victims_add (priv->victims[queue], app);
 }
 
 static void
@@ -732,6 +811,8 @@ hd_app_mgr_remove_from_queue (HdAppMgrQueue queue, HdRunningApp *app)
 
   if (link)
     {
+      if (priv->victims[queue])
+        hd_app_victims_remove (priv->victims[queue], app);
       g_object_unref (app);
       g_queue_delete_link (priv->queues[queue], link);
     }
@@ -755,6 +836,10 @@ hd_app_mgr_move_queue (HdAppMgrQueue queue_from,
                              app,
                              _hd_app_mgr_compare_app_priority,
                              NULL);
+      if (priv->victims[queue_from])
+        hd_app_victims_remove (priv->victims[queue_from], app);
+      if (priv->victims[queue_to])
+        hd_app_victims_add (priv->victims[queue_to], app);
 
     }
   else
@@ -781,8 +866,19 @@ void hd_app_mgr_hibernatable (HdRunningApp *app, gboolean hibernatable)
       hd_launcher_app_get_service (launcher),
       hibernatable ? "really" : "not");
 
+  /* This happens when the app comes to the top or leaves it. */
+  hd_running_app_set_last_used (app, time (NULL));
   if (hibernatable)
-    hd_app_mgr_add_to_queue (QUEUE_HIBERNATABLE, app);
+    {
+      HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+      /* Queueing it has read its footprint. */
+      hd_app_mgr_add_to_queue (QUEUE_HIBERNATABLE, app);
+      if (priv->victims[QUEUE_HIBERNATABLE])
+        hd_app_stats_set_footprint (hd_running_app_get_service (app),
+                   hd_app_victims_get_app_footprint (
+                                  priv->victims[QUEUE_HIBERNATABLE], app));
+    }
   else
     hd_app_mgr_remove_from_queue (QUEUE_HIBERNATABLE, app);
 
@@ -853,6 +949,40 @@ hd_app_mgr_timeout_backoff_factor ()
                                   0.0);
 }
 
+/*
+ * Reads @filename into @buffer and NUL-terminates it.  The files are
+ * read every time we think of prestarting, so they are kept open and
+ * read again from the start.  @filename must be a constant string.
+ */
+static gssize
+hd_app_mgr_read_proc (const gchar *filename, gchar *buffer, gsize size)
+{
+  static GHashTable *fds;
+  gpointer value;
+  gssize n;
+  int fd;
+
+  if (!fds)
+    fds = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (g_hash_table_lookup_extended (fds, filename, NULL, &value))
+    fd = GPOINTER_TO_INT (value);
+  else
+    {
+      fd = open (filename, O_RDONLY);
+      if (fd >= 0)
+        fcntl (fd, F_SETFD, FD_CLOEXEC);
+      /* Remember the failures too, the file won't appear later. */
+      g_hash_table_insert (fds, (gpointer)filename, GINT_TO_POINTER (fd));
+    }
+
+  if (fd < 0 || (n = pread (fd, buffer, size - 1, 0)) < 0)
+    return -1;
+
+  buffer[n] = 0;
+  return n;
+}
+
 /*
  * Returns the current system load average.
  * Returns a negative value iff the load average
@@ -861,23 +991,10 @@ hd_app_mgr_timeout_backoff_factor ()
 static gdouble
 hd_app_mgr_system_load_average (void)
 {
-  int fd = open ("/proc/loadavg", O_RDONLY);
+  char buffer[32];
 
-  if (fd >= 0)
-    {
-      char buffer[32];
-      int size = read (fd, buffer, sizeof(buffer) -1);
-
-      close (fd);
-      if (size > 0)
-        {
-          gdouble load;
-          buffer[size] = 0;
-          load = g_ascii_strtod(buffer, NULL);
-
-          return load;
-        }
-    }
+  if (hd_app_mgr_read_proc ("/proc/loadavg", buffer, sizeof (buffer)) > 0)
+    return g_ascii_strtod (buffer, NULL);
 
   return -1.0;
 }
@@ -895,6 +1012,10 @@ hd_app_mgr_activate (HdRunningApp *app)
   HdRunningAppState state;
 
   state = hd_running_app_get_state (app);
+  if (state != HD_APP_STATE_LOADING && state != HD_APP_STATE_WAKING)
+    hd_launch_trace_mark (hd_running_app_get_id (app),
+                          HD_LAUNCH_TRACE_ACTIVATE);
+
   switch (state)
   {
     case HD_APP_STATE_INACTIVE:
@@ -924,6 +1045,8 @@ hd_app_mgr_activate (HdRunningApp *app)
   switch (result)
   {
     case LAUNCH_OK:
+      /* Tapping a loading app again or raising a shown one
+       * is not another launch. */
       if (timer)
           {
             /* Start a loading timer. */
@@ -938,9 +1061,15 @@ hd_app_mgr_activate (HdRunningApp *app)
 
             time (&now);
             hd_running_app_set_last_launch (app, now);
+            hd_running_app_launch_started (app);
             g_timeout_add_seconds (timeout,
                                    (GSourceFunc)hd_app_mgr_loading_timeout,
                                    g_object_ref (app));
+
+            hd_app_stats_launched (hd_running_app_get_service (app));
+            /* That changes what is likely to come next, but don't start
+             * it before this one is up. */
+            hd_app_mgr_launch_started (app);
           }
       break;
     case LAUNCH_FAILED:
@@ -964,6 +1093,30 @@ _hd_app_mgr_child_exit (GPid pid, gint status, HdRunningApp *app)
   g_object_unref (app);
 }
 
+/* #HdLaunchHelperFunc of hd_app_mgr_start().  Takes over the reference
+ * to @app. */
+static void
+_hd_app_mgr_child_spawned (GPid pid, HdRunningApp *app)
+{
+  if (pid)
+    {
+      hd_app_mgr_set_app_pid (app, pid);
+      /* Watch the child. */
+      hd_launch_helper_child_watch_add (pid,
+                         (GChildWatchFunc)_hd_app_mgr_child_exit, app);
+      return;
+    }
+
+  /* It's been shown as loading since hd_app_mgr_start(). */
+  if (hd_running_app_get_state (app) == HD_APP_STATE_LOADING)
+    {
+      g_signal_emit (hd_app_mgr_get (), app_mgr_signals[APP_LOADING_FAIL],
+          0, hd_running_app_get_launcher_app (app), NULL);
+      hd_app_mgr_app_closed (app);
+    }
+  g_object_unref (app);
+}
+
 HdAppMgrLaunchResult
 hd_app_mgr_start (HdRunningApp *app)
 {
@@ -994,21 +1147,20 @@ hd_app_mgr_start (HdRunningApp *app)
       exec = hd_launcher_app_get_exec (launcher);
       if (exec)
         {
-          GPid pid = 0;
-          result = hd_app_mgr_execute (exec, &pid, FALSE);
-          if (result)
-            {
-              hd_running_app_set_pid (app, pid);
-              /* Watch the child. */
-              g_child_watch_add (pid,
-                                 (GChildWatchFunc)_hd_app_mgr_child_exit,
-                                 g_object_ref (app));
-            }
+          /* We learn the pid when the child is running. */
+          g_object_ref (app);
+          result = hd_app_mgr_execute (exec, FALSE,
+                           (HdLaunchHelperFunc)_hd_app_mgr_child_spawned,
+                           app);
+          if (!result)
+            g_object_unref (app);
         }
     }
 
   if (result)
     {
+      hd_launch_trace_mark (hd_running_app_get_id (app),
+                            HD_LAUNCH_TRACE_REQUEST);
       hd_running_app_set_state (app, HD_APP_STATE_LOADING);
       g_signal_emit (hd_app_mgr_get (), app_mgr_signals[APP_LAUNCHED],
           0, launcher, NULL);
@@ -1120,8 +1272,14 @@ hd_app_mgr_kill_all (void)
 
 void hd_app_mgr_app_opened (HdRunningApp *app)
 {
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
   HdLauncherApp *launcher = hd_running_app_get_launcher_app (app);
   hd_running_app_set_state (app, HD_APP_STATE_SHOWN);
+  hd_running_app_launch_finished (app);
+
+  /* Now we can prestart again. */
+  if (app == priv->launching)
+    hd_app_mgr_launch_settled ();
 
   /* Signal that the app has appeared.
    */
@@ -1165,7 +1323,7 @@ hd_app_mgr_app_closed (HdRunningApp *app)
   hd_app_mgr_remove_from_queue (QUEUE_HIBERNATED, app);
   hd_app_mgr_remove_from_queue (QUEUE_HIBERNATABLE, app);
 
-  hd_running_app_set_pid (app, 0);
+  hd_app_mgr_set_app_pid (app, 0);
   hd_running_app_set_state (app, HD_APP_STATE_INACTIVE);
 
   if (launcher &&
@@ -1181,6 +1339,7 @@ hd_app_mgr_app_closed (HdRunningApp *app)
       GList *link = g_list_find (priv->running_apps, app);
       if (link)
         {
+          hd_app_mgr_set_app_pid (app, 0);
           g_object_unref (app);
           priv->running_apps = g_list_delete_link (priv->running_apps, link);
         }
@@ -1345,7 +1504,7 @@ hd_app_mgr_hibernate (HdRunningApp *app)
     {
       hd_running_app_set_state (app, HD_APP_STATE_HIBERNATED);
       hd_app_mgr_move_queue (QUEUE_HIBERNATABLE, QUEUE_HIBERNATED, app);
-      hd_running_app_set_pid (app, 0);
+      hd_app_mgr_set_app_pid (app, 0);
       hd_app_mgr_remove_from_queue (QUEUE_PRESTARTABLE, app);
     }
   else
@@ -1383,41 +1542,17 @@ hd_app_mgr_wakeup   (HdRunningApp *app)
 
   res = hd_app_mgr_service_top (service, "RESTORE");
   if (res) {
+    hd_launch_trace_mark (hd_running_app_get_id (app),
+                          HD_LAUNCH_TRACE_REQUEST);
     hd_running_app_set_state (app, HD_APP_STATE_WAKING);
   }
 
   return res ? LAUNCH_OK : LAUNCH_FAILED;
 }
 
-#define OOM_DISABLE "0"
-
-static void
-_hd_app_mgr_child_setup(gpointer user_data)
-{
-  int priority;
-  int fd;
-  int write_result;
-
-  /* If the child process inherited desktop's high priority,
-   * give child default priority */
-  priority = getpriority (PRIO_PROCESS, 0);
-
-  if (!errno && priority < 0)
-  {
-    setpriority (PRIO_PROCESS, 0, 0);
-  }
-
-  /* Unprotect from OOM */
-  fd = open ("/proc/self/oom_adj", O_WRONLY);
-  if (fd >= 0)
-  {
-    write_result = write (fd, OOM_DISABLE, sizeof (OOM_DISABLE));
-    close (fd);
-  }
-}
-
 gboolean
-hd_app_mgr_execute (const gchar *exec, GPid *pid, gboolean auto_reap)
+hd_app_mgr_execute (const gchar *exec, gboolean auto_reap,
+                    HdLaunchHelperFunc func, gpointer data)
 {
   gboolean res = FALSE;
   gchar *space = strchr (exec, ' ');
@@ -1448,12 +1583,7 @@ hd_app_mgr_execute (const gchar *exec, GPid *pid, gboolean auto_reap)
     return FALSE;
   }
 
-  res = g_spawn_async (NULL,
-                       argv, NULL,
-                       auto_reap ? 0 : G_SPAWN_DO_NOT_REAP_CHILD,
-                       _hd_app_mgr_child_setup, NULL,
-                       pid,
-                       NULL);
+  res = hd_launch_helper_spawn (argv, auto_reap, func, data);
   g_free (exec_cmd);
 
   if (argv)
@@ -1514,20 +1644,10 @@ hd_app_mgr_service_top (const gchar *service, const gchar *param)
 static size_t
 hd_app_mgr_read_lowmem (const gchar *filename)
 {
-  int fd = open (filename, O_RDONLY);
+  char buffer[32];
 
-  if (fd >= 0)
-    {
-      char buffer[32];
-      size_t size = read (fd, buffer, sizeof(buffer) -1);
-
-      close (fd);
-      if (size > 0)
-        {
-          buffer[size] = 0;
-          return (size_t)strtol(buffer, NULL, 10);
-        }
-    }
+  if (hd_app_mgr_read_proc (filename, buffer, sizeof (buffer)) > 0)
+    return (size_t)strtol(buffer, NULL, 10);
 
   return NSIZE;
 }
@@ -1626,7 +1746,13 @@ static gboolean hd_app_mgr_can_prestart (HdLauncherApp *launcher)
   if (free_pages == NSIZE)
     return TRUE;
 
-  return free_pages >= priv->prestart_required_pages;
+  /* Leave the reserve free after it has grown to what it was last time,
+   * so we prestart only as many apps as the memory can take. */
+  size_t app_pages = hd_app_stats_get_footprint (
+                               hd_launcher_app_get_service (launcher))
+                     / (sysconf (_SC_PAGESIZE) / 1024);
+
+  return free_pages >= priv->prestart_required_pages + app_pages;
 }
 
 static void
@@ -1645,20 +1771,93 @@ hd_app_mgr_hdrm_state_change (gpointer hdrm,
   hd_app_mgr_mce_activate_accel_if_needed (TRUE);
 }
 
+/* Act on the change right away, then keep looping if needed. */
+static gboolean
+hd_app_mgr_state_check_now (gpointer data)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  priv->state_check_now_id = 0;
+  if (hd_app_mgr_state_check_loop (NULL) && !priv->state_check_id)
+    priv->state_check_id = g_timeout_add_seconds (STATE_CHECK_INTERVAL,
+                                          hd_app_mgr_state_check_timeout,
+                                          NULL);
+  return FALSE;
+}
+
+static gboolean
+hd_app_mgr_state_check_timeout (gpointer data)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  if (hd_app_mgr_state_check_loop (data))
+    return TRUE;
+  priv->state_check_id = 0;
+  return FALSE;
+}
+
+static gboolean
+hd_app_mgr_launching_timeout (gpointer unused)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  priv->launching_timeout = 0;
+  hd_app_mgr_launch_settled ();
+  return FALSE;
+}
+
+/* The user launched @app: hold prestarting back until it's shown, so
+ * they don't compete. */
+static void
+hd_app_mgr_launch_started (HdRunningApp *app)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  priv->launching = app;
+  if (priv->launching_timeout)
+    g_source_remove (priv->launching_timeout);
+  priv->launching_timeout = g_timeout_add_seconds (LOADING_TIMEOUT,
+                                           hd_app_mgr_launching_timeout,
+                                           NULL);
+}
+
+/* The launch is over one way or the other, catch up with prestarting. */
+static void
+hd_app_mgr_launch_settled (void)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  priv->launching = NULL;
+  if (priv->launching_timeout)
+    {
+      g_source_remove (priv->launching_timeout);
+      priv->launching_timeout = 0;
+    }
+  hd_app_mgr_state_check ();
+}
+
 static void
 hd_app_mgr_state_check (void)
 {
   HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
 
   /* If it's already looping, it'll get there, so do nothing. */
-  if (priv->state_check_looping)
+  if (priv->state_check_id || priv->state_check_now_id)
     return;
 
   /* If not, start looping. */
-  priv->state_check_looping = TRUE;
-  g_timeout_add_seconds (STATE_CHECK_INTERVAL,
-                         hd_app_mgr_state_check_loop,
-                         NULL);
+  priv->state_check_now_id = g_idle_add (hd_app_mgr_state_check_now, NULL);
+}
+
+/* Like hd_app_mgr_state_check(), but don't wait for the loop. */
+static void
+hd_app_mgr_state_check_at_once (void)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+
+  if (!priv->state_check_now_id)
+    priv->state_check_now_id = g_idle_add (hd_app_mgr_state_check_now,
+                                           NULL);
 }
 
 /*
@@ -1683,7 +1882,8 @@ hd_app_mgr_state_check_loop (gpointer data)
       /* If there are prestarted apps, kill one of them. */
       if (!g_queue_is_empty (priv->queues[QUEUE_PRESTARTED]))
         {
-          HdRunningApp *app = g_queue_peek_tail (priv->queues[QUEUE_PRESTARTED]);
+          HdRunningApp *app =
+            hd_app_victims_peek (priv->victims[QUEUE_PRESTARTED]);
           hd_app_mgr_kill (app);
           if (!g_queue_is_empty (priv->queues[QUEUE_PRESTARTED]))
             loop = TRUE;
@@ -1693,10 +1893,11 @@ hd_app_mgr_state_check_loop (gpointer data)
   /* If we're running low, hibernate an app. */
   else if (priv->bg_killing)
     {
-      /* TODO: Hibernate an app and loop. */
+      /* Hibernate the app that gives back the most for the least. */
       if (!g_queue_is_empty (priv->queues[QUEUE_HIBERNATABLE]))
         {
-          HdRunningApp *app = g_queue_peek_tail (priv->queues[QUEUE_HIBERNATABLE]);
+          HdRunningApp *app =
+            hd_app_victims_peek (priv->victims[QUEUE_HIBERNATABLE]);
           hd_app_mgr_hibernate (app);
           if (!g_queue_is_empty (priv->queues[QUEUE_HIBERNATABLE]))
             loop = TRUE;
@@ -1720,12 +1921,15 @@ hd_app_mgr_state_check_loop (gpointer data)
   else if (priv->init_done &&
            priv->prestart_mode != PRESTART_NEVER &&
            !priv->prestarting_stopped &&
+           !priv->launching &&
            !g_queue_is_empty (priv->queues[QUEUE_PRESTARTABLE])
       )
     {
       /* We make this tests here to loop even if we can't prestart right now.*/
       if (!priv->prestarting)
         {
+          g_queue_sort (priv->queues[QUEUE_PRESTARTABLE],
+                        _hd_app_mgr_compare_app_likelihood, NULL);
           HdRunningApp *app = g_queue_peek_head (priv->queues[QUEUE_PRESTARTABLE]);
           HdLauncherApp *launcher = hd_running_app_get_launcher_app (app);
           if (launcher && hd_app_mgr_can_prestart (launcher))
@@ -1735,12 +1939,9 @@ hd_app_mgr_state_check_loop (gpointer data)
         loop = TRUE;
     }
 
-  /* Now the tricky part. This function is called by a timeout or by
-   * changes in memory conditions. If we're already looping, return if we
-   * need to loop. If not, and we need to loop, start the loop.
+  /* This function is called by the loop's timeout or by changes in
+   * memory conditions.  Either way, the loop goes on if we need it to.
    */
-  priv->state_check_looping = loop;
-
   return loop;
 }
 
@@ -1901,6 +2102,46 @@ hd_app_mgr_dbus_prestart (HdAppMgr *self, const gboolean enable)
   return TRUE;
 }
 
+static void
+hd_app_mgr_add_launch_stats (const gchar *id, const gchar *phase, guint n,
+                             guint p50, guint p90, guint max,
+                             GPtrArray *stats)
+{
+  GValueArray *row = g_value_array_new (6);
+  GValue value = { 0, };
+
+  g_value_init (&value, G_TYPE_STRING);
+  g_value_set_string (&value, id);
+  g_value_array_append (row, &value);
+  g_value_set_string (&value, phase);
+  g_value_array_append (row, &value);
+  g_value_unset (&value);
+
+  g_value_init (&value, G_TYPE_UINT);
+  g_value_set_uint (&value, n);
+  g_value_array_append (row, &value);
+  g_value_set_uint (&value, p50);
+  g_value_array_append (row, &value);
+  g_value_set_uint (&value, p90);
+  g_value_array_append (row, &value);
+  g_value_set_uint (&value, max);
+  g_value_array_append (row, &value);
+  g_value_unset (&value);
+
+  g_ptr_array_add (stats, row);
+}
+
+/* Returns (id, phase, launches, p50, p90, max) for every phase of the
+ * launches of every application seen, times in ms. */
+gboolean
+hd_app_mgr_dbus_get_launch_stats (HdAppMgr *self, GPtrArray **stats)
+{
+  *stats = g_ptr_array_new ();
+  hd_launch_trace_foreach ((HdLaunchTraceFunc) hd_app_mgr_add_launch_stats,
+                           *stats);
+  return TRUE;
+}
+
 /* hd_app_mgr_slide_is_open():
  *
  * Check if the Device slide keyboard (also known as hardware keyboard or HKB) is open.
@@ -2131,6 +2372,18 @@ hd_app_mgr_dbus_signal_handler (DBusConnection *conn,
   return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
+/* Pressure levels work like the lowmem signals.  Whichever came last
+ * wins, which is fine as they tell about the same memory. */
+static void
+hd_app_mgr_mem_pressure_changed (HdMemPressureLevel level, gpointer data)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (data);
+
+  priv->lowmem = level >= HD_MEM_PRESSURE_CRITICAL;
+  priv->bg_killing = level >= HD_MEM_PRESSURE_LOW;
+  hd_app_mgr_state_check_at_once ();
+}
+
 
 /* Activate the accelerometer when
  * - The user has activated rotate-to-callui.
@@ -2355,7 +2608,7 @@ _hd_app_mgr_request_app_pid_cb (DBusGProxy *proxy, guint pid,
 
   g_debug ("%s: Got pid %d for %s\n", __FUNCTION__,
            pid, hd_running_app_get_service (app));
-  hd_running_app_set_pid (app, pid);
+  hd_app_mgr_set_app_pid (app, pid);
 }
 
 gboolean
@@ -2373,7 +2626,7 @@ hd_app_mgr_request_app_pid (HdRunningApp *app)
   if (!service)
     {
       g_warning ("%s: Can't get the pid for a non-dbus app.\n", __FUNCTION__);
-      hd_running_app_set_pid (app, 0);
+      hd_app_mgr_set_app_pid (app, 0);
     }
 
   org_freedesktop_DBus_get_connection_unix_process_id_async (proxy,
@@ -2381,6 +2634,22 @@ hd_app_mgr_request_app_pid (HdRunningApp *app)
       _hd_app_mgr_request_app_pid_cb, (gpointer)app);
 }
 
+/* Set the pid of @app, keeping priv->pids up to date. */
+static void
+hd_app_mgr_set_app_pid (HdRunningApp *app, GPid pid)
+{
+  HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
+  GPid old = hd_running_app_get_pid (app);
+
+  if (old && g_hash_table_lookup (priv->pids, GINT_TO_POINTER (old)) == app)
+    g_hash_table_remove (priv->pids, GINT_TO_POINTER (old));
+
+  hd_running_app_set_pid (app, pid);
+  if (pid)
+    g_hash_table_insert (priv->pids, GINT_TO_POINTER (pid),
+                         g_object_ref (app));
+}
+
 HdRunningApp *
 hd_app_mgr_match_window (const char *res_name,
                          const char *res_class,
@@ -2391,62 +2660,42 @@ hd_app_mgr_match_window (const char *res_name,
   HdLauncherApp *launcher = NULL;
   GList *link = NULL;
 
-  /* First we need to look if there's already a running app for this. */
-  link = priv->running_apps;
-  while (link)
+  /* If we know the running app's pid and it's the same, we found it. */
+  if (pid)
     {
-      app = HD_RUNNING_APP (link->data);
-      launcher = hd_running_app_get_launcher_app (app);
-
-      /* If we know the running app's pid and it's the same, we found it. */
-      GPid app_pid = hd_running_app_get_pid (app);
-      if (app_pid && (app_pid == pid))
+      app = g_hash_table_lookup (priv->pids, GINT_TO_POINTER (pid));
+      if (app && hd_running_app_get_pid (app) == pid)
         return app;
+    }
 
-      /* Now we look if the app's launcher matches the window. */
-      if (launcher)
+  /* Now we look if a running app's launcher matches the window.
+   * There aren't many of those, so it's fine to go through them. */
+  for (link = priv->running_apps; link; link = link->next)
+    {
+      app = HD_RUNNING_APP (link->data);
+      launcher = hd_running_app_get_launcher_app (app);
+      if (launcher &&
+          hd_launcher_app_match_window (launcher, res_name, res_class))
         {
-          if (hd_launcher_app_match_window (launcher, res_name, res_class))
-            {
-              /* Now we have a good pid. */
-              if (!app_pid)
-                hd_running_app_set_pid (app, pid);
-              return app;
-            }
+          /* Now we have a good pid. */
+          if (!hd_running_app_get_pid (app))
+            hd_app_mgr_set_app_pid (app, pid);
+          return app;
         }
-
-      /* Next. */
-      link = link->next;
     }
 
   /* Well, there wasn't any already running app, so we'll have to look for
    * a launcher that matches.
    */
-  GList *launchers = hd_launcher_tree_get_items (priv->tree);
-  app = NULL;
-
-  if (res_name || res_class)
+  launcher = hd_launcher_tree_find_app_by_window (priv->tree,
+                                                  res_name, res_class);
+  if (launcher)
     {
-      while (launchers)
-        {
-          /* Filter non-applications. */
-          if (hd_launcher_item_get_item_type (HD_LAUNCHER_ITEM (launchers->data)) !=
-              HD_APPLICATION_LAUNCHER)
-            goto next;
-
-          launcher = HD_LAUNCHER_APP (launchers->data);
-          if (hd_launcher_app_match_window (launcher, res_name, res_class))
-            {
-              /* Let's make a new running app for it. */
-              app = hd_running_app_new (launcher);
-              hd_running_app_set_pid (app, pid);
-              priv->running_apps = g_list_prepend (priv->running_apps, app);
-              return app;
-            }
-
-          next:
-          launchers = g_list_next (launchers);
-        }
+      /* Let's make a new running app for it. */
+      app = hd_running_app_new (launcher);
+      hd_app_mgr_set_app_pid (app, pid);
+      priv->running_apps = g_list_prepend (priv->running_apps, app);
+      return app;
     }
 
   /*
@@ -2461,7 +2710,7 @@ hd_app_mgr_match_window (const char *res_name,
       if (hd_running_app_get_state (app) == HD_APP_STATE_LOADING)
         {
           if (!hd_running_app_get_pid (app))
-            hd_running_app_set_pid (app, pid);
+            hd_app_mgr_set_app_pid (app, pid);
           return app;
         }
 
@@ -2473,7 +2722,7 @@ hd_app_mgr_match_window (const char *res_name,
    * have to kill it
    */
   app = hd_running_app_new (NULL);
-  hd_running_app_set_pid (app, pid);
+  hd_app_mgr_set_app_pid (app, pid);
   priv->running_apps = g_list_prepend (priv->running_apps, app);
 
   return app;
@@ -2499,6 +2748,11 @@ hd_app_mgr_dump_app_list (gboolean only_running)
   GList *apps = priv->running_apps;
 
   g_debug ("%s:\n", __FUNCTION__);
+  g_debug ("\tlowmem=%d, bg_killing=%d, pressure=%s/%d\n",
+           priv->lowmem, priv->bg_killing,
+           hd_mem_pressure_get_source () ? hd_mem_pressure_get_source ()
+                                         : "none",
+           hd_mem_pressure_get_level ());
   for (; apps; apps = apps->next)
     {
       HdRunningApp *app = HD_RUNNING_APP (apps->data);
@@ -2512,6 +2766,7 @@ hd_app_mgr_dump_app_list (gboolean only_running)
                   hd_running_app_get_state (app));
         }
     }
+  hd_launch_trace_dump ();
 }
 
 void
@@ -2519,6 +2774,8 @@ hd_app_mgr_dump_tree ()
 {
   HdAppMgrPrivate *priv = HD_APP_MGR_GET_PRIVATE (hd_app_mgr_get ());
   GList *items = hd_launcher_tree_get_items (priv->tree);
+  guint n_strings;
+  gsize size, unshared_size;
 
   g_debug ("%s:\n", __FUNCTION__);
   for (; items; items = items->next)
@@ -2530,6 +2787,10 @@ hd_app_mgr_dump_tree ()
               hd_launcher_item_get_id (item),
               hd_launcher_item_get_category (item));
     }
+
+  hd_launcher_item_string_stats (&n_strings, &size, &unshared_size);
+  g_debug ("\t%u strings in %" G_GSIZE_FORMAT " bytes (%" G_GSIZE_FORMAT
+           " bytes unshared)\n", n_strings, size, unshared_size);
 }
 
 #endif /* G_DEBUG_DISABLE */
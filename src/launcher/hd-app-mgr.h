@@ -34,6 +34,7 @@
 #include "launcher/hd-running-app.h"
 #include "launcher/hd-launcher-app.h"
 #include "launcher/hd-launcher-tree.h"
+#include "launcher/hd-launch-helper.h"
 
 G_BEGIN_DECLS
 
@@ -73,6 +74,7 @@ gboolean hd_app_mgr_relaunch_set_top (HdLauncherApp *app);
 /* D-Bus API */
 gboolean hd_app_mgr_dbus_launch_app (HdAppMgr *self, const gchar *id);
 gboolean hd_app_mgr_dbus_prestart (HdAppMgr *self, const gboolean enable);
+gboolean hd_app_mgr_dbus_get_launch_stats (HdAppMgr *self, GPtrArray **stats);
 
 /* Controlling running apps. */
 gboolean hd_app_mgr_activate     (HdRunningApp *app);
@@ -99,7 +101,8 @@ void hd_app_mgr_dump_tree     (void);
 
 void hd_app_mgr_set_render_manager (GObject *rendermgr);
 
-gboolean hd_app_mgr_execute (const gchar *exec, GPid *pid, gboolean auto_reap);
+gboolean hd_app_mgr_execute (const gchar *exec, gboolean auto_reap,
+                             HdLaunchHelperFunc func, gpointer data);
 
 gboolean hd_app_mgr_check_show_callui(void);
 void hd_app_mgr_mce_activate_accel_if_needed(gboolean update_portraitness);
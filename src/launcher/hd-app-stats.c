@@ -0,0 +1,433 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <time.h>
+
+#include "hd-app-stats.h"
+
+#undef  G_LOG_DOMAIN
+#define G_LOG_DOMAIN "hd-app-stats"
+
+/*
+ * The file has a group for each service:
+ *
+ *   [com.nokia.osso_browser]
+ *   Count=42
+ *   Hours=0;0;0;0;0;0;0;1;3;...     (24 of them)
+ *   Next=com.nokia.osso_email;...
+ *   NextCounts=7;...
+ *   Footprint=23000                 (kB, when it was last seen in use)
+ *
+ * When there have been HD_APP_STATS_MAX_LAUNCHES launches all the counts
+ * are halved, so old habits are forgotten slowly.
+ *
+ * The likelihood of a service being started next mixes how often it is
+ * started at all, how often around this hour and how often after the
+ * last started application, leaving out what we know nothing about.
+ */
+#define HD_APP_STATS_MAX_LAUNCHES  1000
+#define HD_APP_STATS_SAVE_DELAY    30   /* s */
+#define HD_APP_STATS_HOURS         24
+#define HD_APP_STATS_HOUR_SLACK    1
+
+#define HD_APP_STATS_WEIGHT_COUNT  0.2
+#define HD_APP_STATS_WEIGHT_HOUR   0.3
+#define HD_APP_STATS_WEIGHT_NEXT   0.5
+
+typedef struct
+{
+  guint       count;
+  guint       hours[HD_APP_STATS_HOURS];
+  GHashTable *next;      /* service -> times started after this one */
+  guint       n_next;
+  gsize       footprint;
+} HdAppStat;
+
+static GHashTable *stats;          /* service -> HdAppStat */
+static guint       n_launches;
+static gchar      *last_service;
+static guint       save_id;
+
+static gchar *
+hd_app_stats_get_filename (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "hildon-desktop",
+                           "app-stats", NULL);
+}
+
+static void
+hd_app_stat_free (HdAppStat *stat)
+{
+  g_hash_table_destroy (stat->next);
+  g_free (stat);
+}
+
+static HdAppStat *
+hd_app_stats_get (const gchar *service)
+{
+  HdAppStat *stat;
+
+  if ((stat = g_hash_table_lookup (stats, service)) != NULL)
+    return stat;
+
+  stat = g_new0 (HdAppStat, 1);
+  stat->next = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_hash_table_insert (stats, g_strdup (service), stat);
+  return stat;
+}
+
+static void
+hd_app_stats_load (void)
+{
+  GKeyFile *file;
+  gchar *filename, **groups;
+  guint i;
+
+  if (stats)
+    return;
+  stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                 g_free, (GDestroyNotify) hd_app_stat_free);
+
+  file = g_key_file_new ();
+  filename = hd_app_stats_get_filename ();
+  if (!g_key_file_load_from_file (file, filename, G_KEY_FILE_NONE, NULL))
+    goto out;
+
+  groups = g_key_file_get_groups (file, NULL);
+  for (i = 0; groups[i]; i++)
+    {
+      HdAppStat *stat = hd_app_stats_get (groups[i]);
+      gchar **next;
+      gint *counts;
+      gsize n, n_counts, j;
+
+      stat->count = g_key_file_get_integer (file, groups[i], "Count", NULL);
+      stat->footprint = g_key_file_get_integer (file, groups[i],
+                                                "Footprint", NULL);
+      n_launches += stat->count;
+
+      counts = g_key_file_get_integer_list (file, groups[i], "Hours",
+                                            &n, NULL);
+      for (j = 0; counts && j < n && j < HD_APP_STATS_HOURS; j++)
+        stat->hours[j] = MAX (counts[j], 0);
+      g_free (counts);
+
+      next = g_key_file_get_string_list (file, groups[i], "Next", &n, NULL);
+      counts = g_key_file_get_integer_list (file, groups[i], "NextCounts",
+                                            &n_counts, NULL);
+      for (j = 0; next && counts && j < n && j < n_counts; j++)
+        if (counts[j] > 0)
+          {
+            g_hash_table_insert (stat->next, g_strdup (next[j]),
+                                 GUINT_TO_POINTER (counts[j]));
+            stat->n_next += counts[j];
+          }
+      g_strfreev (next);
+      g_free (counts);
+    }
+  g_strfreev (groups);
+
+out:
+  g_free (filename);
+  g_key_file_free (file);
+}
+
+static gboolean
+hd_app_stats_save (gpointer unused)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  GKeyFile *file;
+  gchar *filename, *dir, *data;
+  gsize size;
+
+  save_id = 0;
+  file = g_key_file_new ();
+
+  g_hash_table_iter_init (&iter, stats);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      HdAppStat *stat = value;
+      GHashTableIter next_iter;
+      gpointer next, count;
+      const gchar **services;
+      gint *counts;
+      guint n = g_hash_table_size (stat->next), i = 0;
+
+      g_key_file_set_integer (file, key, "Count", stat->count);
+      g_key_file_set_integer_list (file, key, "Hours",
+                                   (gint *) stat->hours, HD_APP_STATS_HOURS);
+      if (stat->footprint)
+        g_key_file_set_integer (file, key, "Footprint", stat->footprint);
+
+      if (!n)
+        continue;
+      services = g_new (const gchar *, n);
+      counts = g_new (gint, n);
+      g_hash_table_iter_init (&next_iter, stat->next);
+      while (g_hash_table_iter_next (&next_iter, &next, &count))
+        {
+          services[i] = next;
+          counts[i++] = GPOINTER_TO_UINT (count);
+        }
+      g_key_file_set_string_list (file, key, "Next", services, n);
+      g_key_file_set_integer_list (file, key, "NextCounts", counts, n);
+      g_free (services);
+      g_free (counts);
+    }
+
+  filename = hd_app_stats_get_filename ();
+  dir = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dir, 0755);
+  data = g_key_file_to_data (file, &size, NULL);
+  if (!g_file_set_contents (filename, data, size, NULL))
+    g_warning ("%s: couldn't write %s", __FUNCTION__, filename);
+
+  g_free (data);
+  g_free (dir);
+  g_free (filename);
+  g_key_file_free (file);
+  return FALSE;
+}
+
+/* Save the changes now if there are any waiting to be saved. */
+void
+hd_app_stats_flush (void)
+{
+  if (!save_id)
+    return;
+  g_source_remove (save_id);
+  hd_app_stats_save (NULL);
+}
+
+static void
+hd_app_stats_changed (void)
+{
+  if (!save_id)
+    save_id = g_timeout_add_seconds (HD_APP_STATS_SAVE_DELAY,
+                                     hd_app_stats_save, NULL);
+}
+
+static void
+hd_app_stats_halve_next (gpointer key, gpointer value, gpointer data)
+{
+  HdAppStat *stat = data;
+  guint n = GPOINTER_TO_UINT (value) / 2;
+
+  if (n)
+    {
+      g_hash_table_insert (stat->next, g_strdup (key), GUINT_TO_POINTER (n));
+      stat->n_next += n;
+    }
+}
+
+static void
+hd_app_stats_halve (void)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint i;
+
+  n_launches = 0;
+  g_hash_table_iter_init (&iter, stats);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      HdAppStat *stat = value;
+      GHashTable *next;
+
+      stat->count /= 2;
+      n_launches += stat->count;
+      for (i = 0; i < HD_APP_STATS_HOURS; i++)
+        stat->hours[i] /= 2;
+
+      next = stat->next;
+      stat->next = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+      stat->n_next = 0;
+      g_hash_table_foreach (next, hd_app_stats_halve_next, stat);
+      g_hash_table_destroy (next);
+    }
+}
+
+static guint
+hd_app_stats_get_hour (void)
+{
+  time_t now = time (NULL);
+  struct tm tm;
+
+  localtime_r (&now, &tm);
+  return tm.tm_hour % HD_APP_STATS_HOURS;
+}
+
+/* Launches around the current hour. */
+static guint
+hd_app_stats_around_hour (HdAppStat *stat, guint hour)
+{
+  guint n = 0;
+  gint i;
+
+  for (i = -HD_APP_STATS_HOUR_SLACK; i <= HD_APP_STATS_HOUR_SLACK; i++)
+    n += stat->hours[(hour + HD_APP_STATS_HOURS + i) % HD_APP_STATS_HOURS];
+  return n;
+}
+
+/* The user has started @service. */
+void
+hd_app_stats_launched (const gchar *service)
+{
+  HdAppStat *stat;
+
+  if (!service)
+    return;
+  hd_app_stats_load ();
+
+  stat = hd_app_stats_get (service);
+  stat->count++;
+  stat->hours[hd_app_stats_get_hour ()]++;
+
+  if (last_service && strcmp (last_service, service))
+    {
+      HdAppStat *last = hd_app_stats_get (last_service);
+      guint n = GPOINTER_TO_UINT (g_hash_table_lookup (last->next, service));
+
+      g_hash_table_insert (last->next, g_strdup (service),
+                           GUINT_TO_POINTER (n + 1));
+      last->n_next++;
+    }
+  g_free (last_service);
+  last_service = g_strdup (service);
+
+  if (++n_launches > HD_APP_STATS_MAX_LAUNCHES)
+    hd_app_stats_halve ();
+  hd_app_stats_changed ();
+}
+
+/* Remember how big @service is in use, in kB. */
+void
+hd_app_stats_set_footprint (const gchar *service, gsize footprint)
+{
+  HdAppStat *stat;
+
+  if (!service || !footprint)
+    return;
+  hd_app_stats_load ();
+
+  stat = hd_app_stats_get (service);
+  if (stat->footprint != footprint)
+    {
+      stat->footprint = footprint;
+      hd_app_stats_changed ();
+    }
+}
+
+/* Returns how big @service was when last seen in use, in kB, or 0. */
+gsize
+hd_app_stats_get_footprint (const gchar *service)
+{
+  HdAppStat *stat;
+
+  if (!service)
+    return 0;
+  hd_app_stats_load ();
+
+  stat = g_hash_table_lookup (stats, service);
+  return stat ? stat->footprint : 0;
+}
+
+/* Returns how likely it is that @service is started next, 0..1. */
+gdouble
+hd_app_stats_get_likelihood (const gchar *service)
+{
+  HdAppStat *stat, *last = NULL;
+  GHashTableIter iter;
+  gpointer value;
+  gdouble sum = 0, weights = 0;
+  guint hour, at_hour = 0;
+
+  if (!service)
+    return 0;
+  hd_app_stats_load ();
+
+  if (!(stat = g_hash_table_lookup (stats, service)) || !n_launches)
+    return 0;
+
+  sum += HD_APP_STATS_WEIGHT_COUNT * stat->count / n_launches;
+  weights += HD_APP_STATS_WEIGHT_COUNT;
+
+  hour = hd_app_stats_get_hour ();
+  g_hash_table_iter_init (&iter, stats);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    at_hour += hd_app_stats_around_hour (value, hour);
+  if (at_hour)
+    {
+      sum += HD_APP_STATS_WEIGHT_HOUR
+        * hd_app_stats_around_hour (stat, hour) / at_hour;
+      weights += HD_APP_STATS_WEIGHT_HOUR;
+    }
+
+  if (last_service)
+    last = g_hash_table_lookup (stats, last_service);
+  if (last && last->n_next)
+    {
+      sum += HD_APP_STATS_WEIGHT_NEXT
+        * GPOINTER_TO_UINT (g_hash_table_lookup (last->next, service))
+        / last->n_next;
+      weights += HD_APP_STATS_WEIGHT_NEXT;
+    }
+
+  return sum / weights;
+}
+
+static gint
+hd_app_stats_cmp_likelihood (gconstpointer a, gconstpointer b)
+{
+  gdouble la = hd_app_stats_get_likelihood (a);
+  gdouble lb = hd_app_stats_get_likelihood (b);
+
+  return la < lb ? 1 : la > lb ? -1 : 0;
+}
+
+/* Returns the @n services most likely to be started next, most likely
+ * first.  The strings belong to us; free the list with g_list_free(). */
+GList *
+hd_app_stats_get_likely (guint n)
+{
+  GList *services, *rest;
+
+  hd_app_stats_load ();
+
+  services = g_hash_table_get_keys (stats);
+  services = g_list_sort (services, hd_app_stats_cmp_likelihood);
+  if ((rest = g_list_nth (services, n)) != NULL)
+    {
+      if (rest->prev)
+        rest->prev->next = NULL;
+      else
+        services = NULL;
+      g_list_free (rest);
+    }
+  return services;
+}
@@ -0,0 +1,46 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Statistics of which applications the user starts: how often, at what
+ * time of the day and after which other application.  They are kept in
+ * ~/.cache/hildon-desktop/app-stats and used to guess what will be
+ * started next.  Applications are known by their D-Bus service.
+ */
+
+#ifndef __HD_APP_STATS_H__
+#define __HD_APP_STATS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+void     hd_app_stats_launched       (const gchar *service);
+void     hd_app_stats_flush          (void);
+void     hd_app_stats_set_footprint  (const gchar *service, gsize footprint);
+gsize    hd_app_stats_get_footprint  (const gchar *service);
+
+gdouble  hd_app_stats_get_likelihood (const gchar *service);
+GList   *hd_app_stats_get_likely     (guint n);
+
+G_END_DECLS
+
+#endif /* __HD_APP_STATS_H__ */
@@ -0,0 +1,318 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hd-app-victims.h"
+
+#undef  G_LOG_DOMAIN
+#define G_LOG_DOMAIN "hd-app-victims"
+
+/*
+ * The score of an application is the memory it would give back divided
+ * by what it's expected to cost us to start it again:
+ *
+ *   footprint / (1 + launch_cost * chance * (1 + priority))
+ *
+ * footprint is its PSS in kB, or its unshared resident pages if the
+ * kernel has no smaps_rollup.  launch_cost is how long it took to show
+ * up last times, in ms.  chance is how likely it is to be wanted soon:
+ * 1 when just used, going down to half in HD_APP_VICTIMS_RECENCY.
+ * priority is X-Maemo-Prestarted-Priority.
+ *
+ * The candidates are kept in a heap with the best victim on top.  Scores
+ * change as applications grow and are left alone, so they are updated
+ * when they get older than HD_APP_VICTIMS_RESCORE and we need a victim.
+ */
+#define HD_APP_VICTIMS_RECENCY       (300.0)  /* s */
+#define HD_APP_VICTIMS_NEVER_USED    (HD_APP_VICTIMS_RECENCY * 9)
+#define HD_APP_VICTIMS_DEFAULT_COST  (2000)   /* ms */
+#define HD_APP_VICTIMS_RESCORE       (5)      /* s */
+
+typedef struct
+{
+  HdRunningApp *app;
+  guint         index;
+  gdouble       score;
+  time_t        scored;
+  gsize         footprint;  /* as read when it was scored */
+} HdAppVictim;
+
+struct _HdAppVictims
+{
+  GPtrArray  *heap;    /* of HdAppVictim, best first */
+  GHashTable *apps;    /* HdRunningApp -> HdAppVictim */
+};
+
+#define VICTIM(victims, i) \
+  ((HdAppVictim *) g_ptr_array_index ((victims)->heap, (i)))
+
+/* Where the footprints are read from. */
+static gchar *proc_root;
+
+/* Read the footprints of processes from @root instead of /proc.
+ * Only meant for testing. */
+void
+hd_app_victims_set_proc_root (const gchar *root)
+{
+  g_free (proc_root);
+  proc_root = g_strdup (root);
+}
+
+/* Returns how much memory a process would give back, in kB, from the
+ * contents of its smaps_rollup and statm files, either of which may be
+ * %NULL.  @page_size is in bytes. */
+gsize
+hd_app_victims_parse_footprint (const gchar *smaps_rollup,
+                                const gchar *statm, glong page_size)
+{
+  const gchar *line;
+  gulong size, resident, shared;
+
+  if (smaps_rollup && (line = strstr (smaps_rollup, "\nPss:")) != NULL)
+    {
+      gsize pss = g_ascii_strtoull (line + strlen ("\nPss:"), NULL, 10);
+      if (pss)
+        return pss;
+    }
+
+  /* size resident shared text lib data dt, in pages */
+  if (statm
+      && sscanf (statm, "%lu %lu %lu", &size, &resident, &shared) == 3
+      && resident > shared)
+    return (resident - shared) * (page_size / 1024);
+
+  return 0;
+}
+
+/* Returns how much memory @pid would give back, in kB. */
+gsize
+hd_app_victims_get_footprint (GPid pid)
+{
+  gchar *path, *smaps_rollup, *statm;
+  gsize footprint;
+
+  if (pid <= 0)
+    return 0;
+
+  path = g_strdup_printf ("%s/%d/smaps_rollup",
+                          proc_root ? proc_root : "/proc", pid);
+  if (!g_file_get_contents (path, &smaps_rollup, NULL, NULL))
+    smaps_rollup = NULL;
+  g_free (path);
+
+  path = g_strdup_printf ("%s/%d/statm",
+                          proc_root ? proc_root : "/proc", pid);
+  if (!g_file_get_contents (path, &statm, NULL, NULL))
+    statm = NULL;
+  g_free (path);
+
+  footprint = hd_app_victims_parse_footprint (smaps_rollup, statm,
+                                              sysconf (_SC_PAGESIZE));
+  g_free (smaps_rollup);
+  g_free (statm);
+
+  return footprint;
+}
+
+/* The score of an application with @footprint kB, which was last used
+ * at @last_used (0 if never) and took @launch_cost ms to start (0 if
+ * unknown). */
+gdouble
+hd_app_victims_compute_score (gsize footprint, guint launch_cost,
+                              time_t last_used, time_t now, gint priority)
+{
+  gdouble idle, chance;
+
+  if (!launch_cost)
+    launch_cost = HD_APP_VICTIMS_DEFAULT_COST;
+  idle = last_used ? MAX (difftime (now, last_used), 0)
+                   : HD_APP_VICTIMS_NEVER_USED;
+  chance = HD_APP_VICTIMS_RECENCY / (HD_APP_VICTIMS_RECENCY + idle);
+
+  return footprint / (1.0 + launch_cost * chance * (1 + MAX (priority, 0)));
+}
+
+static void
+hd_app_victims_score (HdAppVictim *victim, time_t now)
+{
+  HdRunningApp *app = victim->app;
+  HdLauncherApp *launcher = hd_running_app_get_launcher_app (app);
+
+  victim->footprint = hd_app_victims_get_footprint (
+                                        hd_running_app_get_pid (app));
+  victim->score = hd_app_victims_compute_score (victim->footprint,
+              hd_running_app_get_launch_cost (app),
+              hd_running_app_get_last_used (app), now,
+              launcher ? hd_launcher_app_get_priority (launcher) : 0);
+  victim->scored = now;
+}
+
+static void
+hd_app_victims_swap (HdAppVictims *victims, guint i, guint j)
+{
+  HdAppVictim *a = VICTIM (victims, i);
+  HdAppVictim *b = VICTIM (victims, j);
+
+  g_ptr_array_index (victims->heap, i) = b;
+  g_ptr_array_index (victims->heap, j) = a;
+  a->index = j;
+  b->index = i;
+}
+
+static void
+hd_app_victims_sift_up (HdAppVictims *victims, guint i)
+{
+  while (i > 0 && VICTIM (victims, i)->score
+                  > VICTIM (victims, (i - 1) / 2)->score)
+    {
+      hd_app_victims_swap (victims, i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+}
+
+static void
+hd_app_victims_sift_down (HdAppVictims *victims, guint i)
+{
+  guint n = victims->heap->len;
+
+  for (;;)
+    {
+      guint best = i, child;
+
+      for (child = 2 * i + 1; child <= 2 * i + 2 && child < n; child++)
+        if (VICTIM (victims, child)->score > VICTIM (victims, best)->score)
+          best = child;
+      if (best == i)
+        break;
+      hd_app_victims_swap (victims, i, best);
+      i = best;
+    }
+}
+
+HdAppVictims *
+hd_app_victims_new (void)
+{
+  HdAppVictims *victims = g_new0 (HdAppVictims, 1);
+
+  victims->heap = g_ptr_array_new ();
+  victims->apps = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                         NULL, g_free);
+  return victims;
+}
+
+void
+hd_app_victims_free (HdAppVictims *victims)
+{
+  g_ptr_array_free (victims->heap, TRUE);
+  g_hash_table_destroy (victims->apps);
+  g_free (victims);
+}
+
+/* @app must stay alive until it's removed. */
+void
+hd_app_victims_add (HdAppVictims *victims, HdRunningApp *app)
+{
+  HdAppVictim *victim;
+
+  if (g_hash_table_lookup (victims->apps, app))
+    return;
+
+  victim = g_new0 (HdAppVictim, 1);
+  victim->app = app;
+  hd_app_victims_score (victim, time (NULL));
+  victim->index = victims->heap->len;
+  g_ptr_array_add (victims->heap, victim);
+  g_hash_table_insert (victims->apps, app, victim);
+
+  hd_app_victims_sift_up (victims, victim->index);
+}
+
+void
+hd_app_victims_remove (HdAppVictims *victims, HdRunningApp *app)
+{
+  HdAppVictim *victim = g_hash_table_lookup (victims->apps, app);
+  guint i, last;
+
+  if (!victim)
+    return;
+
+  i = victim->index;
+  last = victims->heap->len - 1;
+  if (i != last)
+    hd_app_victims_swap (victims, i, last);
+  g_ptr_array_remove_index (victims->heap, last);
+  g_hash_table_remove (victims->apps, app);
+
+  if (i < victims->heap->len)
+    {
+      hd_app_victims_sift_down (victims, i);
+      hd_app_victims_sift_up (victims, i);
+    }
+}
+
+/* Returns the footprint of @app in kB as it was when it was last scored,
+ * or 0 if it's not among @victims. */
+gsize
+hd_app_victims_get_app_footprint (HdAppVictims *victims, HdRunningApp *app)
+{
+  HdAppVictim *victim = g_hash_table_lookup (victims->apps, app);
+
+  return victim ? victim->footprint : 0;
+}
+
+/* Returns the best application to get rid of, or %NULL. */
+HdRunningApp *
+hd_app_victims_peek (HdAppVictims *victims)
+{
+  time_t now = time (NULL);
+  gboolean rescored = FALSE;
+  guint i;
+
+  if (!victims->heap->len)
+    return NULL;
+
+  for (i = 0; i < victims->heap->len; i++)
+    {
+      HdAppVictim *victim = VICTIM (victims, i);
+
+      if (difftime (now, victim->scored) >= HD_APP_VICTIMS_RESCORE)
+        {
+          hd_app_victims_score (victim, now);
+          rescored = TRUE;
+        }
+    }
+
+  if (rescored)
+    for (i = victims->heap->len / 2; i-- > 0; )
+      hd_app_victims_sift_down (victims, i);
+
+  g_debug ("%s: %s, score %.1f", __FUNCTION__,
+           hd_running_app_get_id (VICTIM (victims, 0)->app),
+           VICTIM (victims, 0)->score);
+  return VICTIM (victims, 0)->app;
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Chooses which application to hibernate or kill when memory runs
+ * low: the one that gives back the most memory for the least expected
+ * cost of starting it again.
+ */
+
+#ifndef __HD_APP_VICTIMS_H__
+#define __HD_APP_VICTIMS_H__
+
+#include "hd-running-app.h"
+
+G_BEGIN_DECLS
+
+typedef struct _HdAppVictims HdAppVictims;
+
+HdAppVictims *hd_app_victims_new    (void);
+void          hd_app_victims_free   (HdAppVictims *victims);
+
+void          hd_app_victims_add    (HdAppVictims *victims,
+                                     HdRunningApp *app);
+void          hd_app_victims_remove (HdAppVictims *victims,
+                                     HdRunningApp *app);
+HdRunningApp *hd_app_victims_peek   (HdAppVictims *victims);
+gsize         hd_app_victims_get_app_footprint (HdAppVictims *victims,
+                                                HdRunningApp *app);
+
+gsize         hd_app_victims_get_footprint (GPid pid);
+
+gsize         hd_app_victims_parse_footprint (const gchar *smaps_rollup,
+                                              const gchar *statm,
+                                              glong        page_size);
+gdouble       hd_app_victims_compute_score   (gsize        footprint,
+                                              guint        launch_cost,
+                                              time_t       last_used,
+                                              time_t       now,
+                                              gint         priority);
+void          hd_app_victims_set_proc_root   (const gchar *root);
+
+G_END_DECLS
+
+#endif /* __HD_APP_VICTIMS_H__ */
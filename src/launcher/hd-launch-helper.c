@@ -0,0 +1,572 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "hd-launch-helper.h"
+
+/*
+ * The helper is forked at the very beginning of main(), so it's small
+ * and has no threads, X connections or GL mappings.  We talk to it over
+ * a SOCK_SEQPACKET socketpair.  A spawn request is an HdLaunchHelperMsg
+ * followed by the NUL-terminated arguments, the first of which must be
+ * a full path; the rest of the messages are just an HdLaunchHelperMsg.
+ * The answers are read by a watch on the socket, so we never block on
+ * the helper, however long exec() takes.  Children not started by the
+ * helper are handled by GLib as before.
+ */
+enum
+{
+  HD_LAUNCH_HELPER_SPAWN,    /* to the helper */
+  HD_LAUNCH_HELPER_SPAWNED,  /* @pid, or -1 and @value: errno */
+  HD_LAUNCH_HELPER_EXITED,   /* @pid, @value: wait status */
+};
+
+typedef struct
+{
+  guint32 type;
+  guint32 serial;
+  gint32  pid;
+  gint32  value;
+} HdLaunchHelperMsg;
+
+#define HD_LAUNCH_HELPER_MAX_MSG 8192
+
+/* How often to check whether the children of a lost helper are still
+ * around (s). */
+#define HD_LAUNCH_HELPER_ORPHAN_POLL 2
+
+#define OOM_DISABLE "0"
+
+typedef struct
+{
+  GChildWatchFunc func;
+  gpointer        data;
+} HdLaunchHelperWatch;
+
+/* A spawn request the helper hasn't answered yet. */
+typedef struct
+{
+  gchar              *path;
+  gboolean            auto_reap;
+  HdLaunchHelperFunc  func;
+  gpointer            data;
+} HdLaunchHelperPending;
+
+/* In hildon-desktop */
+static int         helper_fd = -1;
+static pid_t       helper_pid;
+static guint32     helper_serial;
+static guint       helper_watch;
+static GHashTable *pending;                  /* serial -> HdLaunchHelperPending */
+static GHashTable *children;                 /* pid -> HdLaunchHelperWatch */
+static guint       orphans_poll;
+
+/* In the helper */
+static volatile sig_atomic_t got_sigchld;
+
+/* Runs in the child before exec(). */
+static void
+hd_launch_helper_child_setup (gpointer unused)
+{
+  int priority;
+  int fd;
+  int write_result;
+
+  /* If the child process inherited desktop's high priority,
+   * give child default priority */
+  errno = 0;
+  priority = getpriority (PRIO_PROCESS, 0);
+
+  if (!errno && priority < 0)
+  {
+    setpriority (PRIO_PROCESS, 0, 0);
+  }
+
+  /* Unprotect from OOM */
+  fd = open ("/proc/self/oom_adj", O_WRONLY);
+  if (fd >= 0)
+  {
+    write_result = write (fd, OOM_DISABLE, sizeof (OOM_DISABLE));
+    close (fd);
+  }
+}
+
+/*
+ * The helper
+ */
+
+static void
+hd_launch_helper_send (int fd, guint32 type, guint32 serial,
+                       gint32 pid, gint32 value)
+{
+  HdLaunchHelperMsg msg;
+
+  memset (&msg, 0, sizeof (msg));
+  msg.type = type;
+  msg.serial = serial;
+  msg.pid = pid;
+  msg.value = value;
+  while (send (fd, &msg, sizeof (msg), MSG_NOSIGNAL) < 0 && errno == EINTR)
+    ;
+}
+
+static void
+hd_launch_helper_sigchld (int sig)
+{
+  got_sigchld = 1;
+}
+
+static void
+hd_launch_helper_reap (int fd)
+{
+  pid_t pid;
+  int status;
+
+  while ((pid = waitpid (-1, &status, WNOHANG)) > 0)
+    hd_launch_helper_send (fd, HD_LAUNCH_HELPER_EXITED, 0, pid, status);
+}
+
+/* Start the program in @args, @len bytes of NUL-terminated arguments.
+ * A pipe which is closed on exec() tells us whether it worked. */
+static void
+hd_launch_helper_exec (int fd, guint32 serial, gchar *args, gsize len,
+                       const sigset_t *mask)
+{
+  gchar **argv;
+  gint argc, i;
+  gsize pos;
+  int err, pipefd[2];
+  pid_t pid = -1;
+
+  for (argc = 0, pos = 0; pos < len; pos += strlen (args + pos) + 1)
+    argc++;
+  if (!argc || args[len - 1] != '\0')
+    {
+      hd_launch_helper_send (fd, HD_LAUNCH_HELPER_SPAWNED, serial,
+                             -1, EINVAL);
+      return;
+    }
+
+  argv = g_new (gchar *, argc + 1);
+  for (i = 0, pos = 0; i < argc; i++, pos += strlen (args + pos) + 1)
+    argv[i] = args + pos;
+  argv[argc] = NULL;
+
+  err = 0;
+  if (pipe (pipefd) < 0)
+    err = errno;
+  else if ((pid = fork ()) == 0)
+    {
+      close (pipefd[0]);
+      fcntl (pipefd[1], F_SETFD, FD_CLOEXEC);
+      signal (SIGCHLD, SIG_DFL);
+      sigprocmask (SIG_SETMASK, mask, NULL);
+      hd_launch_helper_child_setup (NULL);
+
+      execv (argv[0], argv);
+      err = errno;
+      while (write (pipefd[1], &err, sizeof (err)) < 0 && errno == EINTR)
+        ;
+      _exit (127);
+    }
+  else
+    {
+      close (pipefd[1]);
+      if (pid < 0)
+        err = errno;
+      else
+        while (read (pipefd[0], &err, sizeof (err)) < 0 && errno == EINTR)
+          ;
+      close (pipefd[0]);
+    }
+  g_free (argv);
+
+  /* If exec() failed the child will be reported as exited as well,
+   * but nobody will be waiting for it. */
+  hd_launch_helper_send (fd, HD_LAUNCH_HELPER_SPAWNED, serial,
+                         err ? -1 : pid, err);
+}
+
+/* The main loop of the helper, until hildon-desktop goes away. */
+static void
+hd_launch_helper_run (int fd)
+{
+  struct sigaction sa;
+  sigset_t block, orig;
+  gchar *buf;
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = hd_launch_helper_sigchld;
+  sigaction (SIGCHLD, &sa, NULL);
+
+  /* SIGCHLD is only let in while we're waiting in pselect(), so we
+   * can't miss one between checking and waiting. */
+  sigemptyset (&block);
+  sigaddset (&block, SIGCHLD);
+  sigprocmask (SIG_BLOCK, &block, &orig);
+
+  buf = g_malloc (HD_LAUNCH_HELPER_MAX_MSG);
+  for (;;)
+    {
+      HdLaunchHelperMsg *msg = (HdLaunchHelperMsg *) buf;
+      fd_set fds;
+      ssize_t n;
+
+      if (got_sigchld)
+        {
+          got_sigchld = 0;
+          hd_launch_helper_reap (fd);
+        }
+
+      FD_ZERO (&fds);
+      FD_SET (fd, &fds);
+      if (pselect (fd + 1, &fds, NULL, NULL, NULL, &orig) < 0)
+        continue;
+
+      n = recv (fd, buf, HD_LAUNCH_HELPER_MAX_MSG, 0);
+      if (n == 0 || (n < 0 && errno != EINTR))
+        break;
+      if (n < (ssize_t) sizeof (*msg) || msg->type != HD_LAUNCH_HELPER_SPAWN)
+        continue;
+
+      hd_launch_helper_exec (fd, msg->serial, buf + sizeof (*msg),
+                             n - sizeof (*msg), &orig);
+    }
+
+  /* Whatever is still running is inherited by init. */
+  _exit (0);
+}
+
+/*
+ * Start the helper.  This must be called before anything else, even
+ * g_thread_init(), so that it doesn't inherit more than necessary.
+ * If it can't be started we'll just fork ourselves.
+ */
+void
+hd_launch_helper_start (void)
+{
+  int sv[2];
+  pid_t pid;
+
+  if (socketpair (AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+    return;
+
+  if ((pid = fork ()) < 0)
+    {
+      close (sv[0]);
+      close (sv[1]);
+      return;
+    }
+
+  if (pid == 0)
+    {
+      close (sv[0]);
+      fcntl (sv[1], F_SETFD, FD_CLOEXEC);
+      hd_launch_helper_run (sv[1]);
+    }
+
+  close (sv[1]);
+  fcntl (sv[0], F_SETFD, FD_CLOEXEC);
+  helper_fd = sv[0];
+  helper_pid = pid;
+}
+
+/*
+ * hildon-desktop's side
+ */
+
+static void
+hd_launch_helper_pending_free (HdLaunchHelperPending *req)
+{
+  g_free (req->path);
+  g_free (req);
+}
+
+static void
+hd_launch_helper_exited (GPid pid, gint status)
+{
+  HdLaunchHelperWatch *watch;
+
+  if (!children
+      || !(watch = g_hash_table_lookup (children, GINT_TO_POINTER (pid))))
+    return;
+
+  g_hash_table_steal (children, GINT_TO_POINTER (pid));
+  if (watch->func)
+    watch->func (pid, status, watch->data);
+  g_free (watch);
+}
+
+/* The children of a lost helper are inherited by init, so we can only
+ * tell they're gone by checking now and then. */
+static gboolean
+hd_launch_helper_poll_orphans (gpointer unused)
+{
+  GHashTableIter iter;
+  gpointer key;
+  GSList *gone, *li;
+
+  gone = NULL;
+  if (children)
+    {
+      g_hash_table_iter_init (&iter, children);
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        if (kill (GPOINTER_TO_INT (key), 0) < 0 && errno == ESRCH)
+          gone = g_slist_prepend (gone, key);
+    }
+
+  /* We don't know how they exited. */
+  for (li = gone; li; li = li->next)
+    hd_launch_helper_exited (GPOINTER_TO_INT (li->data), 0);
+  g_slist_free (gone);
+
+  if (children && g_hash_table_size (children) > 0)
+    return TRUE;
+  orphans_poll = 0;
+  return FALSE;
+}
+
+static void
+hd_launch_helper_lost (void)
+{
+  GHashTable *unanswered;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_warning ("%s: lost the launch helper, starting applications directly",
+             __FUNCTION__);
+
+  if (helper_watch)
+    {
+      g_source_remove (helper_watch);
+      helper_watch = 0;
+    }
+  close (helper_fd);
+  helper_fd = -1;
+  waitpid (helper_pid, NULL, WNOHANG);
+
+  /* Whatever it started is still ours to watch. */
+  if (children && g_hash_table_size (children) > 0 && !orphans_poll)
+    orphans_poll = g_timeout_add_seconds (HD_LAUNCH_HELPER_ORPHAN_POLL,
+                                          hd_launch_helper_poll_orphans,
+                                          NULL);
+
+  /* We'll never know whether these were started. */
+  if ((unanswered = pending) != NULL)
+    {
+      pending = NULL;
+      g_hash_table_iter_init (&iter, unanswered);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          HdLaunchHelperPending *req = value;
+
+          if (req->func)
+            req->func (0, req->data);
+        }
+      g_hash_table_destroy (unanswered);
+    }
+}
+
+static gboolean
+hd_launch_helper_recv (HdLaunchHelperMsg *msg)
+{
+  ssize_t n;
+
+  do
+    n = recv (helper_fd, msg, sizeof (*msg), 0);
+  while (n < 0 && errno == EINTR);
+
+  return n == sizeof (*msg);
+}
+
+/* The helper answered spawn request @msg->serial. */
+static void
+hd_launch_helper_spawned (const HdLaunchHelperMsg *msg)
+{
+  HdLaunchHelperPending *req;
+  gpointer key = GUINT_TO_POINTER (msg->serial);
+
+  if (!pending || !(req = g_hash_table_lookup (pending, key)))
+    return;
+  g_hash_table_steal (pending, key);
+
+  if (msg->pid < 0)
+    {
+      g_warning ("%s: couldn't start %s: %s", __FUNCTION__, req->path,
+                 g_strerror (msg->value));
+      if (req->func)
+        req->func (0, req->data);
+    }
+  else
+    {
+      /* The exit of the child always comes after this message, so the
+       * callback has the chance to watch it. */
+      if (!req->auto_reap)
+        {
+          if (!children)
+            children = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+          g_hash_table_insert (children, GINT_TO_POINTER (msg->pid),
+                               g_new0 (HdLaunchHelperWatch, 1));
+        }
+      if (req->func)
+        req->func (msg->pid, req->data);
+    }
+
+  hd_launch_helper_pending_free (req);
+}
+
+static gboolean
+hd_launch_helper_io (GIOChannel *channel, GIOCondition cond, gpointer unused)
+{
+  HdLaunchHelperMsg msg;
+
+  if (!(cond & G_IO_IN) || !hd_launch_helper_recv (&msg))
+    {
+      helper_watch = 0;
+      hd_launch_helper_lost ();
+      return FALSE;
+    }
+
+  if (msg.type == HD_LAUNCH_HELPER_SPAWNED)
+    hd_launch_helper_spawned (&msg);
+  else if (msg.type == HD_LAUNCH_HELPER_EXITED)
+    hd_launch_helper_exited (msg.pid, msg.value);
+
+  return TRUE;
+}
+
+/* Returns whether the request has been sent to the helper. */
+static gboolean
+hd_launch_helper_request (gchar **argv, gboolean auto_reap,
+                          HdLaunchHelperFunc func, gpointer data)
+{
+  HdLaunchHelperPending *req;
+  HdLaunchHelperMsg msg;
+  GString *packet;
+  gboolean sent;
+  gint i;
+
+  if (helper_fd < 0)
+    return FALSE;
+
+  if (!helper_watch)
+    {
+      GIOChannel *channel = g_io_channel_unix_new (helper_fd);
+      helper_watch = g_io_add_watch (channel, G_IO_IN | G_IO_HUP | G_IO_ERR,
+                                     hd_launch_helper_io, NULL);
+      g_io_channel_unref (channel);
+    }
+
+  memset (&msg, 0, sizeof (msg));
+  msg.type = HD_LAUNCH_HELPER_SPAWN;
+  msg.serial = ++helper_serial;
+  packet = g_string_new_len ((gchar *) &msg, sizeof (msg));
+  for (i = 0; argv[i]; i++)
+    g_string_append_len (packet, argv[i], strlen (argv[i]) + 1);
+
+  /* Too long for the helper, let GLib do it. */
+  if (packet->len > HD_LAUNCH_HELPER_MAX_MSG)
+    {
+      g_string_free (packet, TRUE);
+      return FALSE;
+    }
+
+  sent = send (helper_fd, packet->str, packet->len, MSG_NOSIGNAL)
+    == (ssize_t) packet->len;
+  g_string_free (packet, TRUE);
+
+  if (!sent)
+    {
+      hd_launch_helper_lost ();
+      return FALSE;
+    }
+
+  req = g_new (HdLaunchHelperPending, 1);
+  req->path = g_strdup (argv[0]);
+  req->auto_reap = auto_reap;
+  req->func = func;
+  req->data = data;
+  if (!pending)
+    pending = g_hash_table_new_full (NULL, NULL, NULL,
+                         (GDestroyNotify) hd_launch_helper_pending_free);
+  g_hash_table_insert (pending, GUINT_TO_POINTER (msg.serial), req);
+
+  return TRUE;
+}
+
+/*
+ * Start @argv, whose first element must be a full path, as
+ * g_spawn_async() would, with the priority and OOM adjustment of an
+ * application.  If it returns %TRUE, @func is called once with the pid
+ * of the child when it's running, or with 0 if it couldn't be started.
+ * That can happen before this function returns.  Unless @auto_reap,
+ * @func must watch the child with hd_launch_helper_child_watch_add().
+ */
+gboolean
+hd_launch_helper_spawn (gchar **argv, gboolean auto_reap,
+                        HdLaunchHelperFunc func, gpointer data)
+{
+  GPid pid;
+
+  if (hd_launch_helper_request (argv, auto_reap, func, data))
+    return TRUE;
+
+  if (!g_spawn_async (NULL, argv, NULL,
+                      auto_reap ? 0 : G_SPAWN_DO_NOT_REAP_CHILD,
+                      hd_launch_helper_child_setup, NULL,
+                      &pid, NULL))
+    return FALSE;
+
+  if (func)
+    func (pid, data);
+  return TRUE;
+}
+
+/* Like g_child_watch_add(), for children of hd_launch_helper_spawn(). */
+void
+hd_launch_helper_child_watch_add (GPid pid, GChildWatchFunc func,
+                                  gpointer data)
+{
+  HdLaunchHelperWatch *watch;
+
+  if (children
+      && (watch = g_hash_table_lookup (children, GINT_TO_POINTER (pid))))
+    {
+      watch->func = func;
+      watch->data = data;
+    }
+  else
+    g_child_watch_add (pid, func, data);
+}
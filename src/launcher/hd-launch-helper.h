@@ -0,0 +1,52 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Starts applications from a small process forked before we've grown
+ * big, so launching doesn't have to fork the whole of hildon-desktop.
+ * The helper runs the applications and tells us when they exit.
+ */
+
+#ifndef __HD_LAUNCH_HELPER_H__
+#define __HD_LAUNCH_HELPER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Called with the pid of a child of hd_launch_helper_spawn() when it's
+ * running, or with 0 if it couldn't be started. */
+typedef void (*HdLaunchHelperFunc) (GPid     pid,
+                                    gpointer data);
+
+void     hd_launch_helper_start  (void);
+
+gboolean hd_launch_helper_spawn  (gchar             **argv,
+                                  gboolean            auto_reap,
+                                  HdLaunchHelperFunc  func,
+                                  gpointer            data);
+void     hd_launch_helper_child_watch_add (GPid            pid,
+                                           GChildWatchFunc func,
+                                           gpointer        data);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCH_HELPER_H__ */
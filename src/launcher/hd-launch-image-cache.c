@@ -0,0 +1,314 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "hd-launch-image-cache.h"
+#include "hd-app-stats.h"
+
+#include "hildon-desktop.h"
+#include "hd-render-manager.h"
+#include "hd-transition.h"
+
+/* How many images to keep; loading screenshots are ~256k each. */
+#define HD_LAUNCH_IMAGE_CACHE_SIZE \
+  (hd_transition_get_int ("launcher_launch", "prefetch", 4))
+
+/* Seconds of quiet before we prefetch the likely next applications. */
+#define HD_LAUNCH_IMAGE_CACHE_FREQUENT_DELAY 5
+
+typedef struct
+{
+  gchar      *filename;
+  time_t      mtime;
+  CoglHandle  texture;
+} HdLaunchImage;
+
+/*
+ * Prefetching is done in two steps: a thread reads the file, so the
+ * data is in the page cache by the time we load it, then we create the
+ * texture in the main thread at low priority.  Only the latter can talk
+ * to GL.
+ */
+static GQueue       cache = { NULL, NULL, 0 }; /* most recently used first */
+static GHashTable  *prefetching;               /* filenames being prefetched */
+static GThreadPool *readers;
+static guint        frequent_timeout;
+
+static gchar *
+hd_launch_image_cache_path_for_service (const gchar *service,
+                                        gboolean portrait)
+{
+  /* Daft service names don't get a loading picture. */
+  if (!service || strchr (service, '/') || service[0] == '.')
+    return NULL;
+
+  return g_strdup_printf (portrait ? "%s/.cache/launch/%s_portrait.pvr"
+                                   : "%s/.cache/launch/%s.pvr",
+                          getenv ("HOME"), service);
+}
+
+/* Returns the file the loading screenshot of @app would be stored in,
+ * or %NULL if it can't have one. */
+gchar *
+hd_launch_image_cache_get_path (HdLauncherApp *app, gboolean portrait)
+{
+  return hd_launch_image_cache_path_for_service (
+                                hd_launcher_app_get_service (app), portrait);
+}
+
+static void
+hd_launch_image_free (HdLaunchImage *image)
+{
+  cogl_texture_unref (image->texture);
+  g_free (image->filename);
+  g_free (image);
+}
+
+static GList *
+hd_launch_image_cache_find (const gchar *filename)
+{
+  GList *li;
+
+  for (li = cache.head; li; li = li->next)
+    if (!strcmp (((HdLaunchImage *)li->data)->filename, filename))
+      return li;
+  return NULL;
+}
+
+static void
+hd_launch_image_cache_remove (const gchar *filename)
+{
+  GList *li;
+
+  if ((li = hd_launch_image_cache_find (filename)) != NULL)
+    {
+      hd_launch_image_free (li->data);
+      g_queue_delete_link (&cache, li);
+    }
+}
+
+/* Take over @texture, which was loaded from @filename. */
+static void
+hd_launch_image_cache_insert (const gchar *filename, time_t mtime,
+                              CoglHandle texture)
+{
+  HdLaunchImage *image;
+  guint size;
+
+  hd_launch_image_cache_remove (filename);
+
+  image = g_new (HdLaunchImage, 1);
+  image->filename = g_strdup (filename);
+  image->mtime = mtime;
+  image->texture = texture;
+  g_queue_push_head (&cache, image);
+
+  size = MAX (HD_LAUNCH_IMAGE_CACHE_SIZE, 0);
+  while (cache.length > size)
+    hd_launch_image_free (g_queue_pop_tail (&cache));
+}
+
+/* Load @filename and put it in the cache.  Returns the texture which
+ * the image was loaded into, or %NULL. */
+static ClutterActor *
+hd_launch_image_cache_load (const gchar *filename, time_t mtime)
+{
+  ClutterActor *texture;
+  CoglHandle handle;
+
+  texture = clutter_texture_new_from_file (filename, NULL);
+  if (!texture)
+    return NULL;
+
+  handle = clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (texture));
+  if (handle != COGL_INVALID_HANDLE && HD_LAUNCH_IMAGE_CACHE_SIZE > 0)
+    hd_launch_image_cache_insert (filename, mtime,
+                                  cogl_texture_ref (handle));
+  return texture;
+}
+
+/*
+ * Returns a new texture showing @filename, from the cache if we have it
+ * and it's up to date, otherwise it's loaded now.  Returns %NULL if the
+ * file is not there or couldn't be loaded.
+ */
+ClutterActor *
+hd_launch_image_cache_get_texture (const gchar *filename)
+{
+  struct stat st;
+  GList *li;
+
+  if (stat (filename, &st) != 0 || access (filename, R_OK) != 0)
+    {
+      hd_launch_image_cache_remove (filename);
+      return NULL;
+    }
+
+  li = hd_launch_image_cache_find (filename);
+  if (li && ((HdLaunchImage *)li->data)->mtime == st.st_mtime)
+    {
+      HdLaunchImage *image = li->data;
+      ClutterActor *texture;
+
+      g_queue_unlink (&cache, li);
+      g_queue_push_head_link (&cache, li);
+
+      texture = clutter_texture_new ();
+      clutter_texture_set_cogl_texture (CLUTTER_TEXTURE (texture),
+                                        image->texture);
+      return texture;
+    }
+
+  return hd_launch_image_cache_load (filename, st.st_mtime);
+}
+
+static gboolean
+hd_launch_image_cache_prefetch_idle (gpointer data)
+{
+  gchar *filename = data;
+  struct stat st;
+  GList *li;
+
+  if (stat (filename, &st) == 0
+      && (!(li = hd_launch_image_cache_find (filename))
+          || ((HdLaunchImage *)li->data)->mtime != st.st_mtime))
+    {
+      ClutterActor *texture;
+
+      g_debug ("%s: %s", __FUNCTION__, filename);
+      if ((texture = hd_launch_image_cache_load (filename, st.st_mtime)))
+        clutter_actor_destroy (g_object_ref_sink (texture));
+    }
+
+  g_hash_table_remove (prefetching, filename);
+  return FALSE;
+}
+
+/* Runs in a reader thread. */
+static void
+hd_launch_image_cache_read (gpointer data, gpointer unused)
+{
+  gchar buf[16 * 1024];
+  int fd;
+
+  if ((fd = open (data, O_RDONLY)) >= 0)
+    {
+      while (read (fd, buf, sizeof (buf)) > 0)
+        ;
+      close (fd);
+    }
+
+  clutter_threads_add_idle_full (G_PRIORITY_LOW,
+                                 hd_launch_image_cache_prefetch_idle,
+                                 data, NULL);
+}
+
+static void
+hd_launch_image_cache_prefetch_file (gchar *filename)
+{
+  struct stat st;
+  GList *li;
+
+  if (HD_LAUNCH_IMAGE_CACHE_SIZE <= 0 || stat (filename, &st) != 0
+      || ((li = hd_launch_image_cache_find (filename))
+          && ((HdLaunchImage *)li->data)->mtime == st.st_mtime))
+    {
+      g_free (filename);
+      return;
+    }
+
+  if (!prefetching)
+    prefetching = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, NULL);
+  if (g_hash_table_lookup (prefetching, filename))
+    {
+      g_free (filename);
+      return;
+    }
+  g_hash_table_insert (prefetching, filename, filename);
+
+  if (!readers && !hd_disable_threads ())
+    readers = g_thread_pool_new (hd_launch_image_cache_read, NULL,
+                                 1, FALSE, NULL);
+  if (readers)
+    g_thread_pool_push (readers, filename, NULL);
+  else
+    g_idle_add_full (G_PRIORITY_LOW, hd_launch_image_cache_prefetch_idle,
+                     filename, NULL);
+}
+
+/* Load the loading screenshot of @app in the background, if it has one,
+ * for the current orientation. */
+void
+hd_launch_image_cache_prefetch (HdLauncherApp *app)
+{
+  gchar *filename;
+
+  filename = hd_launch_image_cache_get_path (app,
+                          STATE_IS_PORTRAIT (hd_render_manager_get_state ()));
+  if (filename)
+    hd_launch_image_cache_prefetch_file (filename);
+}
+
+static gboolean
+hd_launch_image_cache_frequent_timeout (gpointer unused)
+{
+  GList *services, *li;
+  gboolean portrait;
+
+  frequent_timeout = 0;
+
+  portrait = STATE_IS_PORTRAIT (hd_render_manager_get_state ());
+  services = hd_app_stats_get_likely (HD_LAUNCH_IMAGE_CACHE_SIZE);
+  for (li = services; li; li = li->next)
+    {
+      gchar *filename;
+
+      filename = hd_launch_image_cache_path_for_service (li->data, portrait);
+      if (filename)
+        hd_launch_image_cache_prefetch_file (filename);
+    }
+  g_list_free (services);
+
+  return FALSE;
+}
+
+/* Prefetch the loading screenshots of the applications most likely to
+ * be launched next when things have calmed down. */
+void
+hd_launch_image_cache_prefetch_frequent (void)
+{
+  if (frequent_timeout)
+    g_source_remove (frequent_timeout);
+  frequent_timeout = g_timeout_add_seconds_full (G_PRIORITY_LOW,
+                                  HD_LAUNCH_IMAGE_CACHE_FREQUENT_DELAY,
+                                  hd_launch_image_cache_frequent_timeout,
+                                  NULL, NULL);
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * A small LRU cache of the loading screenshots of applications
+ * (~/.cache/launch/<service>[_portrait].pvr), so that the application
+ * start transition doesn't have to wait for the image to be loaded.
+ */
+
+#ifndef __HD_LAUNCH_IMAGE_CACHE_H__
+#define __HD_LAUNCH_IMAGE_CACHE_H__
+
+#include <clutter/clutter.h>
+#include "hd-launcher-app.h"
+
+G_BEGIN_DECLS
+
+gchar        *hd_launch_image_cache_get_path (HdLauncherApp *app,
+                                              gboolean portrait);
+ClutterActor *hd_launch_image_cache_get_texture (const gchar *filename);
+
+void hd_launch_image_cache_prefetch (HdLauncherApp *app);
+void hd_launch_image_cache_prefetch_frequent (void);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCH_IMAGE_CACHE_H__ */
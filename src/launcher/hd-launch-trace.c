@@ -0,0 +1,274 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hd-launch-trace.h"
+
+#undef  G_LOG_DOMAIN
+#define G_LOG_DOMAIN "hd-launch-trace"
+
+/*
+ * A launch begins with a click or an activation and ends when the start
+ * transition is over, or HD_LAUNCH_TRACE_TIMEOUT after the last phase
+ * if it never gets there (relaunching a running app doesn't map
+ * anything, for example).  For every phase we keep the time it took
+ * from the previous phase seen, and for finished launches the total,
+ * of the last HD_LAUNCH_TRACE_SAMPLES launches of each application.
+ * Launches are known by the launcher id of the application.
+ */
+#define HD_LAUNCH_TRACE_SAMPLES  64
+#define HD_LAUNCH_TRACE_TIMEOUT  20  /* s */
+#define HD_LAUNCH_TRACE_TOTAL    HD_LAUNCH_TRACE_N_PHASES
+
+typedef struct
+{
+  gchar    *id;
+  GTimeVal  stamps[HD_LAUNCH_TRACE_N_PHASES];
+  guint     seen;                    /* 1 << phase */
+  guint     timeout_id;
+} HdLaunchTrace;
+
+typedef struct
+{
+  guint samples[HD_LAUNCH_TRACE_N_PHASES + 1][HD_LAUNCH_TRACE_SAMPLES];
+  guint n[HD_LAUNCH_TRACE_N_PHASES + 1];
+} HdLaunchTraceStats;
+
+static const gchar *phase_names[HD_LAUNCH_TRACE_N_PHASES + 1] =
+{
+  "click", "activate", "request", "map", "damage", "shown", "total"
+};
+
+static GHashTable *traces;   /* id -> HdLaunchTrace in progress */
+static GHashTable *stats;    /* id -> HdLaunchTraceStats */
+static gchar      *current;  /* the last launch begun */
+
+#define SEEN(trace, phase) ((trace)->seen & (1 << (phase)))
+
+static void
+hd_launch_trace_add_sample (HdLaunchTraceStats *st, guint slot, glong ms)
+{
+  st->samples[slot][st->n[slot]++ % HD_LAUNCH_TRACE_SAMPLES] = MAX (ms, 0);
+}
+
+static glong
+hd_launch_trace_ms (const GTimeVal *from, const GTimeVal *to)
+{
+  return (to->tv_sec - from->tv_sec) * 1000
+    + (to->tv_usec - from->tv_usec) / 1000;
+}
+
+/* Account the phases of @trace and forget about it. */
+static void
+hd_launch_trace_finish (HdLaunchTrace *trace)
+{
+  HdLaunchTraceStats *st;
+  const GTimeVal *first = NULL, *prev = NULL;
+  GString *line;
+  guint i;
+
+  if (!stats)
+    stats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  if (!(st = g_hash_table_lookup (stats, trace->id)))
+    {
+      st = g_new0 (HdLaunchTraceStats, 1);
+      g_hash_table_insert (stats, g_strdup (trace->id), st);
+    }
+
+  line = g_string_new (NULL);
+  for (i = 0; i < HD_LAUNCH_TRACE_N_PHASES; i++)
+    {
+      if (!SEEN (trace, i))
+        continue;
+      if (prev)
+        {
+          glong ms = hd_launch_trace_ms (prev, &trace->stamps[i]);
+
+          hd_launch_trace_add_sample (st, i, ms);
+          g_string_append_printf (line, " %s +%ldms", phase_names[i], ms);
+        }
+      else
+        {
+          first = &trace->stamps[i];
+          g_string_append_printf (line, " %s", phase_names[i]);
+        }
+      prev = &trace->stamps[i];
+    }
+
+  /* Only launches that were seen through tell the whole story. */
+  if (SEEN (trace, HD_LAUNCH_TRACE_SHOWN) && first != prev)
+    hd_launch_trace_add_sample (st, HD_LAUNCH_TRACE_TOTAL,
+                                hd_launch_trace_ms (first, prev));
+
+  g_debug ("%s: %s:%s", __FUNCTION__, trace->id, line->str);
+  g_string_free (line, TRUE);
+
+  g_hash_table_remove (traces, trace->id);
+}
+
+static gboolean
+hd_launch_trace_timeout (gpointer data)
+{
+  HdLaunchTrace *trace = data;
+
+  trace->timeout_id = 0;
+  hd_launch_trace_finish (trace);
+  return FALSE;
+}
+
+static void
+hd_launch_trace_free (HdLaunchTrace *trace)
+{
+  if (trace->timeout_id)
+    g_source_remove (trace->timeout_id);
+  g_free (trace->id);
+  g_free (trace);
+}
+
+static HdLaunchTrace *
+hd_launch_trace_begin (const gchar *id)
+{
+  HdLaunchTrace *trace;
+
+  if (!traces)
+    traces = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                    (GDestroyNotify) hd_launch_trace_free);
+  if ((trace = g_hash_table_lookup (traces, id)) != NULL)
+    hd_launch_trace_finish (trace);
+
+  trace = g_new0 (HdLaunchTrace, 1);
+  trace->id = g_strdup (id);
+  g_hash_table_insert (traces, trace->id, trace);
+
+  /* @id may be @current. */
+  id = g_strdup (id);
+  g_free (current);
+  current = (gchar *) id;
+  return trace;
+}
+
+/*
+ * The launch of @id got to @phase.  %NULL @id means the launch begun
+ * last, for the phases that don't know which application they are for.
+ * Phases other than the first ones are ignored unless we have seen the
+ * launch begin.
+ */
+void
+hd_launch_trace_mark (const gchar *id, HdLaunchTracePhase phase)
+{
+  HdLaunchTrace *trace;
+
+  g_return_if_fail (phase < HD_LAUNCH_TRACE_N_PHASES);
+
+  if (!id && !(id = current))
+    return;
+  trace = traces ? g_hash_table_lookup (traces, id) : NULL;
+
+  if (phase == HD_LAUNCH_TRACE_CLICK)
+    trace = hd_launch_trace_begin (id);
+  else if (phase == HD_LAUNCH_TRACE_ACTIVATE)
+    {
+      /* Clicking is followed by activation, but not the other way. */
+      if (!trace || trace->seen != 1 << HD_LAUNCH_TRACE_CLICK)
+        trace = hd_launch_trace_begin (id);
+    }
+  else if (!trace || SEEN (trace, phase))
+    return;
+  /* A launch that failed may still have its loading screen removed. */
+  else if (phase == HD_LAUNCH_TRACE_SHOWN
+           && !SEEN (trace, HD_LAUNCH_TRACE_MAP))
+    return;
+
+  g_get_current_time (&trace->stamps[phase]);
+  trace->seen |= 1 << phase;
+
+  if (phase == HD_LAUNCH_TRACE_SHOWN)
+    {
+      hd_launch_trace_finish (trace);
+      return;
+    }
+
+  if (trace->timeout_id)
+    g_source_remove (trace->timeout_id);
+  trace->timeout_id = g_timeout_add_seconds (HD_LAUNCH_TRACE_TIMEOUT,
+                                             hd_launch_trace_timeout, trace);
+}
+
+static gint
+hd_launch_trace_cmp_uint (gconstpointer a, gconstpointer b)
+{
+  guint ua = *(const guint *) a, ub = *(const guint *) b;
+
+  return ua < ub ? -1 : ua > ub;
+}
+
+/* Call @func with the percentiles of every phase of every application
+ * we have seen launched. */
+void
+hd_launch_trace_foreach (HdLaunchTraceFunc func, gpointer data)
+{
+  GHashTableIter iter;
+  gpointer id, value;
+  guint sorted[HD_LAUNCH_TRACE_SAMPLES];
+  guint i, n;
+
+  if (!stats)
+    return;
+
+  g_hash_table_iter_init (&iter, stats);
+  while (g_hash_table_iter_next (&iter, &id, &value))
+    {
+      HdLaunchTraceStats *st = value;
+
+      for (i = 0; i <= HD_LAUNCH_TRACE_TOTAL; i++)
+        {
+          if (!st->n[i])
+            continue;
+
+          n = MIN (st->n[i], HD_LAUNCH_TRACE_SAMPLES);
+          memcpy (sorted, st->samples[i], n * sizeof (sorted[0]));
+          qsort (sorted, n, sizeof (sorted[0]), hd_launch_trace_cmp_uint);
+          func (id, phase_names[i], st->n[i], sorted[(n - 1) * 50 / 100],
+                sorted[(n - 1) * 90 / 100], sorted[n - 1], data);
+        }
+    }
+}
+
+static void
+hd_launch_trace_dump_one (const gchar *id, const gchar *phase, guint n,
+                          guint p50, guint p90, guint max, gpointer data)
+{
+  g_debug ("\t%s %s: n=%u, p50=%ums, p90=%ums, max=%ums\n",
+           id, phase, n, p50, p90, max);
+}
+
+void
+hd_launch_trace_dump (void)
+{
+  g_debug ("%s:\n", __FUNCTION__);
+  hd_launch_trace_foreach (hd_launch_trace_dump_one, NULL);
+}
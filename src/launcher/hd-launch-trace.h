@@ -0,0 +1,63 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Timestamps the phases of application launches, so we can tell where
+ * the time goes: in us, in the application or in the compositor.
+ */
+
+#ifndef __HD_LAUNCH_TRACE_H__
+#define __HD_LAUNCH_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  HD_LAUNCH_TRACE_CLICK,     /* the launcher tile was clicked */
+  HD_LAUNCH_TRACE_ACTIVATE,  /* HdAppMgr got to start it */
+  HD_LAUNCH_TRACE_REQUEST,   /* spawned, or top_application sent */
+  HD_LAUNCH_TRACE_MAP,       /* its first window was mapped */
+  HD_LAUNCH_TRACE_DAMAGE,    /* it drew something */
+  HD_LAUNCH_TRACE_SHOWN,     /* the start transition is over */
+
+  HD_LAUNCH_TRACE_N_PHASES
+} HdLaunchTracePhase;
+
+/* @phase is what the launch got to, or "total"; times are in ms. */
+typedef void (*HdLaunchTraceFunc) (const gchar *id,
+                                   const gchar *phase,
+                                   guint        n,
+                                   guint        p50,
+                                   guint        p90,
+                                   guint        max,
+                                   gpointer     data);
+
+void hd_launch_trace_mark    (const gchar        *id,
+                              HdLaunchTracePhase  phase);
+void hd_launch_trace_foreach (HdLaunchTraceFunc   func,
+                              gpointer            data);
+void hd_launch_trace_dump    (void);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCH_TRACE_H__ */
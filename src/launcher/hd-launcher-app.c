@@ -49,19 +49,20 @@
 
 #define HD_LAUNCHER_APP_GET_PRIVATE(obj)        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), HD_TYPE_LAUNCHER_APP, HdLauncherAppPrivate))
 
+/* The strings are from hd_launcher_item_string_ref(). */
 struct _HdLauncherAppPrivate
 {
-  gchar *exec;
-  gchar *service;
-  gchar *loading_image;
-  gchar *switcher_icon;
-  gchar *wm_class;
-
-  HdLauncherAppPrestartMode prestart_mode;
+  const gchar *exec;
+  const gchar *service;
+  const gchar *loading_image;
+  const gchar *switcher_icon;
+  const gchar *wm_class;
 
   gint priority;
-  gboolean ignore_lowmem;
-  gboolean ignore_load;
+
+  guint prestart_mode : 2;  /* HdLauncherAppPrestartMode */
+  guint ignore_lowmem : 1;
+  guint ignore_load : 1;
 };
 
 G_DEFINE_TYPE (HdLauncherApp, hd_launcher_app, HD_TYPE_LAUNCHER_ITEM);
@@ -69,17 +70,21 @@ G_DEFINE_TYPE (HdLauncherApp, hd_launcher_app, HD_TYPE_LAUNCHER_ITEM);
 gboolean hd_launcher_app_parse_keyfile (HdLauncherItem  *item,
                                         GKeyFile        *key_file,
                                         GError          **error);
+static void hd_launcher_app_get_fields (HdLauncherItem *item,
+                                        HdLauncherItemFields *fields);
+static void hd_launcher_app_set_fields (HdLauncherItem *item,
+                                        const HdLauncherItemFields *fields);
 
 static void
 hd_launcher_app_finalize (GObject *gobject)
 {
   HdLauncherAppPrivate *priv = HD_LAUNCHER_APP (gobject)->priv;
 
-  g_free (priv->exec);
-  g_free (priv->service);
-  g_free (priv->loading_image);
-  g_free (priv->switcher_icon);
-  g_free (priv->wm_class);
+  hd_launcher_item_string_unref (priv->exec);
+  hd_launcher_item_string_unref (priv->service);
+  hd_launcher_item_string_unref (priv->loading_image);
+  hd_launcher_item_string_unref (priv->switcher_icon);
+  hd_launcher_item_string_unref (priv->wm_class);
 
   G_OBJECT_CLASS (hd_launcher_app_parent_class)->finalize (gobject);
 }
@@ -94,6 +99,8 @@ hd_launcher_app_class_init (HdLauncherAppClass *klass)
 
   gobject_class->finalize = hd_launcher_app_finalize;
   launcher_class->parse_key_file = hd_launcher_app_parse_keyfile;
+  launcher_class->get_fields = hd_launcher_app_get_fields;
+  launcher_class->set_fields = hd_launcher_app_set_fields;
 }
 
 static void
@@ -147,34 +154,38 @@ hd_launcher_app_parse_keyfile (HdLauncherItem *item,
                                GError         **error)
 {
   HdLauncherAppPrivate *priv;
+  gchar *exec;
 
   g_return_val_if_fail (HD_IS_LAUNCHER_APP (item), FALSE);
   g_return_val_if_fail (key_file != NULL, FALSE);
 
   priv = HD_LAUNCHER_APP_GET_PRIVATE (item);
 
-  priv->service =
+  priv->service = hd_launcher_item_string_take (
     hd_launcher_app_parse_service_name (g_key_file_get_string (key_file,
                                           HD_DESKTOP_ENTRY_GROUP,
                                           HD_DESKTOP_ENTRY_SERVICE,
-                                          NULL));
-
-  priv->exec = g_key_file_get_string (key_file,
-                                      HD_DESKTOP_ENTRY_GROUP,
-                                      HD_DESKTOP_ENTRY_EXEC,
-                                      NULL);
-  if (priv->exec)
-    g_strchomp (priv->exec);
-
-  priv->loading_image = g_key_file_get_string (key_file,
+                                          NULL)));
+
+  exec = g_key_file_get_string (key_file,
+                                HD_DESKTOP_ENTRY_GROUP,
+                                HD_DESKTOP_ENTRY_EXEC,
+                                NULL);
+  if (exec)
+    g_strchomp (exec);
+  priv->exec = hd_launcher_item_string_take (exec);
+
+  priv->loading_image = hd_launcher_item_string_take (
+                          g_key_file_get_string (key_file,
                                                HD_DESKTOP_ENTRY_GROUP,
                                                HD_DESKTOP_ENTRY_LOADING_IMAGE,
-                                               NULL);
+                                               NULL));
 
-  priv->switcher_icon = g_key_file_get_string (key_file,
+  priv->switcher_icon = hd_launcher_item_string_take (
+                          g_key_file_get_string (key_file,
                                                HD_DESKTOP_ENTRY_GROUP,
                                                HD_DESKTOP_ENTRY_SWITCHER_ICON,
-                                               NULL);
+                                               NULL));
 
   priv->prestart_mode =
     hd_launcher_app_parse_prestart_mode (g_key_file_get_string (key_file,
@@ -182,10 +193,11 @@ hd_launcher_app_parse_keyfile (HdLauncherItem *item,
                                            HD_DESKTOP_ENTRY_PRESTART_MODE,
                                            NULL));
 
-  priv->wm_class = g_key_file_get_string (key_file,
-                                          HD_DESKTOP_ENTRY_GROUP,
-                                          HD_DESKTOP_ENTRY_WM_CLASS,
-                                          NULL);
+  priv->wm_class = hd_launcher_item_string_take (
+                     g_key_file_get_string (key_file,
+                                            HD_DESKTOP_ENTRY_GROUP,
+                                            HD_DESKTOP_ENTRY_WM_CLASS,
+                                            NULL));
 
   priv->priority = g_key_file_get_integer (key_file,
                                            HD_DESKTOP_ENTRY_GROUP,
@@ -205,6 +217,42 @@ hd_launcher_app_parse_keyfile (HdLauncherItem *item,
   return TRUE;
 }
 
+static void
+hd_launcher_app_get_fields (HdLauncherItem *item,
+                            HdLauncherItemFields *fields)
+{
+  HdLauncherAppPrivate *priv = HD_LAUNCHER_APP_GET_PRIVATE (item);
+
+  fields->exec = priv->exec;
+  fields->service = priv->service;
+  fields->loading_image = priv->loading_image;
+  fields->switcher_icon = priv->switcher_icon;
+  fields->wm_class = priv->wm_class;
+  fields->prestart_mode = priv->prestart_mode;
+  fields->priority = priv->priority;
+  fields->ignore_lowmem = priv->ignore_lowmem;
+  fields->ignore_load = priv->ignore_load;
+}
+
+static void
+hd_launcher_app_set_fields (HdLauncherItem *item,
+                            const HdLauncherItemFields *fields)
+{
+  HdLauncherAppPrivate *priv = HD_LAUNCHER_APP_GET_PRIVATE (item);
+
+  hd_launcher_item_string_replace (&priv->exec, fields->exec);
+  hd_launcher_item_string_replace (&priv->service, fields->service);
+  hd_launcher_item_string_replace (&priv->loading_image,
+                                   fields->loading_image);
+  hd_launcher_item_string_replace (&priv->switcher_icon,
+                                   fields->switcher_icon);
+  hd_launcher_item_string_replace (&priv->wm_class, fields->wm_class);
+  priv->prestart_mode = fields->prestart_mode;
+  priv->priority = fields->priority;
+  priv->ignore_lowmem = fields->ignore_lowmem != FALSE;
+  priv->ignore_load = fields->ignore_load != FALSE;
+}
+
 const gchar *
 hd_launcher_app_get_exec (HdLauncherApp *item)
 {
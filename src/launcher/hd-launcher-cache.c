@@ -0,0 +1,440 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "hd-launcher-cache.h"
+
+/*
+ * The cache file is mmap()ed and used in place.  It is:
+ *
+ *   HdLauncherCacheHeader
+ *   HdLauncherCacheRecord[n_records]
+ *   strings, each NUL-terminated, starting with an empty one
+ *
+ * Strings are referred to by their offset from the start of the string
+ * area; 0 means NULL.  A record is only used if the file it was made
+ * from still has the same modification time and size.  Records whose
+ * file didn't yield an item (NoDisplay etc.) are kept as well, so we
+ * don't parse those over and over.  The cache is independent of the
+ * locale, because items only keep the untranslated names.
+ */
+#define HD_LAUNCHER_CACHE_MAGIC   0x4c434448 /* "HDCL" */
+#define HD_LAUNCHER_CACHE_VERSION 1
+
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 n_records;
+  guint32 size;
+} HdLauncherCacheHeader;
+
+/* The string fields of HdLauncherItemFields, in the order they are
+ * in HdLauncherCacheRecord::strings. */
+static const gsize string_fields[] =
+{
+  G_STRUCT_OFFSET (HdLauncherItemFields, name),
+  G_STRUCT_OFFSET (HdLauncherItemFields, icon_name),
+  G_STRUCT_OFFSET (HdLauncherItemFields, comment),
+  G_STRUCT_OFFSET (HdLauncherItemFields, text_domain),
+  G_STRUCT_OFFSET (HdLauncherItemFields, exec),
+  G_STRUCT_OFFSET (HdLauncherItemFields, service),
+  G_STRUCT_OFFSET (HdLauncherItemFields, loading_image),
+  G_STRUCT_OFFSET (HdLauncherItemFields, switcher_icon),
+  G_STRUCT_OFFSET (HdLauncherItemFields, wm_class),
+};
+#define HD_LAUNCHER_CACHE_N_STRINGS G_N_ELEMENTS (string_fields)
+#define FIELD_STRING(fields, i) \
+  G_STRUCT_MEMBER (const gchar *, (fields), string_fields[i])
+
+enum
+{
+  HAS_ITEM        = 1 << 0,
+  IS_CATEGORY     = 1 << 1,
+  FORCE_LANDSCAPE = 1 << 2,
+  IGNORE_LOWMEM   = 1 << 3,
+  IGNORE_LOAD     = 1 << 4,
+};
+
+typedef struct
+{
+  guint32 path;
+  guint32 mtime;
+  guint32 size;
+  guint32 flags;
+  gint32  prestart_mode;
+  gint32  priority;
+  guint32 strings[HD_LAUNCHER_CACHE_N_STRINGS];
+} HdLauncherCacheRecord;
+
+/* A .desktop file seen during this walk, either found in the cache
+ * or parsed now. */
+typedef struct
+{
+  guint32                      mtime;
+  guint32                      size;
+  const HdLauncherCacheRecord *record;
+  HdLauncherItem              *item;
+} HdLauncherCacheUsed;
+
+struct _HdLauncherCache
+{
+  gchar        *filename;
+
+  GMappedFile  *map;
+  const HdLauncherCacheRecord *records;
+  guint         n_records;
+  const gchar  *strings;
+  gsize         strings_size;
+  GHashTable   *index;           /* path -> record */
+
+  /* Lookups and additions may come from several threads at once. */
+  GMutex       *lock;
+  GHashTable   *used;            /* path -> HdLauncherCacheUsed */
+  gboolean      dirty;
+};
+
+static const gchar *
+hd_launcher_cache_string (HdLauncherCache *cache, guint32 offset)
+{
+  /* The string area ends with a NUL, so any offset in it is safe. */
+  return offset && offset < cache->strings_size
+    ? cache->strings + offset : NULL;
+}
+
+/* Map the cache file and check it's sane.  Returns FALSE if it isn't. */
+static gboolean
+hd_launcher_cache_map (HdLauncherCache *cache)
+{
+  const HdLauncherCacheHeader *header;
+  const gchar *contents;
+  gsize length, records_size;
+  guint i;
+
+  if (!(cache->map = g_mapped_file_new (cache->filename, FALSE, NULL)))
+    return FALSE;
+
+  contents = g_mapped_file_get_contents (cache->map);
+  length = g_mapped_file_get_length (cache->map);
+  if (length < sizeof (*header))
+    return FALSE;
+
+  header = (const HdLauncherCacheHeader *) contents;
+  if (header->magic != HD_LAUNCHER_CACHE_MAGIC
+      || header->version != HD_LAUNCHER_CACHE_VERSION
+      || header->size != length
+      || header->n_records > length / sizeof (HdLauncherCacheRecord))
+    return FALSE;
+
+  records_size = header->n_records * sizeof (HdLauncherCacheRecord);
+  if (sizeof (*header) + records_size >= length
+      || contents[length - 1] != '\0')
+    return FALSE;
+
+  cache->records = (const HdLauncherCacheRecord *) (header + 1);
+  cache->n_records = header->n_records;
+  cache->strings = contents + sizeof (*header) + records_size;
+  cache->strings_size = length - sizeof (*header) - records_size;
+
+  for (i = 0; i < cache->n_records; i++)
+    {
+      const gchar *path;
+
+      path = hd_launcher_cache_string (cache, cache->records[i].path);
+      if (path)
+        g_hash_table_insert (cache->index, (gpointer) path,
+                             (gpointer) &cache->records[i]);
+    }
+
+  return TRUE;
+}
+
+static void
+hd_launcher_cache_used_free (HdLauncherCacheUsed *used)
+{
+  if (used->item)
+    g_object_unref (used->item);
+  g_free (used);
+}
+
+/* Returns a new cache with the contents of the cache file, if there's
+ * a usable one.  hd_launcher_cache_lookup() and hd_launcher_cache_add()
+ * may be called from several threads, the rest from one at a time. */
+HdLauncherCache *
+hd_launcher_cache_open (void)
+{
+  HdLauncherCache *cache;
+
+  cache = g_new0 (HdLauncherCache, 1);
+  cache->filename = g_build_filename (g_get_user_cache_dir (),
+                                      "hildon-desktop", "launcher.cache",
+                                      NULL);
+  cache->index = g_hash_table_new (g_str_hash, g_str_equal);
+  cache->lock = g_mutex_new ();
+  cache->used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                               (GDestroyNotify) hd_launcher_cache_used_free);
+
+  if (!hd_launcher_cache_map (cache))
+    {
+      if (cache->map)
+        {
+          g_debug ("%s: ignoring invalid %s", __FUNCTION__, cache->filename);
+          g_mapped_file_free (cache->map);
+          cache->map = NULL;
+        }
+      g_hash_table_remove_all (cache->index);
+      cache->records = NULL;
+      cache->n_records = 0;
+      cache->strings = NULL;
+      cache->strings_size = 0;
+    }
+
+  return cache;
+}
+
+static void
+hd_launcher_cache_record_get_fields (HdLauncherCache *cache,
+                                     const HdLauncherCacheRecord *record,
+                                     HdLauncherItemFields *fields)
+{
+  guint i;
+
+  memset (fields, 0, sizeof (*fields));
+  fields->type = record->flags & IS_CATEGORY
+    ? HD_CATEGORY_LAUNCHER : HD_APPLICATION_LAUNCHER;
+  for (i = 0; i < HD_LAUNCHER_CACHE_N_STRINGS; i++)
+    FIELD_STRING (fields, i) = hd_launcher_cache_string (cache,
+                                                   record->strings[i]);
+  fields->cssu_force_landscape = (record->flags & FORCE_LANDSCAPE) != 0;
+  fields->prestart_mode = record->prestart_mode;
+  fields->priority = record->priority;
+  fields->ignore_lowmem = (record->flags & IGNORE_LOWMEM) != 0;
+  fields->ignore_load = (record->flags & IGNORE_LOAD) != 0;
+}
+
+/*
+ * Look @path up in @cache.  If the cache knows what's in it, returns TRUE
+ * and sets @item to a new item made of the cached values, or to NULL if
+ * the file doesn't make a launcher.  Otherwise the caller should parse
+ * the file and tell the cache with hd_launcher_cache_add().
+ */
+gboolean
+hd_launcher_cache_lookup (HdLauncherCache *cache, const gchar *path,
+                          const struct stat *st, const gchar *id,
+                          const gchar *category, HdLauncherItem **item)
+{
+  const HdLauncherCacheRecord *record;
+  HdLauncherCacheUsed *used;
+
+  record = g_hash_table_lookup (cache->index, path);
+  if (!record || record->mtime != (guint32) st->st_mtime
+      || record->size != (guint32) st->st_size)
+    return FALSE;
+
+  *item = NULL;
+  if (record->flags & HAS_ITEM)
+    {
+      HdLauncherItemFields fields;
+
+      hd_launcher_cache_record_get_fields (cache, record, &fields);
+      if (!(*item = hd_launcher_item_new_from_fields (id, category, &fields)))
+        return FALSE;
+    }
+
+  used = g_new0 (HdLauncherCacheUsed, 1);
+  used->mtime = record->mtime;
+  used->size = record->size;
+  used->record = record;
+  g_mutex_lock (cache->lock);
+  g_hash_table_insert (cache->used, g_strdup (path), used);
+  g_mutex_unlock (cache->lock);
+
+  return TRUE;
+}
+
+/* Remember that @path, as described by @st, made @item, which may be NULL
+ * if it doesn't make a launcher. */
+void
+hd_launcher_cache_add (HdLauncherCache *cache, const gchar *path,
+                       const struct stat *st, HdLauncherItem *item)
+{
+  HdLauncherCacheUsed *used;
+
+  used = g_new0 (HdLauncherCacheUsed, 1);
+  used->mtime = st->st_mtime;
+  used->size = st->st_size;
+  used->item = item ? g_object_ref (item) : NULL;
+  g_mutex_lock (cache->lock);
+  g_hash_table_insert (cache->used, g_strdup (path), used);
+  cache->dirty = TRUE;
+  g_mutex_unlock (cache->lock);
+}
+
+typedef struct
+{
+  HdLauncherCache *cache;
+  GArray          *records;
+  GString         *strings;
+  GHashTable      *offsets; /* string -> offset in strings */
+} HdLauncherCacheWriter;
+
+static guint32
+hd_launcher_cache_write_string (HdLauncherCacheWriter *writer,
+                                const gchar *str)
+{
+  gpointer offset;
+
+  if (!str)
+    return 0;
+  if (!(offset = g_hash_table_lookup (writer->offsets, str)))
+    {
+      offset = GUINT_TO_POINTER (writer->strings->len);
+      g_string_append_len (writer->strings, str, strlen (str) + 1);
+      g_hash_table_insert (writer->offsets, g_strdup (str), offset);
+    }
+
+  return GPOINTER_TO_UINT (offset);
+}
+
+static void
+hd_launcher_cache_write_record (const gchar *path,
+                                HdLauncherCacheUsed *used,
+                                HdLauncherCacheWriter *writer)
+{
+  HdLauncherCacheRecord record;
+  HdLauncherItemFields fields;
+  gboolean has_item;
+  guint i;
+
+  if (used->record)
+    {
+      has_item = (used->record->flags & HAS_ITEM) != 0;
+      hd_launcher_cache_record_get_fields (writer->cache, used->record,
+                                           &fields);
+    }
+  else if ((has_item = used->item != NULL))
+    hd_launcher_item_get_fields (used->item, &fields);
+  else
+    memset (&fields, 0, sizeof (fields));
+
+  memset (&record, 0, sizeof (record));
+  record.path = hd_launcher_cache_write_string (writer, path);
+  record.mtime = used->mtime;
+  record.size = used->size;
+  if (has_item)
+    {
+      record.flags = HAS_ITEM;
+      if (fields.type == HD_CATEGORY_LAUNCHER)
+        record.flags |= IS_CATEGORY;
+      if (fields.cssu_force_landscape)
+        record.flags |= FORCE_LANDSCAPE;
+      if (fields.ignore_lowmem)
+        record.flags |= IGNORE_LOWMEM;
+      if (fields.ignore_load)
+        record.flags |= IGNORE_LOAD;
+      record.prestart_mode = fields.prestart_mode;
+      record.priority = fields.priority;
+      for (i = 0; i < HD_LAUNCHER_CACHE_N_STRINGS; i++)
+        record.strings[i] = hd_launcher_cache_write_string (writer,
+                                               FIELD_STRING (&fields, i));
+    }
+
+  g_array_append_val (writer->records, record);
+}
+
+/*
+ * Write the files seen since hd_launcher_cache_open() to the cache file,
+ * if anything changed.  Files which were not looked up or added are
+ * dropped from the cache.
+ */
+void
+hd_launcher_cache_save (HdLauncherCache *cache)
+{
+  HdLauncherCacheWriter writer;
+  HdLauncherCacheHeader header;
+  GByteArray *contents;
+  GError *error = NULL;
+  gchar *dir;
+
+  if (!cache->dirty && g_hash_table_size (cache->used) == cache->n_records)
+    return;
+
+  writer.cache = cache;
+  writer.records = g_array_sized_new (FALSE, FALSE,
+                                      sizeof (HdLauncherCacheRecord),
+                                      g_hash_table_size (cache->used));
+  writer.strings = g_string_new_len ("", 1);
+  writer.offsets = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, NULL);
+  g_hash_table_foreach (cache->used,
+                        (GHFunc) hd_launcher_cache_write_record, &writer);
+
+  header.magic = HD_LAUNCHER_CACHE_MAGIC;
+  header.version = HD_LAUNCHER_CACHE_VERSION;
+  header.n_records = writer.records->len;
+  header.size = sizeof (header)
+    + writer.records->len * sizeof (HdLauncherCacheRecord)
+    + writer.strings->len;
+
+  contents = g_byte_array_sized_new (header.size);
+  g_byte_array_append (contents, (guint8 *) &header, sizeof (header));
+  g_byte_array_append (contents, (guint8 *) writer.records->data,
+                       writer.records->len * sizeof (HdLauncherCacheRecord));
+  g_byte_array_append (contents, (guint8 *) writer.strings->str,
+                       writer.strings->len);
+
+  /* g_file_set_contents() writes a temporary file and renames it over
+   * the old one, which is safe even if it's mapped by someone. */
+  dir = g_path_get_dirname (cache->filename);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+  if (!g_file_set_contents (cache->filename, (gchar *) contents->data,
+                            contents->len, &error))
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+  else
+    g_debug ("%s: %u records, %u bytes", __FUNCTION__,
+             header.n_records, header.size);
+
+  g_byte_array_free (contents, TRUE);
+  g_hash_table_destroy (writer.offsets);
+  g_string_free (writer.strings, TRUE);
+  g_array_free (writer.records, TRUE);
+}
+
+void
+hd_launcher_cache_free (HdLauncherCache *cache)
+{
+  g_hash_table_destroy (cache->used);
+  g_hash_table_destroy (cache->index);
+  g_mutex_free (cache->lock);
+  if (cache->map)
+    g_mapped_file_free (cache->map);
+  g_free (cache->filename);
+  g_free (cache);
+}
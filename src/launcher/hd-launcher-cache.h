@@ -0,0 +1,54 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * A persistent cache of what the launcher items read from their .desktop
+ * files, kept in ~/.cache/hildon-desktop/launcher.cache, so that we only
+ * need to parse the files which changed since the last time.
+ */
+
+#ifndef __HD_LAUNCHER_CACHE_H__
+#define __HD_LAUNCHER_CACHE_H__
+
+#include <sys/stat.h>
+#include "hd-launcher-item.h"
+
+G_BEGIN_DECLS
+
+typedef struct _HdLauncherCache HdLauncherCache;
+
+HdLauncherCache *hd_launcher_cache_open   (void);
+gboolean         hd_launcher_cache_lookup (HdLauncherCache   *cache,
+                                           const gchar       *path,
+                                           const struct stat *st,
+                                           const gchar       *id,
+                                           const gchar       *category,
+                                           HdLauncherItem   **item);
+void             hd_launcher_cache_add    (HdLauncherCache   *cache,
+                                           const gchar       *path,
+                                           const struct stat *st,
+                                           HdLauncherItem    *item);
+void             hd_launcher_cache_save   (HdLauncherCache   *cache);
+void             hd_launcher_cache_free   (HdLauncherCache   *cache);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCHER_CACHE_H__ */
@@ -67,6 +67,9 @@ struct _HdLauncherGridPrivate
 {
   /* list of actors */
   GList *tiles;
+  guint n_tiles;
+  /* The rows whose tiles are bound, or -1 if none are. */
+  gint first_bound_row, last_bound_row;
   /* list of 'blocker' actors that block presses
    * on the empty rows of pixels between the icons */
   GList *blockers;
@@ -118,6 +121,13 @@ static gboolean      hd_launcher_grid_is_portrait (HdLauncherGrid *self);
 #define HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE (int)(HD_COMP_MGR_LANDSCAPE_WIDTH/160)
 #define HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT (int)(HD_COMP_MGR_PORTRAIT_WIDTH/160)
 
+/* How many rows above and below the visible ones to keep bound. */
+#define HD_LAUNCHER_GRID_PRELOAD_ROWS \
+  (hd_transition_get_int ("launcher", "preload_rows", 1))
+
+static void hd_launcher_grid_bind_visible_rows (HdLauncherGrid *grid,
+                                                gboolean        force);
+
 #define HD_LAUNCHER_GRID_LEFT_DISMISSAL_AREA_LANDSCAPE (HD_LAUNCHER_LEFT_MARGIN)
 #define HD_LAUNCHER_GRID_RIGHT_DISMISSAL_AREA_LANDSCAPE (HD_LAUNCHER_RIGHT_MARGIN)
 #define HD_LAUNCHER_GRID_LEFT_DISMISSAL_AREA_PORTRAIT (64)
@@ -239,6 +249,7 @@ adjustment_value_notify (GObject    *gobject,
   clutter_actor_set_anchor_point(grid,
                              0,
                              tidy_adjustment_get_value(priv->v_adjustment));
+  hd_launcher_grid_bind_visible_rows (HD_LAUNCHER_GRID (grid), FALSE);
 }
 
 static void
@@ -353,6 +364,7 @@ hd_launcher_grid_actor_added (ClutterContainer *container,
   if (HD_IS_LAUNCHER_TILE(actor))
     {
       priv->tiles = g_list_append (priv->tiles, g_object_ref(actor));
+      priv->n_tiles++;
 
       /* relayout moved to the traversal code */
     }
@@ -371,6 +383,7 @@ hd_launcher_grid_actor_removed (ClutterContainer *container,
   if (HD_IS_LAUNCHER_TILE(actor))
     {
       priv->tiles = g_list_remove (priv->tiles, actor);
+      priv->n_tiles--;
       g_object_unref(actor);
 
       /* relayout moved to the traversal code */
@@ -379,94 +392,123 @@ hd_launcher_grid_actor_removed (ClutterContainer *container,
   g_object_unref (actor);
 }
 
-static void
-_hd_launcher_grid_count_children_and_rows (HdLauncherGrid *grid,
-                                           guint *children,
-                                           guint *rows)
+static guint
+hd_launcher_grid_get_columns (HdLauncherGrid *grid)
 {
-  HdLauncherGridPrivate *priv = HD_LAUNCHER_GRID_GET_PRIVATE (grid);
-  GList *l;
+  return hd_launcher_grid_is_portrait (grid)
+    ? HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT
+    : HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE;
+}
 
-  *children = 0;
-  for (l = priv->tiles; l != NULL; l = l->next)
-    {
-      ClutterActor *child = l->data;
+static guint
+hd_launcher_grid_get_n_rows (HdLauncherGrid *grid)
+{
+  guint columns = hd_launcher_grid_get_columns (grid);
 
-      if (CLUTTER_ACTOR_IS_VISIBLE (child))
-        {
-          ++(*children);
-        }
-    }
+  return (grid->priv->n_tiles + columns - 1) / columns;
+}
 
-  if (*children > 0)
-    {
-      if (hd_launcher_grid_is_portrait (grid))
-        *rows = (*children / HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT) +
-          (*children % HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT ? 1 : 0);
-      else
-        *rows = (*children / HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE) +
-          (*children % HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE ? 1 : 0);
-    }
-  else
-    {
-      *rows = 0;
-    }
+/* The y position of the top of @row. */
+static guint
+hd_launcher_grid_get_row_y (HdLauncherGrid *grid, guint row)
+{
+  guint top;
+
+  top = hd_launcher_grid_is_portrait (grid)
+    ? HD_LAUNCHER_PAGE_XMARGIN : HD_LAUNCHER_PAGE_YMARGIN;
+  return top + row * (HD_LAUNCHER_TILE_HEIGHT + grid->priv->v_spacing);
 }
 
+/* Where the @index:th tile goes.  Rows are centred horizontally. */
+static void
+hd_launcher_grid_get_tile_position (HdLauncherGrid *grid, guint index,
+                                    guint *x, guint *y)
+{
+  HdLauncherGridPrivate *priv = grid->priv;
+  guint columns, icons_width, page_width;
 
-/**
- * Allocates a number of tiles in a row, starting at cur_y.
- * Returns the remaining children list (ie still to allocate).
- *
- * @grid: the HdLauncherGrid instance
- * @l: list of tiles still to be inserted in the layout
- * @remaining is a memory address containing a pointer to the number of
- * children still to insert into the grid.
- * @cur_y: the current y position of the grid, from where to begin placing
- * tiles
- * @h_spacing is the icon horizonal spacing.
- */
-static GList *
-_hd_launcher_grid_layout_row   (HdLauncherGrid *grid,
-                                GList *l,
-                                guint *remaining,
-                                guint cur_y,
-                                guint h_spacing)
-{
-  ClutterActor *child;
-  guint allocated;
-  guint cur_x;
-
-  /* Figure out the starting X position needed to centre the icons */
-  if (hd_launcher_grid_is_portrait (grid))
-    {
-      guint icons_width = HD_LAUNCHER_TILE_WIDTH * HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT +
-        h_spacing * (HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT-1);
+  columns = hd_launcher_grid_get_columns (grid);
+  page_width = hd_launcher_grid_is_portrait (grid)
+    ? HD_LAUNCHER_PAGE_HEIGHT : HD_LAUNCHER_PAGE_WIDTH;
+  icons_width = HD_LAUNCHER_TILE_WIDTH * columns
+    + priv->h_spacing * (columns - 1);
 
-      cur_x = (HD_LAUNCHER_PAGE_HEIGHT - icons_width) / 2;
-      allocated = MIN (HD_LAUNCHER_GRID_MAX_COLUMNS_PORTRAIT, *remaining);
-    }
-  else
-    {
-      guint icons_width = HD_LAUNCHER_TILE_WIDTH * HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE +
-        h_spacing * (HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE-1);
+  *x = (page_width - icons_width) / 2
+    + (index % columns) * (HD_LAUNCHER_TILE_WIDTH + priv->h_spacing);
+  *y = hd_launcher_grid_get_row_y (grid, index / columns);
+}
 
-      cur_x = (HD_LAUNCHER_PAGE_WIDTH - icons_width) / 2;
-      allocated = MIN (HD_LAUNCHER_GRID_MAX_COLUMNS_LANDSCAPE, *remaining);
-    }
+/* Bind or unbind the tiles of rows @first..@last. */
+static void
+hd_launcher_grid_bind_rows (HdLauncherGrid *grid, gint first, gint last,
+                            gboolean bind)
+{
+  guint columns, n;
+  GList *l;
 
-  /* for each icon in the row... */
-  for (int i = 0; i < allocated; i++)
-    {
-      child = l->data;
+  if (first < 0 || first > last)
+    return;
 
-      clutter_actor_set_position(child, cur_x, cur_y);
-      cur_x += HD_LAUNCHER_TILE_WIDTH + h_spacing;
+  columns = hd_launcher_grid_get_columns (grid);
+  l = g_list_nth (grid->priv->tiles, first * columns);
+  for (n = (last - first + 1) * columns; l && n > 0; l = l->next, n--)
+    hd_launcher_tile_set_bound (l->data, bind);
+}
 
-      l = l->next;
+/*
+ * Only the tiles of the rows on the screen, and a few around them, have
+ * their labels and icons loaded; the rest are hidden.  This is called
+ * as the page is scrolled, and only does something when a row comes in
+ * or goes out.  With @force all tiles are looked at, for when they've
+ * been moved around.
+ */
+static void
+hd_launcher_grid_bind_visible_rows (HdLauncherGrid *grid, gboolean force)
+{
+  HdLauncherGridPrivate *priv = grid->priv;
+  gint first, last, n_rows, preload, top, bottom, row_height;
+  guint columns, i;
+  GList *l;
+
+  n_rows = hd_launcher_grid_get_n_rows (grid);
+  row_height = HD_LAUNCHER_TILE_HEIGHT + priv->v_spacing;
+  top = priv->v_adjustment
+    ? CLUTTER_FIXED_TO_INT (tidy_adjustment_get_valuex (priv->v_adjustment))
+    : 0;
+  bottom = top + hd_comp_mgr_get_current_screen_height ();
+  top -= hd_launcher_grid_get_row_y (grid, 0);
+  bottom -= hd_launcher_grid_get_row_y (grid, 0);
+
+  preload = MAX (HD_LAUNCHER_GRID_PRELOAD_ROWS, 0);
+  first = MAX ((top > 0 ? top / row_height : 0) - preload, 0);
+  last = MIN ((bottom > 0 ? bottom / row_height : 0) + preload, n_rows - 1);
+  if (first > last)
+    first = last = -1;
+
+  if (force)
+    {
+      columns = hd_launcher_grid_get_columns (grid);
+      for (l = priv->tiles, i = 0; l; l = l->next, i++)
+        hd_launcher_tile_set_bound (l->data,
+                                    (gint)(i / columns) >= first
+                                    && (gint)(i / columns) <= last);
+    }
+  else if (first != priv->first_bound_row || last != priv->last_bound_row)
+    {
+      if (priv->first_bound_row >= 0)
+        {
+          hd_launcher_grid_bind_rows (grid, priv->first_bound_row,
+                                      MIN (priv->last_bound_row, first - 1),
+                                      FALSE);
+          hd_launcher_grid_bind_rows (grid,
+                                      MAX (priv->first_bound_row, last + 1),
+                                      priv->last_bound_row, FALSE);
+        }
+      hd_launcher_grid_bind_rows (grid, first, last, TRUE);
     }
-  *remaining -= allocated;
-  return l;
+
+  priv->first_bound_row = first;
+  priv->last_bound_row = last;
 }
 
 /* hd_launcher_grid_layout:
@@ -487,79 +529,72 @@ void hd_launcher_grid_layout (HdLauncherGrid *grid)
 {
   HdLauncherGridPrivate *priv = grid->priv;
   GList *l;
-  guint cur_height, n_visible_launchers, n_rows;
+  guint i, x, y, n_rows, n_blockers;
 
-  /* Free our list of 'blocker' actors that we use to block mouse clicks.
-   * TODO: just check we have 'nrows' worth */
-  g_list_foreach(priv->blockers,
-                 (GFunc)clutter_actor_destroy,
-                 NULL);
-  g_list_free(priv->blockers);
-  priv->blockers = NULL;
+  n_rows = hd_launcher_grid_get_n_rows (grid);
 
-  _hd_launcher_grid_count_children_and_rows (grid,
-      &n_visible_launchers, &n_rows);
+  for (l = priv->tiles, i = 0; l; l = l->next, i++)
+    {
+      hd_launcher_grid_get_tile_position (grid, i, &x, &y);
+      clutter_actor_set_position (l->data, x, y);
+    }
 
-  if (hd_launcher_grid_is_portrait (grid))
-    cur_height = HD_LAUNCHER_PAGE_XMARGIN;
-  else
-    cur_height = HD_LAUNCHER_PAGE_YMARGIN;
+  /* Between each two rows there is an actor that grabs the clicks that
+   * would have gone between them and dismissed the launcher.  Keep as
+   * many as we need. */
+  n_blockers = n_rows > 0 ? n_rows - 1 : 0;
+  while (g_list_length (priv->blockers) > n_blockers)
+    {
+      clutter_actor_destroy (priv->blockers->data);
+      priv->blockers = g_list_delete_link (priv->blockers, priv->blockers);
+    }
+  while (g_list_length (priv->blockers) < n_blockers)
+    {
+      ClutterActor *blocker = clutter_group_new();
+      clutter_actor_set_name(blocker, "HdLauncherGrid::blocker");
+      clutter_actor_show(blocker);
+      clutter_container_add_actor(CLUTTER_CONTAINER(grid), blocker);
+      clutter_actor_set_reactive(blocker, TRUE);
+      g_signal_connect (blocker, "button-release-event",
+                        G_CALLBACK (_hd_launcher_grid_blocker_release_cb),
+                        NULL);
+      priv->blockers = g_list_prepend(priv->blockers, blocker);
+    }
 
-  l = priv->tiles;
-  while (l) {
-    /* Allocate all icons on this row */
-    l = _hd_launcher_grid_layout_row(grid, l, &n_visible_launchers,
-                                       cur_height, priv->h_spacing);
-    if (l)
-      {
-        /* If there is another row, we must create an actor that
-         * goes between the two rows that will grab the clicks that
-         * would have gone between them and dismissed the launcher  */
-        ClutterActor *blocker = clutter_group_new();
-        clutter_actor_set_name(blocker, "HdLauncherGrid::blocker");
-        clutter_actor_show(blocker);
-        clutter_container_add_actor(CLUTTER_CONTAINER(grid), blocker);
-        clutter_actor_set_reactive(blocker, TRUE);
-        g_signal_connect (blocker, "button-release-event",
-                          G_CALLBACK (_hd_launcher_grid_blocker_release_cb),
-                          NULL);
-
-        if (hd_launcher_grid_is_portrait (grid))
-          {
-            clutter_actor_set_position(blocker,
-                HD_LAUNCHER_BOTTOM_MARGIN,
-                cur_height + HD_LAUNCHER_TILE_HEIGHT);
-            clutter_actor_set_size(blocker,
-                HD_LAUNCHER_GRID_WIDTH_PORTRAIT -
-                (HD_LAUNCHER_GRID_LEFT_DISMISSAL_AREA_PORTRAIT +
-                 HD_LAUNCHER_GRID_RIGHT_DISMISSAL_AREA_PORTRAIT),
-                priv->v_spacing);
-          }
-        else
-          {
-            clutter_actor_set_position(blocker,
-                HD_LAUNCHER_LEFT_MARGIN,
-                cur_height + HD_LAUNCHER_TILE_HEIGHT);
-            clutter_actor_set_size(blocker,
-                HD_LAUNCHER_GRID_WIDTH_LANDSCAPE -
-                (HD_LAUNCHER_GRID_LEFT_DISMISSAL_AREA_LANDSCAPE +
-                 HD_LAUNCHER_GRID_RIGHT_DISMISSAL_AREA_LANDSCAPE),
-                priv->v_spacing);
-          }
-        priv->blockers = g_list_prepend(priv->blockers, blocker);
-      }
+  for (l = priv->blockers, i = 0; l; l = l->next, i++)
+    {
+      ClutterActor *blocker = l->data;
 
-    cur_height += HD_LAUNCHER_TILE_HEIGHT + priv->v_spacing;
-  }
+      y = hd_launcher_grid_get_row_y (grid, i) + HD_LAUNCHER_TILE_HEIGHT;
+      if (hd_launcher_grid_is_portrait (grid))
+        {
+          clutter_actor_set_position(blocker, HD_LAUNCHER_BOTTOM_MARGIN, y);
+          clutter_actor_set_size(blocker,
+              HD_LAUNCHER_GRID_WIDTH_PORTRAIT -
+              (HD_LAUNCHER_GRID_LEFT_DISMISSAL_AREA_PORTRAIT +
+               HD_LAUNCHER_GRID_RIGHT_DISMISSAL_AREA_PORTRAIT),
+              priv->v_spacing);
+        }
+      else
+        {
+          clutter_actor_set_position(blocker, HD_LAUNCHER_LEFT_MARGIN, y);
+          clutter_actor_set_size(blocker,
+              HD_LAUNCHER_GRID_WIDTH_LANDSCAPE -
+              (HD_LAUNCHER_GRID_LEFT_DISMISSAL_AREA_LANDSCAPE +
+               HD_LAUNCHER_GRID_RIGHT_DISMISSAL_AREA_LANDSCAPE),
+              priv->v_spacing);
+        }
+    }
 
+  y = hd_launcher_grid_get_row_y (grid, n_rows);
   if (hd_launcher_grid_is_portrait (grid))
     clutter_actor_set_size(CLUTTER_ACTOR(grid),
         HD_LAUNCHER_PAGE_HEIGHT,
-        cur_height);
+        y);
   else
     clutter_actor_set_size(CLUTTER_ACTOR(grid),
         HD_LAUNCHER_PAGE_WIDTH,
-        cur_height);
+        y);
 
 
   if (priv->h_adjustment)
@@ -567,6 +602,8 @@ void hd_launcher_grid_layout (HdLauncherGrid *grid)
 
   if (priv->v_adjustment)
     hd_launcher_grid_refresh_v_adjustment (grid);
+
+  hd_launcher_grid_bind_visible_rows (grid, TRUE);
 }
 
 static void
@@ -726,6 +763,8 @@ hd_launcher_grid_init (HdLauncherGrid *launcher)
 
   launcher->priv = priv = HD_LAUNCHER_GRID_GET_PRIVATE (launcher);
 
+  priv->first_bound_row = priv->last_bound_row = -1;
+
   /* set grid's orientation and h/v_spacing values to landscape by default */
   hd_launcher_grid_set_portrait (launcher, FALSE);
 
@@ -762,6 +801,30 @@ hd_launcher_grid_clear (HdLauncherGrid *grid)
 
       clutter_container_remove_actor (CLUTTER_CONTAINER (grid), child);
     }
+  priv->first_bound_row = priv->last_bound_row = -1;
+}
+
+/* Move @tile before @sibling in the layout order, or to the end if
+ * @sibling is %NULL.  Both must already be in @grid. */
+void
+hd_launcher_grid_move_tile_before (HdLauncherGrid *grid,
+                                   HdLauncherTile *tile,
+                                   HdLauncherTile *sibling)
+{
+  HdLauncherGridPrivate *priv;
+  GList *link;
+
+  g_return_if_fail (HD_IS_LAUNCHER_GRID (grid));
+
+  priv = grid->priv;
+  if (!(link = g_list_find (priv->tiles, tile)))
+    return;
+
+  priv->tiles = g_list_remove_link (priv->tiles, link);
+  g_list_free_1 (link);
+  priv->tiles = g_list_insert_before (priv->tiles,
+                                      g_list_find (priv->tiles, sibling),
+                                      tile);
 }
 
 /* Reset the grid before it is shown */
@@ -65,6 +65,9 @@ GType         hd_launcher_grid_get_type (void) G_GNUC_CONST;
 ClutterActor *hd_launcher_grid_new      (void);
 
 void          hd_launcher_grid_clear    (HdLauncherGrid *grid);
+void          hd_launcher_grid_move_tile_before (HdLauncherGrid *grid,
+                                                 HdLauncherTile *tile,
+                                                 HdLauncherTile *sibling);
 void          hd_launcher_grid_reset_v_adjustment (HdLauncherGrid *grid);
 
 void          hd_launcher_grid_transition_begin(HdLauncherGrid *grid,
@@ -0,0 +1,595 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#include <gtk/gtk.h>
+
+#include "hd-launcher-icons.h"
+
+#include "hildon-desktop.h"
+#include "hd-launcher.h"
+#include "hd-launcher-tile.h"
+
+/*
+ * A cached icon is
+ *
+ *   HdLauncherIconHeader
+ *   width * height RGBA pixels
+ *
+ * It is named after the MD5 of the icon's file name and only used if
+ * that file still has the same modification time and size.  The pixels
+ * are already padded with the transparent border the glow needs.
+ */
+#define HD_LAUNCHER_ICON_MAGIC   0x49434448 /* "HDCI" */
+#define HD_LAUNCHER_ICON_VERSION 1
+
+typedef struct
+{
+  guint32 magic;
+  guint32 version;
+  guint32 mtime;
+  guint32 size;
+  guint32 width;
+  guint32 height;
+} HdLauncherIconHeader;
+
+/* How many icons may be loading at once; it's also the number of
+ * worker threads. */
+#define HD_LAUNCHER_ICONS_THREADS 2
+
+struct _HdLauncherIconRequest
+{
+  gchar                  *filename;
+  ClutterActor           *actor;
+  HdLauncherIconCallback  cb;
+  gpointer                user_data;
+
+  /* If @glow_size isn't 0 we want the glow of the icon instead. */
+  guint                   glow_size;
+  guint                   glow_radius;
+  ClutterColor            glow_color;
+
+  /* Given to a worker; then it's freed when it's back. */
+  gboolean                running;
+  gboolean                cancelled;
+
+  /* Filled in by the worker. */
+  guchar                 *pixels;
+  guint                   width, height;
+  guint32                 mtime;
+};
+
+/* Everything but the workers runs in the main thread. */
+static GQueue        pending = { NULL, NULL, 0 };
+static guint         running;
+static GThreadPool  *workers;
+static ClutterActor *preferred;
+
+static void hd_launcher_icons_next (void);
+
+/* Returns the file of @icon_name at tile size, or %NULL. */
+gchar *
+hd_launcher_icons_lookup (const gchar *icon_name)
+{
+  GtkIconInfo *info;
+  gchar *filename;
+
+  info = gtk_icon_theme_lookup_icon (gtk_icon_theme_get_default (),
+                                     icon_name,
+                                     HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                     GTK_ICON_LOOKUP_NO_SVG);
+  if (!info)
+    return NULL;
+
+  filename = g_strdup (gtk_icon_info_get_filename (info));
+  gtk_icon_info_free (info);
+  return filename;
+}
+
+static gchar *
+hd_launcher_icons_cache_path (const gchar *filename)
+{
+  gchar *md5, *name, *path;
+
+  md5 = g_compute_checksum_for_string (G_CHECKSUM_MD5, filename, -1);
+  name = g_strconcat (md5, ".icon", NULL);
+  path = g_build_filename (g_get_user_cache_dir (), "hildon-desktop",
+                           "icons", name, NULL);
+  g_free (name);
+  g_free (md5);
+  return path;
+}
+
+static gboolean
+hd_launcher_icons_read_cache (HdLauncherIconRequest *req,
+                              const gchar *path, const struct stat *st)
+{
+  const HdLauncherIconHeader *header;
+  gchar *contents;
+  gsize len;
+
+  if (!g_file_get_contents (path, &contents, &len, NULL))
+    return FALSE;
+
+  header = (const HdLauncherIconHeader *) contents;
+  if (len < sizeof (*header)
+      || header->magic != HD_LAUNCHER_ICON_MAGIC
+      || header->version != HD_LAUNCHER_ICON_VERSION
+      || header->mtime != (guint32) st->st_mtime
+      || header->size != (guint32) st->st_size
+      || header->width > HD_LAUNCHER_TILE_ICON_SIZE
+      || header->height > HD_LAUNCHER_TILE_ICON_SIZE
+      || len != sizeof (*header) + header->width * header->height * 4)
+    {
+      g_free (contents);
+      return FALSE;
+    }
+
+  req->width = header->width;
+  req->height = header->height;
+  memmove (contents, contents + sizeof (*header), len - sizeof (*header));
+  req->pixels = (guchar *) contents;
+  return TRUE;
+}
+
+static void
+hd_launcher_icons_write_cache (const HdLauncherIconRequest *req,
+                               const gchar *path, const struct stat *st)
+{
+  HdLauncherIconHeader header;
+  GByteArray *contents;
+  GError *error = NULL;
+  gchar *dir;
+
+  header.magic = HD_LAUNCHER_ICON_MAGIC;
+  header.version = HD_LAUNCHER_ICON_VERSION;
+  header.mtime = st->st_mtime;
+  header.size = st->st_size;
+  header.width = req->width;
+  header.height = req->height;
+
+  contents = g_byte_array_sized_new (sizeof (header)
+                                     + req->width * req->height * 4);
+  g_byte_array_append (contents, (guint8 *) &header, sizeof (header));
+  g_byte_array_append (contents, req->pixels, req->width * req->height * 4);
+
+  dir = g_path_get_dirname (path);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+  if (!g_file_set_contents (path, (gchar *) contents->data, contents->len,
+                            &error))
+    {
+      g_warning ("%s: %s", __FUNCTION__, error->message);
+      g_error_free (error);
+    }
+
+  g_byte_array_free (contents, TRUE);
+}
+
+/* Decode the icon and expand it so there is a 1 pixel transparent
+ * border around it, or the glow effect won't work properly.  We use
+ * gdk_pixbuf_new_from_file_at_size() as the file isn't actually
+ * guaranteed to be the correct size. */
+static gboolean
+hd_launcher_icons_decode (HdLauncherIconRequest *req)
+{
+  GdkPixbuf *pixbuf, *padded;
+  const guchar *src;
+  guint w, h, y, stride;
+
+  pixbuf = gdk_pixbuf_new_from_file_at_size (req->filename,
+                                             HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                             HD_LAUNCHER_TILE_ICON_REAL_SIZE,
+                                             NULL);
+  if (!pixbuf)
+    return FALSE;
+
+  w = gdk_pixbuf_get_width (pixbuf);
+  h = gdk_pixbuf_get_height (pixbuf);
+  padded = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, w + 2, h + 2);
+  gdk_pixbuf_fill (padded, 0);
+  gdk_pixbuf_copy_area (pixbuf, 0, 0, w, h, padded, 1, 1);
+  g_object_unref (pixbuf);
+
+  req->width = w + 2;
+  req->height = h + 2;
+  req->pixels = g_malloc (req->width * req->height * 4);
+  src = gdk_pixbuf_get_pixels (padded);
+  stride = gdk_pixbuf_get_rowstride (padded);
+  for (y = 0; y < req->height; y++)
+    memcpy (req->pixels + y * req->width * 4, src + y * stride,
+            req->width * 4);
+  g_object_unref (padded);
+
+  return TRUE;
+}
+
+/* Fill in the pixels of @req, from the disk cache if we can.
+ * Runs in a worker thread. */
+static void
+hd_launcher_icons_load_pixels (HdLauncherIconRequest *req)
+{
+  struct stat st;
+  gchar *path;
+
+  if (stat (req->filename, &st) != 0)
+    return;
+  req->mtime = st.st_mtime;
+
+  path = hd_launcher_icons_cache_path (req->filename);
+  if (!hd_launcher_icons_read_cache (req, path, &st)
+      && hd_launcher_icons_decode (req))
+    hd_launcher_icons_write_cache (req, path, &st);
+  g_free (path);
+}
+
+/* The alpha of @req's pixels at @x,@y, interpolated like GL would.
+ * Outside the icon it's transparent. */
+static gfloat
+hd_launcher_icons_alpha_at (const HdLauncherIconRequest *req,
+                            gfloat x, gfloat y)
+{
+  gfloat fx, fy, alpha;
+  gint x0, y0, i, j;
+
+  x -= 0.5;
+  y -= 0.5;
+  x0 = floorf (x);
+  y0 = floorf (y);
+  fx = x - x0;
+  fy = y - y0;
+
+  alpha = 0;
+  for (j = 0; j < 2; j++)
+    for (i = 0; i < 2; i++)
+      {
+        gint tx = x0 + i, ty = y0 + j;
+
+        if (tx < 0 || ty < 0 || tx >= req->width || ty >= req->height)
+          continue;
+        alpha += req->pixels[(ty * req->width + tx) * 4 + 3]
+          * (i ? fx : 1 - fx) * (j ? fy : 1 - fy);
+      }
+
+  return alpha / 255;
+}
+
+/*
+ * Replace the icon in @req with its glow, @glow_size pixels square.
+ * This is what the highlight shader used to do at every frame: the
+ * icon is stretched over the glow and its alpha is sampled around
+ * a circle of @glow_radius, then it's painted with @glow_color.
+ * Runs in a worker thread.
+ */
+static void
+hd_launcher_icons_bake_glow (HdLauncherIconRequest *req)
+{
+  static const struct { gfloat dx, dy, weight; } taps[] =
+  {
+    {  1.0000,  0.0000, 0.0675 }, {  0.8660,  0.5000, 0.0675 },
+    {  0.5000,  0.8660, 0.0675 }, {  0.0000,  1.0000, 0.0675 },
+    { -0.5000,  0.8660, 0.0675 }, { -0.8660,  0.5000, 0.0675 },
+    { -1.0000,  0.0000, 0.0675 }, { -0.8660, -0.5000, 0.0675 },
+    { -0.5000, -0.8660, 0.0675 }, {  0.0000, -1.0000, 0.0675 },
+    {  0.5000, -0.8660, 0.0675 }, {  0.8660, -0.5000, 0.0675 },
+    { -0.3000, -0.3000, 0.1250 }, { -0.3000,  0.3000, 0.1250 },
+    {  0.3000,  0.3000, 0.1250 }, {  0.3000, -0.3000, 0.1250 },
+  };
+  guint size = req->glow_size, x, y, i;
+  gfloat sx, sy;
+  guchar *glow;
+
+  sx = (gfloat) req->width / size;
+  sy = (gfloat) req->height / size;
+  glow = g_malloc (size * size * 4);
+  for (y = 0; y < size; y++)
+    for (x = 0; x < size; x++)
+      {
+        guchar *p = glow + (y * size + x) * 4;
+        gfloat u, v, alpha;
+
+        u = (x + 0.5) * sx;
+        v = (y + 0.5) * sy;
+        alpha = 0;
+        for (i = 0; i < G_N_ELEMENTS (taps); i++)
+          alpha += hd_launcher_icons_alpha_at (req,
+                                    u + taps[i].dx * req->glow_radius,
+                                    v + taps[i].dy * req->glow_radius)
+            * taps[i].weight;
+
+        p[0] = req->glow_color.red;
+        p[1] = req->glow_color.green;
+        p[2] = req->glow_color.blue;
+        p[3] = MIN (alpha, 1) * req->glow_color.alpha + 0.5;
+      }
+
+  g_free (req->pixels);
+  req->pixels = glow;
+  req->width = req->height = size;
+}
+
+static void
+hd_launcher_icons_request_free (HdLauncherIconRequest *req)
+{
+  g_free (req->pixels);
+  g_free (req->filename);
+  g_free (req);
+}
+
+/* Put the pixels of @req in the icon atlas.  The file name and the
+ * modification time identify the contents. */
+static HdIconAtlasEntry *
+hd_launcher_icons_atlas_insert (const HdLauncherIconRequest *req)
+{
+  HdIconAtlasEntry *entry;
+  gchar *key;
+
+  if (req->glow_size)
+    key = g_strdup_printf ("%s@%u#glow-%u-%u-%02x%02x%02x%02x",
+                           req->filename, req->mtime,
+                           req->glow_size, req->glow_radius,
+                           req->glow_color.red, req->glow_color.green,
+                           req->glow_color.blue, req->glow_color.alpha);
+  else
+    key = g_strdup_printf ("%s@%u", req->filename, req->mtime);
+  entry = hd_icon_atlas_insert (key, req->width, req->height, req->pixels,
+                                req->width * 4);
+  g_free (key);
+  return entry;
+}
+
+static gboolean
+hd_launcher_icons_loaded_idle (gpointer data)
+{
+  HdLauncherIconRequest *req = data;
+
+  running--;
+  if (!req->cancelled && req->pixels)
+    {
+      HdIconAtlasEntry *entry;
+
+      if ((entry = hd_launcher_icons_atlas_insert (req)) != NULL)
+        {
+          req->cb (entry, req->user_data);
+          hd_icon_atlas_entry_unref (entry);
+        }
+    }
+  else if (!req->cancelled)
+    g_warning ("%s: couldn't load %s", __FUNCTION__, req->filename);
+
+  hd_launcher_icons_request_free (req);
+  hd_launcher_icons_next ();
+  return FALSE;
+}
+
+/* Runs in a worker thread, or in an idle callback if threads are
+ * disabled. */
+static void
+hd_launcher_icons_load (gpointer data, gpointer unused)
+{
+  HdLauncherIconRequest *req = data;
+
+  hd_launcher_icons_load_pixels (req);
+  if (req->pixels && req->glow_size)
+    hd_launcher_icons_bake_glow (req);
+  clutter_threads_add_idle_full (CLUTTER_PRIORITY_REDRAW + 20,
+                                 hd_launcher_icons_loaded_idle, data, NULL);
+}
+
+static gboolean
+hd_launcher_icons_load_idle (gpointer data)
+{
+  hd_launcher_icons_load (data, NULL);
+  return FALSE;
+}
+
+/* Is @actor on the screen, as far as we can tell? */
+static gboolean
+hd_launcher_icons_is_shown (ClutterActor *actor)
+{
+  for (; actor; actor = clutter_actor_get_parent (actor))
+    {
+      if (!CLUTTER_ACTOR_IS_VISIBLE (actor))
+        return FALSE;
+      if (CLUTTER_IS_STAGE (actor))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+hd_launcher_icons_is_inside (ClutterActor *actor, ClutterActor *container)
+{
+  for (; actor; actor = clutter_actor_get_parent (actor))
+    if (actor == container)
+      return TRUE;
+  return FALSE;
+}
+
+/* Icons on the screen come first, then those in the preferred
+ * container, then the rest in the order they were asked for. */
+static GList *
+hd_launcher_icons_pick (void)
+{
+  GList *li, *inside = NULL;
+
+  for (li = pending.head; li; li = li->next)
+    {
+      HdLauncherIconRequest *req = li->data;
+
+      if (hd_launcher_icons_is_shown (req->actor))
+        return li;
+      if (!inside && preferred
+          && hd_launcher_icons_is_inside (req->actor, preferred))
+        inside = li;
+    }
+
+  return inside ? inside : pending.head;
+}
+
+static void
+hd_launcher_icons_next (void)
+{
+  if (!workers && !hd_disable_threads ())
+    workers = g_thread_pool_new (hd_launcher_icons_load, NULL,
+                                 HD_LAUNCHER_ICONS_THREADS, FALSE, NULL);
+
+  /* We hand out only as many as we have threads, so what's pending
+   * can still be reordered as pages are shown. */
+  while (pending.length > 0 && running < HD_LAUNCHER_ICONS_THREADS)
+    {
+      HdLauncherIconRequest *req;
+      GList *li;
+
+      li = hd_launcher_icons_pick ();
+      req = li->data;
+      g_queue_delete_link (&pending, li);
+
+      req->running = TRUE;
+      running++;
+      if (workers)
+        g_thread_pool_push (workers, req, NULL);
+      else
+        clutter_threads_add_idle_full (CLUTTER_PRIORITY_REDRAW + 20,
+                                       hd_launcher_icons_load_idle,
+                                       req, NULL);
+    }
+}
+
+/*
+ * Returns what to show until an icon is loaded: the default application
+ * icon, loaded right away, or a transparent square if there is no such
+ * icon.  It stays in the atlas for good.
+ */
+HdIconAtlasEntry *
+hd_launcher_icons_get_placeholder (void)
+{
+  static HdIconAtlasEntry *placeholder;
+  HdLauncherIconRequest req;
+
+  if (placeholder)
+    return placeholder;
+
+  memset (&req, 0, sizeof (req));
+  if ((req.filename = hd_launcher_icons_lookup (HD_LAUNCHER_DEFAULT_ICON)))
+    hd_launcher_icons_load_pixels (&req);
+  if (!req.pixels)
+    {
+      g_free (req.filename);
+      req.filename = g_strdup ("placeholder");
+      req.width = req.height = HD_LAUNCHER_TILE_ICON_SIZE;
+      req.pixels = g_malloc0 (req.width * req.height * 4);
+    }
+
+  placeholder = hd_launcher_icons_atlas_insert (&req);
+  g_free (req.pixels);
+  g_free (req.filename);
+  return placeholder;
+}
+
+static HdLauncherIconRequest *
+hd_launcher_icons_queue (HdLauncherIconRequest *req, const gchar *filename,
+                         ClutterActor *actor, HdLauncherIconCallback cb,
+                         gpointer user_data)
+{
+  req->filename = g_strdup (filename);
+  req->actor = actor;
+  req->cb = cb;
+  req->user_data = user_data;
+  g_queue_push_tail (&pending, req);
+
+  hd_launcher_icons_next ();
+  return req;
+}
+
+/*
+ * Load the icon in @filename, as returned by hd_launcher_icons_lookup(),
+ * and call @cb with it.  @actor is what will show the icon; it is used
+ * to decide what to load first and must not go away before @cb is
+ * called or the request is cancelled.
+ */
+HdLauncherIconRequest *
+hd_launcher_icons_request (const gchar *filename, ClutterActor *actor,
+                           HdLauncherIconCallback cb, gpointer user_data)
+{
+  return hd_launcher_icons_queue (g_new0 (HdLauncherIconRequest, 1),
+                                  filename, actor, cb, user_data);
+}
+
+/*
+ * Like hd_launcher_icons_request(), but @cb gets the glow of the icon:
+ * a @size pixels square halo of @color around the icon stretched to
+ * that size, blurred by @radius pixels.
+ */
+HdLauncherIconRequest *
+hd_launcher_icons_request_glow (const gchar *filename, guint size,
+                                guint radius, const ClutterColor *color,
+                                ClutterActor *actor,
+                                HdLauncherIconCallback cb, gpointer user_data)
+{
+  HdLauncherIconRequest *req;
+
+  req = g_new0 (HdLauncherIconRequest, 1);
+  req->glow_size = size;
+  req->glow_radius = radius;
+  req->glow_color = *color;
+  return hd_launcher_icons_queue (req, filename, actor, cb, user_data);
+}
+
+/* @cb of @request won't be called.  @request may be %NULL. */
+void
+hd_launcher_icons_cancel (HdLauncherIconRequest *request)
+{
+  if (!request)
+    return;
+
+  if (request->running)
+    { /* The worker has it, it'll be freed when it's back. */
+      request->cancelled = TRUE;
+      request->actor = NULL;
+    }
+  else
+    {
+      g_queue_remove (&pending, request);
+      hd_launcher_icons_request_free (request);
+    }
+}
+
+/* Load the icons of the actors in @container before the others,
+ * unless some are on the screen. */
+void
+hd_launcher_icons_prefer (ClutterActor *container)
+{
+  if (preferred)
+    g_object_remove_weak_pointer (G_OBJECT (preferred),
+                                  (gpointer *) &preferred);
+  preferred = container;
+  if (preferred)
+    g_object_add_weak_pointer (G_OBJECT (preferred),
+                               (gpointer *) &preferred);
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Loads the icons of launcher tiles in the background.  Icons are
+ * decoded and padded by worker threads and the result is kept in
+ * ~/.cache/hildon-desktop/icons, so next time only the pixels need to
+ * be read.  The glows of pressed tiles are made the same way.
+ */
+
+#ifndef __HD_LAUNCHER_ICONS_H__
+#define __HD_LAUNCHER_ICONS_H__
+
+#include <clutter/clutter.h>
+#include "hd-icon-atlas.h"
+
+G_BEGIN_DECLS
+
+typedef struct _HdLauncherIconRequest HdLauncherIconRequest;
+
+/* Called in the main thread with the loaded icon, which is in the icon
+ * atlas.  The caller must hd_icon_atlas_entry_ref() @entry to keep it. */
+typedef void (*HdLauncherIconCallback) (HdIconAtlasEntry *entry,
+                                        gpointer          user_data);
+
+gchar            *hd_launcher_icons_lookup (const gchar *icon_name);
+HdIconAtlasEntry *hd_launcher_icons_get_placeholder (void);
+
+HdLauncherIconRequest *hd_launcher_icons_request (const gchar *filename,
+                                                  ClutterActor *actor,
+                                                  HdLauncherIconCallback cb,
+                                                  gpointer user_data);
+HdLauncherIconRequest *hd_launcher_icons_request_glow (const gchar *filename,
+                                                       guint size,
+                                                       guint radius,
+                                                       const ClutterColor *color,
+                                                       ClutterActor *actor,
+                                                       HdLauncherIconCallback cb,
+                                                       gpointer user_data);
+void hd_launcher_icons_cancel (HdLauncherIconRequest *request);
+void hd_launcher_icons_prefer (ClutterActor *container);
+
+G_END_DECLS
+
+#endif /* __HD_LAUNCHER_ICONS_H__ */
@@ -32,6 +32,8 @@
 #include "hd-launcher-app.h"
 #include "hd-launcher-cat.h"
 
+#include <string.h>
+
 #define I_(str) (g_intern_static_string ((str)))
 #define HD_PARAM_READ (G_PARAM_READABLE    | \
                        G_PARAM_STATIC_NICK | \
@@ -59,19 +61,20 @@ hd_launcher_item_type_get_type (void)
 
 #define HD_LAUNCHER_ITEM_GET_PRIVATE(obj)       (G_TYPE_INSTANCE_GET_PRIVATE ((obj), HD_TYPE_LAUNCHER_ITEM, HdLauncherItemPrivate))
 
+/* All strings are from hd_launcher_item_string_ref(). */
 struct _HdLauncherItemPrivate
 {
-  HdLauncherItemType item_type;
   GQuark id_quark;
-  gchar *id;
-  gchar *name;
-  gchar *icon_name;
-  gchar *comment;
-  gchar *text_domain;
-  gboolean nodisplay;
-  gboolean cssu_force_landscape;
-
-  gchar *category;
+  const gchar *id;
+  const gchar *name;
+  const gchar *icon_name;
+  const gchar *comment;
+  const gchar *text_domain;
+  const gchar *category;
+
+  guint item_type : 2;      /* HdLauncherItemType */
+  guint nodisplay : 1;
+  guint cssu_force_landscape : 1;
 };
 
 enum
@@ -100,37 +103,123 @@ gboolean hd_launcher_item_parse_keyfile (HdLauncherItem *item,
                                          GKeyFile *key_file,
                                          GError **error);
 
-static void
-hd_launcher_item_finalize (GObject *gobject)
+/*
+ * The same few categories, text domains, icon and image paths appear
+ * in many items, and every item used to have its own copy of them.
+ * Instead the strings of all items are kept here once, with a count of
+ * how many times they are used.  Items are parsed in worker threads,
+ * hence the lock.
+ */
+G_LOCK_DEFINE_STATIC (strings);
+static GHashTable *strings;          /* string -> number of users */
+static gsize strings_size;           /* bytes of the strings in @strings */
+static gsize strings_unshared_size;  /* what they would take unshared */
+
+/* Returns the shared copy of @str, which must be released with
+ * hd_launcher_item_string_unref(). */
+const gchar *
+hd_launcher_item_string_ref (const gchar *str)
 {
-  HdLauncherItemPrivate *priv = HD_LAUNCHER_ITEM_GET_PRIVATE (gobject);
+  gpointer key, refs;
 
-  if (priv->name)
-    {
-      g_free (priv->name);
-      priv->name = NULL;
-    }
-  if (priv->icon_name)
-    {
-      g_free (priv->icon_name);
-      priv->icon_name = NULL;
-    }
-  if (priv->comment)
-    {
-      g_free (priv->comment);
-      priv->comment = NULL;
-    }
-  if (priv->text_domain)
+  if (!str)
+    return NULL;
+
+  G_LOCK (strings);
+  if (!strings)
+    strings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  if (g_hash_table_lookup_extended (strings, str, &key, &refs))
+    g_hash_table_insert (strings, key,
+                         GUINT_TO_POINTER (GPOINTER_TO_UINT (refs) + 1));
+  else
     {
-      g_free (priv->text_domain);
-      priv->text_domain = NULL;
+      key = g_strdup (str);
+      g_hash_table_insert (strings, key, GUINT_TO_POINTER (1));
+      strings_size += strlen (str) + 1;
     }
+  strings_unshared_size += strlen (str) + 1;
+  G_UNLOCK (strings);
 
-  if (priv->category)
+  return key;
+}
+
+/* Like hd_launcher_item_string_ref(), but frees @str. */
+const gchar *
+hd_launcher_item_string_take (gchar *str)
+{
+  const gchar *ret;
+
+  ret = hd_launcher_item_string_ref (str);
+  g_free (str);
+  return ret;
+}
+
+void
+hd_launcher_item_string_unref (const gchar *str)
+{
+  gpointer key, refs;
+
+  if (!str)
+    return;
+
+  G_LOCK (strings);
+  if (strings && g_hash_table_lookup_extended (strings, str, &key, &refs))
     {
-      g_free (priv->category);
-      priv->category = NULL;
+      strings_unshared_size -= strlen (str) + 1;
+      if (GPOINTER_TO_UINT (refs) > 1)
+        g_hash_table_insert (strings, key,
+                             GUINT_TO_POINTER (GPOINTER_TO_UINT (refs) - 1));
+      else
+        {
+          strings_size -= strlen (str) + 1;
+          g_hash_table_remove (strings, key);
+        }
     }
+  else
+    g_warning ("%s: '%s' is not a shared string", __FUNCTION__, str);
+  G_UNLOCK (strings);
+}
+
+/* Make *@field a reference to @str, releasing what it was. */
+void
+hd_launcher_item_string_replace (const gchar **field, const gchar *str)
+{
+  const gchar *old = *field;
+
+  *field = hd_launcher_item_string_ref (str);
+  hd_launcher_item_string_unref (old);
+}
+
+/* How many strings there are, how much memory they take and how much
+ * they would take if every item had its own copy. */
+void
+hd_launcher_item_string_stats (guint *n_strings, gsize *size,
+                               gsize *unshared_size)
+{
+  G_LOCK (strings);
+  *n_strings = strings ? g_hash_table_size (strings) : 0;
+  *size = strings_size;
+  *unshared_size = strings_unshared_size;
+  G_UNLOCK (strings);
+}
+
+static void
+hd_launcher_item_finalize (GObject *gobject)
+{
+  HdLauncherItemPrivate *priv = HD_LAUNCHER_ITEM_GET_PRIVATE (gobject);
+
+  hd_launcher_item_string_unref (priv->id);
+  priv->id = NULL;
+  hd_launcher_item_string_unref (priv->name);
+  priv->name = NULL;
+  hd_launcher_item_string_unref (priv->icon_name);
+  priv->icon_name = NULL;
+  hd_launcher_item_string_unref (priv->comment);
+  priv->comment = NULL;
+  hd_launcher_item_string_unref (priv->text_domain);
+  priv->text_domain = NULL;
+  hd_launcher_item_string_unref (priv->category);
+  priv->category = NULL;
 
   G_OBJECT_CLASS (hd_launcher_item_parent_class)->finalize (gobject);
 }
@@ -309,28 +398,29 @@ hd_launcher_item_parse_keyfile (HdLauncherItem *item,
 {
   HdLauncherItemPrivate *priv = HD_LAUNCHER_ITEM_GET_PRIVATE (item);
 
-  priv->name = g_key_file_get_string (key_file,
-                                      HD_DESKTOP_ENTRY_GROUP,
-                                      HD_DESKTOP_ENTRY_NAME,
-                                      NULL);
+  priv->name = hd_launcher_item_string_take (
+                              g_key_file_get_string (key_file,
+                                                     HD_DESKTOP_ENTRY_GROUP,
+                                                     HD_DESKTOP_ENTRY_NAME,
+                                                     NULL));
   if (!priv->name)
-    {
-      g_free (priv->name);
-      return FALSE;
-    }
+    return FALSE;
 
-  priv->icon_name = g_key_file_get_string (key_file,
-                                           HD_DESKTOP_ENTRY_GROUP,
-                                           HD_DESKTOP_ENTRY_ICON,
-                                           NULL);
-  priv->comment = g_key_file_get_string (key_file,
-                                         HD_DESKTOP_ENTRY_GROUP,
-                                         HD_DESKTOP_ENTRY_COMMENT,
-                                         NULL);
-  priv->text_domain = g_key_file_get_string (key_file,
-                                             HD_DESKTOP_ENTRY_GROUP,
-                                             HD_DESKTOP_ENTRY_TEXT_DOMAIN,
-                                             NULL);
+  priv->icon_name = hd_launcher_item_string_take (
+                              g_key_file_get_string (key_file,
+                                                     HD_DESKTOP_ENTRY_GROUP,
+                                                     HD_DESKTOP_ENTRY_ICON,
+                                                     NULL));
+  priv->comment = hd_launcher_item_string_take (
+                              g_key_file_get_string (key_file,
+                                                     HD_DESKTOP_ENTRY_GROUP,
+                                                     HD_DESKTOP_ENTRY_COMMENT,
+                                                     NULL));
+  priv->text_domain = hd_launcher_item_string_take (
+                              g_key_file_get_string (key_file,
+                                                     HD_DESKTOP_ENTRY_GROUP,
+                                                     HD_DESKTOP_ENTRY_TEXT_DOMAIN,
+                                                     NULL));
   priv->cssu_force_landscape = g_key_file_get_boolean (key_file,
                                              HD_DESKTOP_ENTRY_GROUP,
                                              HD_DESKTOP_ENTRY_FORCE_LANDSCAPE,
@@ -406,7 +496,7 @@ hd_launcher_item_new_from_keyfile (const gchar *id,
     return NULL;
 
   result->priv->item_type = type_value->value;
-  result->priv->id = g_strdup (id);
+  result->priv->id = hd_launcher_item_string_ref (id);
   result->priv->id_quark = g_quark_from_string (result->priv->id);
   if (!hd_launcher_item_parse_keyfile (result, key_file, error))
     {
@@ -422,9 +512,126 @@ hd_launcher_item_new_from_keyfile (const gchar *id,
     }
 
   if (category)
-    result->priv->category = g_strdup (category);
+    result->priv->category = hd_launcher_item_string_ref (category);
   else
-    result->priv->category = g_strdup (HD_LAUNCHER_ITEM_TOP_CATEGORY);
+    result->priv->category =
+      hd_launcher_item_string_ref (HD_LAUNCHER_ITEM_TOP_CATEGORY);
+
+  return result;
+}
+
+static void
+hd_launcher_item_set_fields (HdLauncherItem *item,
+                             const HdLauncherItemFields *fields)
+{
+  HdLauncherItemPrivate *priv = item->priv;
+  HdLauncherItemClass *klass;
+
+  hd_launcher_item_string_replace (&priv->name, fields->name);
+  hd_launcher_item_string_replace (&priv->icon_name, fields->icon_name);
+  hd_launcher_item_string_replace (&priv->comment, fields->comment);
+  hd_launcher_item_string_replace (&priv->text_domain, fields->text_domain);
+  priv->cssu_force_landscape = fields->cssu_force_landscape != FALSE;
+
+  klass = HD_LAUNCHER_ITEM_GET_CLASS (item);
+  if (klass->set_fields)
+    klass->set_fields (item, fields);
+}
+
+/*
+ * Creates an item with the values of @fields, as returned by
+ * hd_launcher_item_get_fields() for an item of the same .desktop file.
+ */
+HdLauncherItem *
+hd_launcher_item_new_from_fields (const gchar *id,
+                                  const gchar *category,
+                                  const HdLauncherItemFields *fields)
+{
+  HdLauncherItem *result;
+
+  g_return_val_if_fail (fields != NULL, NULL);
+
+  if (!fields->name)
+    return NULL;
+
+  result = g_object_new (fields->type == HD_APPLICATION_LAUNCHER
+                         ? HD_TYPE_LAUNCHER_APP : HD_TYPE_LAUNCHER_CAT,
+                         NULL);
+  if (!result)
+    return NULL;
+
+  result->priv->item_type = fields->type;
+  result->priv->id = hd_launcher_item_string_ref (id);
+  result->priv->id_quark = g_quark_from_string (result->priv->id);
+  result->priv->category = hd_launcher_item_string_ref (category ? category
+                                            : HD_LAUNCHER_ITEM_TOP_CATEGORY);
+  hd_launcher_item_set_fields (result, fields);
 
   return result;
 }
+
+/* Fills @fields with what @item read from its .desktop file. */
+void
+hd_launcher_item_get_fields (HdLauncherItem *item,
+                             HdLauncherItemFields *fields)
+{
+  HdLauncherItemClass *klass;
+
+  g_return_if_fail (HD_IS_LAUNCHER_ITEM (item));
+
+  memset (fields, 0, sizeof (*fields));
+  fields->type = item->priv->item_type;
+  fields->name = item->priv->name;
+  fields->icon_name = item->priv->icon_name;
+  fields->comment = item->priv->comment;
+  fields->text_domain = item->priv->text_domain;
+  fields->cssu_force_landscape = item->priv->cssu_force_landscape;
+
+  klass = HD_LAUNCHER_ITEM_GET_CLASS (item);
+  if (klass->get_fields)
+    klass->get_fields (item, fields);
+}
+
+/* Do @a and @b hold the same values? */
+gboolean
+hd_launcher_item_fields_equal (const HdLauncherItemFields *a,
+                               const HdLauncherItemFields *b)
+{
+  return a->type == b->type
+    && !g_strcmp0 (a->name, b->name)
+    && !g_strcmp0 (a->icon_name, b->icon_name)
+    && !g_strcmp0 (a->comment, b->comment)
+    && !g_strcmp0 (a->text_domain, b->text_domain)
+    && a->cssu_force_landscape == b->cssu_force_landscape
+    && !g_strcmp0 (a->exec, b->exec)
+    && !g_strcmp0 (a->service, b->service)
+    && !g_strcmp0 (a->loading_image, b->loading_image)
+    && !g_strcmp0 (a->switcher_icon, b->switcher_icon)
+    && !g_strcmp0 (a->wm_class, b->wm_class)
+    && a->prestart_mode == b->prestart_mode
+    && a->priority == b->priority
+    && a->ignore_lowmem == b->ignore_lowmem
+    && a->ignore_load == b->ignore_load;
+}
+
+/*
+ * Copies what @from read from its .desktop file into @item, which must
+ * be of the same type, keeping @item itself.  Returns whether anything
+ * changed.
+ */
+gboolean
+hd_launcher_item_update (HdLauncherItem *item, HdLauncherItem *from)
+{
+  HdLauncherItemFields old, new;
+
+  g_return_val_if_fail (HD_IS_LAUNCHER_ITEM (item), FALSE);
+  g_return_val_if_fail (G_OBJECT_TYPE (item) == G_OBJECT_TYPE (from), FALSE);
+
+  hd_launcher_item_get_fields (item, &old);
+  hd_launcher_item_get_fields (from, &new);
+  if (hd_launcher_item_fields_equal (&old, &new))
+    return FALSE;
+
+  hd_launcher_item_set_fields (item, &new);
+  return TRUE;
+}
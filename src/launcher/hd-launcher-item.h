@@ -56,6 +56,34 @@ typedef enum {
 typedef struct _HdLauncherItem          HdLauncherItem;
 typedef struct _HdLauncherItemPrivate   HdLauncherItemPrivate;
 typedef struct _HdLauncherItemClass     HdLauncherItemClass;
+typedef struct _HdLauncherItemFields    HdLauncherItemFields;
+
+/*
+ * The values an item reads from its .desktop file, in one place, so they
+ * can be stored away and an item recreated without parsing the file again.
+ * The strings are not owned by the structure.
+ */
+struct _HdLauncherItemFields
+{
+  HdLauncherItemType type;
+
+  const gchar *name;
+  const gchar *icon_name;
+  const gchar *comment;
+  const gchar *text_domain;
+  gboolean     cssu_force_landscape;
+
+  /* HdLauncherApp */
+  const gchar *exec;
+  const gchar *service;
+  const gchar *loading_image;
+  const gchar *switcher_icon;
+  const gchar *wm_class;
+  gint         prestart_mode;
+  gint         priority;
+  gboolean     ignore_lowmem;
+  gboolean     ignore_load;
+};
 
 struct _HdLauncherItem
 {
@@ -72,6 +100,10 @@ struct _HdLauncherItemClass
   gboolean (* parse_key_file) (HdLauncherItem *item,
                                GKeyFile *key_file,
                                GError **error);
+  void     (* get_fields)     (HdLauncherItem *item,
+                               HdLauncherItemFields *fields);
+  void     (* set_fields)     (HdLauncherItem *item,
+                               const HdLauncherItemFields *fields);
 };
 
 GType              hd_launcher_item_type_get_type (void) G_GNUC_CONST;
@@ -81,6 +113,15 @@ HdLauncherItem *   hd_launcher_item_new_from_keyfile (const gchar *id,
                                                       const gchar *category,
                                                       GKeyFile *key_file,
                                                       GError   **error);
+HdLauncherItem *   hd_launcher_item_new_from_fields  (const gchar *id,
+                                                      const gchar *category,
+                                                      const HdLauncherItemFields *fields);
+void               hd_launcher_item_get_fields       (HdLauncherItem *item,
+                                                      HdLauncherItemFields *fields);
+gboolean           hd_launcher_item_fields_equal     (const HdLauncherItemFields *a,
+                                                      const HdLauncherItemFields *b);
+gboolean           hd_launcher_item_update           (HdLauncherItem *item,
+                                                      HdLauncherItem *from);
 const gchar *      hd_launcher_item_get_id           (HdLauncherItem *item);
 GQuark             hd_launcher_item_get_id_quark     (HdLauncherItem *item);
 HdLauncherItemType hd_launcher_item_get_item_type    (HdLauncherItem *item);
@@ -92,6 +133,16 @@ const gchar *      hd_launcher_item_get_text_domain  (HdLauncherItem *item);
 const gchar *      hd_launcher_item_get_category     (HdLauncherItem *item);
 gboolean           hd_launcher_item_get_cssu_force_landscape (HdLauncherItem *item);
 
+/* Shared storage for the strings of the items, see hd-launcher-item.c. */
+const gchar *      hd_launcher_item_string_ref       (const gchar *str);
+const gchar *      hd_launcher_item_string_take      (gchar *str);
+void               hd_launcher_item_string_unref     (const gchar *str);
+void               hd_launcher_item_string_replace   (const gchar **field,
+                                                      const gchar *str);
+void               hd_launcher_item_string_stats     (guint *n_strings,
+                                                      gsize *size,
+                                                      gsize *unshared_size);
+
 G_END_DECLS
 
 #endif /* __HD_LAUNCHER_ITEM_H__ */
@@ -35,7 +35,7 @@
 #include <stdlib.h>
 
 #include "hd-gtk-style.h"
-#include "tidy/tidy-highlight.h"
+#include "hd-launcher-icons.h"
 #include "hd-transition.h"
 
 #define I_(str) (g_intern_static_string ((str)))
@@ -53,19 +53,29 @@ struct _HdLauncherTilePrivate
   gchar *icon_name;
   gchar *text;
 
+  gchar *icon_file;
+  gchar *icon_key;
+  gchar *glow_key;
+
   ClutterActor *icon;
   ClutterActor *label;
-  TidyHighlight *icon_glow;
+  ClutterActor *icon_glow;
   ClutterTimeline *glow_timeline;
 
   ClutterActor *click_area;
 
+  HdLauncherIconRequest *icon_request;
+  HdLauncherIconRequest *glow_request;
+
   float glow_amount;
-  float glow_radius; // radius of glow - loaded from transitions.ini
 
   /* We need to know if there's been scrolling. */
   guint    press_timeout;
   gboolean is_pressed;
+
+  /* Whether the label and the icon are loaded, see
+   * hd_launcher_tile_set_bound(). */
+  gboolean bound;
 };
 
 enum
@@ -169,8 +179,8 @@ hd_launcher_tile_init (HdLauncherTile *tile)
   clutter_actor_set_size(CLUTTER_ACTOR(tile),
       HD_LAUNCHER_TILE_WIDTH,
       HD_LAUNCHER_TILE_HEIGHT);
-  clutter_actor_show(CLUTTER_ACTOR(tile));
-  /* Explicitly enable maemo-specific visibility detection to cut down
+  /* Not shown until the grid binds us, see hd_launcher_tile_set_bound().
+   * Explicitly enable maemo-specific visibility detection to cut down
    * spurious paints */
   clutter_actor_set_visibility_detect(CLUTTER_ACTOR(tile), TRUE);
 
@@ -274,131 +284,205 @@ hd_launcher_tile_get_label (HdLauncherTile *tile)
   return priv->label;
 }
 
-void
-hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
-                                const gchar *icon_name)
+static void
+hd_launcher_tile_destroy_glow (HdLauncherTile *tile)
 {
   HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
-  GtkIconTheme *icon_theme;
-  GtkIconInfo *info;
-  GdkPixbuf *pixbuf;
 
-  if (priv->icon_name)
+  hd_launcher_icons_cancel (priv->glow_request);
+  priv->glow_request = NULL;
+  if (priv->icon_glow)
     {
-      g_free (priv->icon_name);
+      clutter_actor_destroy (priv->icon_glow);
+      priv->icon_glow = NULL;
     }
-  if (icon_name)
-    priv->icon_name = g_strdup (icon_name);
+}
+
+/* Show as much glow as we have. */
+static void
+hd_launcher_tile_update_glow (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  if (!priv->icon_glow)
+    return;
+
+  clutter_actor_set_opacity (priv->icon_glow,
+                             (int)(priv->glow_amount * 255));
+  if (priv->glow_amount != 0)
+    clutter_actor_show (priv->icon_glow);
   else
-    /* Set the default if none was passed. */
-    priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
+    clutter_actor_hide (priv->icon_glow);
+}
 
-  /* Recreate the icon actor */
-  if (priv->icon)
+static void
+hd_launcher_tile_glow_loaded (HdIconAtlasEntry *entry, gpointer user_data)
+{
+  HdLauncherTile *tile = user_data;
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  priv->glow_request = NULL;
+  g_free (priv->glow_key);
+  priv->glow_key = g_strdup (hd_icon_atlas_entry_get_key (entry));
+
+  priv->icon_glow = hd_icon_atlas_entry_new_actor (entry);
+  clutter_actor_set_size (priv->icon_glow,
+        HD_LAUNCHER_TILE_GLOW_SIZE,
+        HD_LAUNCHER_TILE_GLOW_SIZE);
+  clutter_actor_set_position (priv->icon_glow,
+        (HD_LAUNCHER_TILE_WIDTH - HD_LAUNCHER_TILE_GLOW_SIZE) / 2,
+        (HD_LAUNCHER_TILE_ICON_SIZE - HD_LAUNCHER_TILE_GLOW_SIZE) / 2);
+  clutter_container_add_actor (CLUTTER_CONTAINER(tile), priv->icon_glow);
+  clutter_actor_lower_bottom (priv->icon_glow);
+
+  hd_launcher_tile_update_glow (tile);
+}
+
+/* The glow is baked into the icon atlas the first time the tile is
+ * pressed, and animating it is just a matter of opacity. */
+static void
+hd_launcher_tile_create_glow (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+  ClutterColor glow_col = {0xFF, 0xFF, 0x7F, 0xFF};
+  HdIconAtlasEntry *entry;
+  float glow_brightness;
+  guint glow_radius;
+
+  if (priv->icon_glow || priv->glow_request || !priv->icon_file)
+    return;
+
+  if (priv->glow_key && (entry = hd_icon_atlas_lookup (priv->glow_key)))
     {
-      clutter_actor_destroy (priv->icon);
-      priv->icon = NULL;
+      hd_launcher_tile_glow_loaded (entry, tile);
+      hd_icon_atlas_entry_unref (entry);
+      return;
     }
 
-  icon_theme = gtk_icon_theme_get_default();
-  info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                    HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                    GTK_ICON_LOOKUP_NO_SVG);
-  if (info == NULL)
+  /* set our glow colour from the theme */
+  glow_brightness = hd_transition_get_double("launcher_glow", "brightness", 1);
+  hd_gtk_style_get_text_color(HD_GTK_BUTTON_SINGLETON, GTK_STATE_NORMAL,
+                              &glow_col);
+  glow_col.alpha = (int)(glow_col.alpha * glow_brightness);
+  /* load our glow radius */
+  glow_radius = hd_transition_get_double("launcher_glow", "radius", 8) + 0.5;
+
+  priv->glow_request = hd_launcher_icons_request_glow (priv->icon_file,
+                                                  HD_LAUNCHER_TILE_GLOW_SIZE,
+                                                  glow_radius, &glow_col,
+                                                  CLUTTER_ACTOR (tile),
+                                                  hd_launcher_tile_glow_loaded,
+                                                  tile);
+}
+
+static void
+hd_launcher_tile_icon_loaded (HdIconAtlasEntry *entry, gpointer user_data)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (user_data);
+
+  priv->icon_request = NULL;
+  hd_icon_atlas_set_actor_entry (priv->icon, entry);
+  g_free (priv->icon_key);
+  priv->icon_key = g_strdup (hd_icon_atlas_entry_get_key (entry));
+}
+
+/*
+ * The icon is loaded in the background.  Until it's there the tile
+ * shows a placeholder, or the previous icon if it had one.
+ */
+static void
+hd_launcher_tile_load_icon (HdLauncherTile *tile)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+  HdIconAtlasEntry *entry;
+
+  hd_launcher_icons_cancel (priv->icon_request);
+  priv->icon_request = NULL;
+
+  if (!priv->icon_file && priv->icon_name)
     {
-      /* Try to get the default icon. */
-      g_free (priv->icon_name);
-      priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
-      info = gtk_icon_theme_lookup_icon(icon_theme, priv->icon_name,
-                                        HD_LAUNCHER_TILE_ICON_REAL_SIZE,
-                                        GTK_ICON_LOOKUP_NO_SVG);
+      priv->icon_file = hd_launcher_icons_lookup (priv->icon_name);
+      if (priv->icon_file == NULL)
+        {
+          /* Try to get the default icon. */
+          g_free (priv->icon_name);
+          priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
+          priv->icon_file = hd_launcher_icons_lookup (priv->icon_name);
+        }
+      if (priv->icon_file == NULL)
+        {
+          g_warning ("%s: couldn't find icon %s\n", __FUNCTION__,
+                     priv->icon_name);
+          g_free (priv->icon_name);
+          priv->icon_name = NULL;
+        }
     }
-  if (info == NULL)
+  if (priv->icon_file == NULL)
     {
-      g_warning ("%s: couldn't find icon %s\n", __FUNCTION__, priv->icon_name);
-      g_free (priv->icon_name);
-      priv->icon_name = NULL;
+      if (priv->icon)
+        {
+          clutter_actor_destroy (priv->icon);
+          priv->icon = NULL;
+        }
       return;
     }
 
-  const gchar *fname = gtk_icon_info_get_filename(info);
-  if (fname == NULL)
+  if (!priv->icon)
     {
-      g_warning ("%s: couldn't get icon %s\n", __FUNCTION__, priv->icon_name);
-      g_free (priv->icon_name);
-      priv->icon_name = NULL;
-      return;
+      priv->icon = hd_icon_atlas_entry_new_actor (
+                                  hd_launcher_icons_get_placeholder ());
+      clutter_actor_set_size (priv->icon,
+          HD_LAUNCHER_TILE_ICON_SIZE,
+          HD_LAUNCHER_TILE_ICON_SIZE);
+      clutter_actor_set_position (priv->icon,
+          (HD_LAUNCHER_TILE_WIDTH - HD_LAUNCHER_TILE_ICON_SIZE) / 2, 0);
+      clutter_container_add_actor (CLUTTER_CONTAINER(tile), priv->icon);
     }
 
-  /* We must expand these images so there is a 1 pixel transparent
-   * border around them, or the glow effect won't work properly. We use
-   * gdk_pixbuf_new_from_file_at_size as the pixbuf pointed to by fname
-   * isn't actually guaranteed to be the correct size.  */
-  pixbuf = gdk_pixbuf_new_from_file_at_size(fname,
-      HD_LAUNCHER_TILE_ICON_REAL_SIZE, HD_LAUNCHER_TILE_ICON_REAL_SIZE, 0);
-  if (pixbuf)
+  /* If it was shown recently it may still be in the atlas. */
+  if (priv->icon_key && (entry = hd_icon_atlas_lookup (priv->icon_key)))
     {
-      gint w = gdk_pixbuf_get_width(pixbuf);
-      gint h = gdk_pixbuf_get_height(pixbuf);
-      GdkPixbuf *pixbufb = gdk_pixbuf_new(
-          GDK_COLORSPACE_RGB, TRUE, 8, w+2, h+2);
-
-      gdk_pixbuf_fill(pixbufb, 0);
-      gdk_pixbuf_copy_area(pixbuf, 0, 0, w, h,
-                           pixbufb, 1, 1);
-
-      priv->icon = clutter_texture_new();
-      clutter_texture_set_from_rgb_data(
-          CLUTTER_TEXTURE(priv->icon),
-          gdk_pixbuf_get_pixels(pixbufb),
-          gdk_pixbuf_get_has_alpha(pixbufb),
-          gdk_pixbuf_get_width(pixbufb),
-          gdk_pixbuf_get_height(pixbufb),
-          gdk_pixbuf_get_rowstride(pixbufb),
-          gdk_pixbuf_get_n_channels(pixbufb), 0, 0);
-      g_object_unref(pixbufb);
+      hd_icon_atlas_set_actor_entry (priv->icon, entry);
+      hd_icon_atlas_entry_unref (entry);
+      return;
     }
-  if (pixbuf)
-    g_object_unref(pixbuf);
 
-  if (!priv->icon)
-  {
-    g_warning ("%s: couldn't create texture for %s\n", __FUNCTION__, fname);
-    g_free (priv->icon_name);
-    priv->icon_name = NULL;
-    return;
-  }
-
-  clutter_actor_set_size (priv->icon,
-      HD_LAUNCHER_TILE_ICON_SIZE,
-      HD_LAUNCHER_TILE_ICON_SIZE);
-  clutter_actor_set_position (priv->icon,
-      (HD_LAUNCHER_TILE_WIDTH - HD_LAUNCHER_TILE_ICON_SIZE) / 2, 0);
-  clutter_container_add_actor (CLUTTER_CONTAINER(tile), priv->icon);
+  priv->icon_request = hd_launcher_icons_request (priv->icon_file,
+                                                  CLUTTER_ACTOR (tile),
+                                                  hd_launcher_tile_icon_loaded,
+                                                  tile);
+}
 
-  gtk_icon_info_free(info);
+void
+hd_launcher_tile_set_icon_name (HdLauncherTile *tile,
+                                const gchar *icon_name)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
 
-  if (priv->icon_glow)
-    /* free the old one */
-    clutter_actor_destroy (CLUTTER_ACTOR (priv->icon_glow));
+  if (priv->icon_name)
+    {
+      g_free (priv->icon_name);
+    }
+  if (icon_name)
+    priv->icon_name = g_strdup (icon_name);
+  else
+    /* Set the default if none was passed. */
+    priv->icon_name = g_strdup (HD_LAUNCHER_DEFAULT_ICON);
 
-  priv->icon_glow = tidy_highlight_new(CLUTTER_TEXTURE(priv->icon));
-  clutter_actor_set_size (CLUTTER_ACTOR(priv->icon_glow),
-        HD_LAUNCHER_TILE_GLOW_SIZE,
-        HD_LAUNCHER_TILE_GLOW_SIZE);
-  clutter_actor_set_position (CLUTTER_ACTOR(priv->icon_glow),
-        (HD_LAUNCHER_TILE_WIDTH - HD_LAUNCHER_TILE_GLOW_SIZE) / 2,
-        (HD_LAUNCHER_TILE_ICON_SIZE - HD_LAUNCHER_TILE_GLOW_SIZE) / 2);
-  clutter_container_add_actor (CLUTTER_CONTAINER(tile),
-                               CLUTTER_ACTOR(priv->icon_glow));
-  clutter_actor_lower_bottom(CLUTTER_ACTOR(priv->icon_glow));
+  hd_launcher_tile_destroy_glow (tile);
+  g_free (priv->icon_file);
+  priv->icon_file = NULL;
+  g_free (priv->icon_key);
+  priv->icon_key = NULL;
+  g_free (priv->glow_key);
+  priv->glow_key = NULL;
 
-  clutter_actor_hide(CLUTTER_ACTOR(priv->icon_glow));
+  if (priv->bound)
+    hd_launcher_tile_load_icon (tile);
 }
 
-void
-hd_launcher_tile_set_text (HdLauncherTile *tile,
-                           const gchar *text)
+static void
+hd_launcher_tile_create_label (HdLauncherTile *tile)
 {
   ClutterColor text_color = {0xFF, 0xFF, 0xFF, 0xFF};
   HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
@@ -406,20 +490,14 @@ hd_launcher_tile_set_text (HdLauncherTile *tile,
   guint label_height, label_width_px;
   gchar *tile_font = NULL;
 
-  if (!text)
-    return;
-
-  if (priv->text)
-    {
-      g_free (priv->text);
-    }
-  priv->text = g_strdup (text);
-
   /* Recreate the label actor */
   if (priv->label)
     {
       clutter_actor_destroy (priv->label);
+      priv->label = NULL;
     }
+  if (!priv->text)
+    return;
 
   tile_font = hd_transition_get_string("task_nav", "tile_font", "Nokia Sans 15");
 
@@ -457,6 +535,64 @@ hd_launcher_tile_set_text (HdLauncherTile *tile,
                   HD_LAUNCHER_TILE_WIDTH, label_height);
 }
 
+void
+hd_launcher_tile_set_text (HdLauncherTile *tile,
+                           const gchar *text)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  if (!text)
+    return;
+
+  if (priv->text)
+    {
+      g_free (priv->text);
+    }
+  priv->text = g_strdup (text);
+
+  if (priv->bound)
+    hd_launcher_tile_create_label (tile);
+}
+
+/*
+ * The grid only binds the tiles near the visible part of the page.
+ * An unbound tile is hidden and has no label, glow or icon of its own;
+ * its icon stays in the atlas until the cell is needed for something
+ * else, so scrolling back is cheap.
+ */
+void
+hd_launcher_tile_set_bound (HdLauncherTile *tile, gboolean bound)
+{
+  HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
+
+  bound = bound != FALSE;
+  if (priv->bound == bound)
+    return;
+  priv->bound = bound;
+
+  if (bound)
+    {
+      hd_launcher_tile_create_label (tile);
+      hd_launcher_tile_load_icon (tile);
+      clutter_actor_show (CLUTTER_ACTOR (tile));
+      return;
+    }
+
+  clutter_actor_hide (CLUTTER_ACTOR (tile));
+  hd_launcher_tile_reset (tile, TRUE);
+  hd_launcher_tile_destroy_glow (tile);
+  hd_launcher_icons_cancel (priv->icon_request);
+  priv->icon_request = NULL;
+  if (priv->icon)
+    hd_icon_atlas_set_actor_entry (priv->icon,
+                                   hd_launcher_icons_get_placeholder ());
+  if (priv->label)
+    {
+      clutter_actor_destroy (priv->label);
+      priv->label = NULL;
+    }
+}
+
 static void
 hd_launcher_tile_set_property (GObject      *gobject,
                                guint         prop_id,
@@ -490,28 +626,20 @@ hd_launcher_on_glow_frame(ClutterTimeline *timeline,
 
   priv->glow_amount = frame_num /
                       (float)clutter_timeline_get_n_frames(timeline);
-  if (priv->icon_glow)
-    tidy_highlight_set_amount(priv->icon_glow,
-                              priv->glow_amount * priv->glow_radius);
-  else
-    return;
-
-  if (priv->glow_amount != 0)
-    clutter_actor_show(CLUTTER_ACTOR(priv->icon_glow));
-  else
-    clutter_actor_hide(CLUTTER_ACTOR(priv->icon_glow));
+  hd_launcher_tile_update_glow (HD_LAUNCHER_TILE (actor));
 }
 
 static void
 hd_launcher_tile_set_glow(HdLauncherTile *tile, gboolean glow, gboolean hard)
 {
   HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (tile);
-  ClutterColor glow_col = {0xFF, 0xFF, 0x7F, 0xFF};
-  float glow_brightness;
   gint n_frames;
 
   clutter_timeline_stop(priv->glow_timeline);
 
+  if (glow)
+    hd_launcher_tile_create_glow (tile);
+
   /* If we're already there, skip */
   if ((glow && priv->glow_amount==1) ||
       (!glow && priv->glow_amount==0))
@@ -521,17 +649,7 @@ hd_launcher_tile_set_glow(HdLauncherTile *tile, gboolean glow, gboolean hard)
   if (hard)
   {
     priv->glow_amount = glow ? 1 : 0;
-    if (priv->icon_glow)
-      tidy_highlight_set_amount(priv->icon_glow,
-                                priv->glow_amount * priv->glow_radius);
-    else
-      return;
-
-    if (priv->glow_amount != 0)
-      clutter_actor_show(CLUTTER_ACTOR(priv->icon_glow));
-    else
-      clutter_actor_hide(CLUTTER_ACTOR(priv->icon_glow));
-
+    hd_launcher_tile_update_glow (tile);
     return;
   }
 
@@ -548,17 +666,6 @@ hd_launcher_tile_set_glow(HdLauncherTile *tile, gboolean glow, gboolean hard)
   clutter_timeline_advance(priv->glow_timeline,
       (int)(priv->glow_amount*n_frames));
 
-  /* set our glow colour from the theme */
-  glow_brightness = hd_transition_get_double("launcher_glow", "brightness", 1);
-  hd_gtk_style_get_text_color(HD_GTK_BUTTON_SINGLETON, GTK_STATE_NORMAL,
-                              &glow_col);
-  glow_col.alpha = (int)(glow_col.alpha * glow_brightness);
-  if (priv->icon_glow)
-    tidy_highlight_set_color(priv->icon_glow, &glow_col);
-  /* load our glow radius */
-  priv->glow_radius = hd_transition_get_double("launcher_glow", "radius", 8);
-
-
   clutter_timeline_start(priv->glow_timeline);
 }
 
@@ -624,6 +731,8 @@ hd_launcher_tile_dispose (GObject *gobject)
 {
   HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (gobject);
 
+  hd_launcher_icons_cancel (priv->icon_request);
+  priv->icon_request = NULL;
   if (priv->press_timeout)
     {
       g_source_remove (priv->press_timeout);
@@ -640,11 +749,7 @@ hd_launcher_tile_dispose (GObject *gobject)
       clutter_actor_destroy (priv->label);
       priv->label = 0;
     }
-  if (priv->icon_glow)
-    {
-      clutter_actor_destroy (CLUTTER_ACTOR(priv->icon_glow));
-      priv->icon_glow = 0;
-    }
+  hd_launcher_tile_destroy_glow (HD_LAUNCHER_TILE (gobject));
   if (priv->icon)
     {
       clutter_actor_destroy (priv->icon);
@@ -659,6 +764,9 @@ hd_launcher_tile_finalize (GObject *gobject)
   HdLauncherTilePrivate *priv = HD_LAUNCHER_TILE_GET_PRIVATE (gobject);
 
   g_free (priv->icon_name);
+  g_free (priv->icon_file);
+  g_free (priv->icon_key);
+  g_free (priv->glow_key);
   g_free (priv->text);
 
   G_OBJECT_CLASS (hd_launcher_tile_parent_class)->finalize (gobject);
@@ -75,6 +75,7 @@ ClutterActor *hd_launcher_tile_get_icon (HdLauncherTile *tile);
 ClutterActor *hd_launcher_tile_get_label (HdLauncherTile *tile);
 
 void hd_launcher_tile_reset(HdLauncherTile *tile, gboolean hard);
+void hd_launcher_tile_set_bound (HdLauncherTile *tile, gboolean bound);
 
 void hd_launcher_tile_activate(ClutterActor       *actor);
 
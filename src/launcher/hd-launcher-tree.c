@@ -4,11 +4,14 @@
 
 #include "hildon-desktop.h"
 #include "hd-launcher-tree.h"
+#include "hd-launcher-cache.h"
+#include "hd-launcher-cat.h"
 
 #include "hd-gtk-style.h"
 
 #include <sys/stat.h>
 #include <unistd.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -25,13 +28,30 @@ typedef struct
   GMenuTreeDirectory *root;
   guint level;
 
-  /* The items we have created so far. */
+  /* The .desktop files to parse, then the items we created from them. */
+  GList *jobs;
   GList *items;
 
+  /* What we parsed the last time, shared by all levels. */
+  HdLauncherCache *cache;
+
+  /* Our resident size in bytes when the walk started. */
+  gsize rss_before;
+
   /* accessed by both threads */
   volatile gboolean cancelled : 1;
 } WalkThreadData;
 
+/* One .desktop file to be parsed by the worker pool. */
+typedef struct
+{
+  gchar *id;
+  gchar *category;
+  gchar *key_file_path;
+
+  HdLauncherItem *item;
+} WalkJob;
+
 struct _HdLauncherTreePrivate
 {
   /* we keep the items inside a list because
@@ -39,6 +59,15 @@ struct _HdLauncherTreePrivate
    */
   GList *items_list;
 
+  /* Indices of items_list, rebuilt whenever it changes.  Earlier items
+   * win over later ones, like when the list was searched. */
+  GHashTable *id_index;       /* id quark -> item */
+  GHashTable *service_index;  /* service -> app */
+  GHashTable *wm_class_index; /* wm_class -> app */
+  GHashTable *exec_index;     /* exec -> app */
+  GHashTable *positions;      /* item -> 1 + its position in items_list */
+  GArray     *lower_ids;      /* HdLauncherTreeLowerId, sorted by id */
+
   /* this is the actual tree of launchers, as
    * built by parsing the applications.menu file
    */
@@ -48,18 +77,29 @@ struct _HdLauncherTreePrivate
   WalkThreadData *active_walk;
 
   gboolean theme_changed_signal_connected : 1;
+  gboolean populated : 1;
 };
 
 enum
 {
   STARTING,
   FINISHED,
+  ITEM_ADDED,
+  ITEM_REMOVED,
+  ITEM_CHANGED,
 
   LAST_SIGNAL
 };
 
 static gulong tree_signals[LAST_SIGNAL] = { 0, };
 
+/* For matching windows whose class is a prefix of an application's id. */
+typedef struct
+{
+  gchar         *id;
+  HdLauncherApp *app;
+} HdLauncherTreeLowerId;
+
 G_DEFINE_TYPE (HdLauncherTree, hd_launcher_tree, G_TYPE_OBJECT);
 
 static void hd_launcher_tree_handle_tree_changed (GMenuTree *menu_tree,
@@ -87,6 +127,7 @@ walk_thread_data_new_level (WalkThreadData *parent, GMenuTreeDirectory *dir)
   WalkThreadData *result = walk_thread_data_new (parent->tree);
   result->level = parent->level + 1;
   result->root = dir;
+  result->cache = parent->cache;
   return result;
 }
 
@@ -98,14 +139,233 @@ walk_thread_data_free (WalkThreadData *data)
   g_free (data);
 }
 
-/**
- * TODO: When we get here, we have two lists of items, the old one
- * and the new one.
- * Using idle times, we replace the old one with the new information
- * but, instead of replacing old items, copying the new values as the
- * old items contain run-time information we can't discard.
- * We also send signals for new and removed items.
+static void
+hd_launcher_tree_free_indices (HdLauncherTree *tree)
+{
+  HdLauncherTreePrivate *priv = tree->priv;
+  guint i;
+
+  if (!priv->id_index)
+    return;
+
+  g_hash_table_destroy (priv->id_index);
+  g_hash_table_destroy (priv->service_index);
+  g_hash_table_destroy (priv->wm_class_index);
+  g_hash_table_destroy (priv->exec_index);
+  g_hash_table_destroy (priv->positions);
+  for (i = 0; i < priv->lower_ids->len; i++)
+    g_free (g_array_index (priv->lower_ids, HdLauncherTreeLowerId, i).id);
+  g_array_free (priv->lower_ids, TRUE);
+  priv->id_index = NULL;
+}
+
+static void
+hd_launcher_tree_index_add (GHashTable *index, gconstpointer key,
+                            gpointer item)
+{
+  if (key && !g_hash_table_lookup (index, key))
+    g_hash_table_insert (index, (gpointer) key, item);
+}
+
+static gint
+hd_launcher_tree_lower_id_cmp (gconstpointer a, gconstpointer b)
+{
+  return strcmp (((const HdLauncherTreeLowerId *) a)->id,
+                 ((const HdLauncherTreeLowerId *) b)->id);
+}
+
+/* The keys of the indices belong to the items, so this must be called
+ * whenever items_list or the items in it change. */
+static void
+hd_launcher_tree_build_indices (HdLauncherTree *tree)
+{
+  HdLauncherTreePrivate *priv = tree->priv;
+  GList *l;
+  guint pos;
+
+  hd_launcher_tree_free_indices (tree);
+  priv->id_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->service_index = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->wm_class_index = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->exec_index = g_hash_table_new (g_str_hash, g_str_equal);
+  priv->positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  priv->lower_ids = g_array_new (FALSE, FALSE,
+                                 sizeof (HdLauncherTreeLowerId));
+
+  for (l = priv->items_list, pos = 1; l; l = l->next, pos++)
+    {
+      HdLauncherItem *item = l->data;
+      HdLauncherApp *app;
+      HdLauncherTreeLowerId lower;
+
+      hd_launcher_tree_index_add (priv->id_index,
+                GUINT_TO_POINTER (hd_launcher_item_get_id_quark (item)), item);
+      g_hash_table_insert (priv->positions, item, GUINT_TO_POINTER (pos));
+      if (!HD_IS_LAUNCHER_APP (item))
+        continue;
+
+      app = HD_LAUNCHER_APP (item);
+      hd_launcher_tree_index_add (priv->service_index,
+                                  hd_launcher_app_get_service (app), app);
+      hd_launcher_tree_index_add (priv->wm_class_index,
+                                  hd_launcher_app_get_wm_class (app), app);
+      hd_launcher_tree_index_add (priv->exec_index,
+                                  hd_launcher_app_get_exec (app), app);
+
+      lower.id = g_ascii_strdown (hd_launcher_item_get_id (item), -1);
+      lower.app = app;
+      g_array_append_val (priv->lower_ids, lower);
+    }
+
+  g_array_sort (priv->lower_ids, hd_launcher_tree_lower_id_cmp);
+}
+
+static gchar *
+hd_launcher_tree_item_key (HdLauncherItem *item)
+{
+  return g_strconcat (hd_launcher_item_get_category (item), "/",
+                      hd_launcher_item_get_id (item), NULL);
+}
+
+/* Returns our resident set size in bytes, or 0 if it's unknown. */
+static gsize
+hd_launcher_tree_get_rss (void)
+{
+  gchar *contents;
+  gulong size, resident;
+  gsize rss = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    {
+      if (sscanf (contents, "%lu %lu", &size, &resident) == 2)
+        rss = (gsize) resident * sysconf (_SC_PAGESIZE);
+      g_free (contents);
+    }
+  return rss;
+}
+
+/* Tell how much resident memory the walk which just finished cost,
+ * and how much of it the strings of the items take. */
+static void
+hd_launcher_tree_report_memory (HdLauncherTree *tree, gsize rss_before)
+{
+  guint n_strings;
+  gsize size, unshared_size, rss_after;
+
+  rss_after = hd_launcher_tree_get_rss ();
+  hd_launcher_item_string_stats (&n_strings, &size, &unshared_size);
+  g_debug ("%s: %u items, resident %" G_GSIZE_FORMAT " -> %" G_GSIZE_FORMAT
+           " kB; %u strings in %" G_GSIZE_FORMAT
+           " bytes (%" G_GSIZE_FORMAT " bytes unshared)", __FUNCTION__,
+           g_list_length (tree->priv->items_list),
+           rss_before / 1024, rss_after / 1024,
+           n_strings, size, unshared_size);
+}
+
+/*
+ * Replace the items of @tree with @items.  Instead of replacing the old
+ * items which are still there, the new values are copied into them, as
+ * they may hold run-time information we can't discard.  Then signals are
+ * sent for the items which were added, removed or changed.  On the first
+ * walk, or if the order of the items changed, clients are told to
+ * rebuild everything instead with ::starting and ::finished.
  */
+static void
+hd_launcher_tree_replace_items (HdLauncherTree *tree, GList *items)
+{
+  HdLauncherTreePrivate *priv = tree->priv;
+  GPtrArray *old_items;
+  GHashTable *old_index;
+  GList *l, *added = NULL, *changed = NULL, *removed = NULL;
+  guint i, last;
+  gboolean reordered;
+
+  /* key -> 1 + position in old_items */
+  old_items = g_ptr_array_new ();
+  old_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  for (l = priv->items_list; l; l = l->next)
+    {
+      g_ptr_array_add (old_items, l->data);
+      g_hash_table_insert (old_index, hd_launcher_tree_item_key (l->data),
+                           GUINT_TO_POINTER (old_items->len));
+    }
+  g_list_free (priv->items_list);
+
+  last = 0;
+  reordered = FALSE;
+  for (l = items; l; l = l->next)
+    {
+      HdLauncherItem *item = l->data;
+      HdLauncherItem *old = NULL;
+      gchar *key;
+      guint pos;
+
+      key = hd_launcher_tree_item_key (item);
+      if ((pos = GPOINTER_TO_UINT (g_hash_table_lookup (old_index, key))))
+        {
+          old = g_ptr_array_index (old_items, pos - 1);
+          if (G_OBJECT_TYPE (old) != G_OBJECT_TYPE (item))
+            old = NULL;
+        }
+
+      if (old)
+        {
+          g_hash_table_remove (old_index, key);
+          g_ptr_array_index (old_items, pos - 1) = NULL;
+          if (pos < last)
+            reordered = TRUE;
+          last = pos;
+
+          if (hd_launcher_item_update (old, item))
+            changed = g_list_prepend (changed, old);
+          g_object_unref (item);
+          l->data = old;
+        }
+      else
+        added = g_list_prepend (added, item);
+      g_free (key);
+    }
+
+  for (i = 0; i < old_items->len; i++)
+    if (g_ptr_array_index (old_items, i))
+      removed = g_list_prepend (removed, g_ptr_array_index (old_items, i));
+  g_ptr_array_free (old_items, TRUE);
+  g_hash_table_destroy (old_index);
+
+  priv->items_list = items;
+  hd_launcher_tree_build_indices (tree);
+  if (!priv->populated || reordered)
+    {
+      if (priv->populated)
+        g_signal_emit (tree, tree_signals[STARTING], 0);
+      priv->populated = TRUE;
+    }
+  else
+    {
+      g_debug ("%s: %u added, %u removed, %u changed", __FUNCTION__,
+               g_list_length (added), g_list_length (removed),
+               g_list_length (changed));
+      for (l = removed; l; l = l->next)
+        g_signal_emit (tree, tree_signals[ITEM_REMOVED], 0, l->data);
+      for (l = changed; l; l = l->next)
+        g_signal_emit (tree, tree_signals[ITEM_CHANGED], 0, l->data);
+      /* Categories first, so they're there for their new items. */
+      added = g_list_reverse (added);
+      for (l = added; l; l = l->next)
+        if (HD_IS_LAUNCHER_CAT (l->data))
+          g_signal_emit (tree, tree_signals[ITEM_ADDED], 0, l->data);
+      for (l = added; l; l = l->next)
+        if (!HD_IS_LAUNCHER_CAT (l->data))
+          g_signal_emit (tree, tree_signals[ITEM_ADDED], 0, l->data);
+    }
+  g_signal_emit (tree, tree_signals[FINISHED], 0);
+
+  g_list_foreach (removed, (GFunc) g_object_unref, NULL);
+  g_list_free (removed);
+  g_list_free (changed);
+  g_list_free (added);
+}
+
 static gboolean
 walk_thread_done_idle (gpointer user_data)
 {
@@ -115,12 +375,10 @@ walk_thread_done_idle (gpointer user_data)
   if ((priv->active_walk == data) && !data->cancelled)
     {
       /* This is the correct walking. */
-      g_list_foreach (priv->items_list, (GFunc) g_object_unref, NULL);
-      g_list_free (priv->items_list);
-      priv->items_list = data->items;
       priv->active_walk = NULL;
       gmenu_tree_item_unref (data->root);
-      g_signal_emit (data->tree, tree_signals[FINISHED], 0);
+      hd_launcher_tree_replace_items (data->tree, data->items);
+      hd_launcher_tree_report_memory (data->tree, data->rss_before);
 
       /* Once the first walk is done, connect to the theme change signal. */
       if (!priv->theme_changed_signal_connected)
@@ -133,23 +391,124 @@ walk_thread_done_idle (gpointer user_data)
         }
 
       walk_thread_data_free (data);
-
-      hd_mutex_enable (FALSE);
     }
   else
     {
       /* This is the result of an obsolete walking, get rid of it. */
-      g_list_foreach (data->items, (GFunc) g_object_unref, NULL);\
+      g_list_foreach (data->items, (GFunc) g_object_unref, NULL);
+      g_list_free (data->items);
       gmenu_tree_item_unref (data->root);
       walk_thread_data_free (data);
     }
 
+  hd_mutex_enable (FALSE);
   return FALSE;
 }
 
+/*
+ * The walking thread is done.  We're in the main thread but not holding
+ * the clutter lock, so it's safe to turn it on for the time it takes to
+ * hand the items over.  walk_thread_done_idle() turns it off again.
+ */
+static gboolean
+walk_thread_handoff_idle (gpointer user_data)
+{
+  hd_mutex_enable (TRUE);
+  clutter_threads_add_idle (walk_thread_done_idle, user_data);
+  return FALSE;
+}
+
+/* Runs in the worker pool. */
+static void
+walk_job_parse (gpointer job_data, gpointer walk_data)
+{
+  WalkJob *job = job_data;
+  WalkThreadData *data = walk_data;
+  GKeyFile *key_file;
+  struct stat key_file_stat;
+  GError *error = NULL;
+
+  if (data->cancelled)
+    return;
+
+  if (!job->key_file_path || stat (job->key_file_path, &key_file_stat))
+    {
+      g_warning ("%s: Unable to stat %s", __FUNCTION__,
+                 job->key_file_path);
+      return;
+    }
+
+  if (hd_launcher_cache_lookup (data->cache, job->key_file_path,
+                                &key_file_stat, job->id, job->category,
+                                &job->item))
+    return;
+
+  key_file = g_key_file_new ();
+  g_key_file_load_from_file (key_file, job->key_file_path, 0, &error);
+  if (error)
+    {
+      g_warning ("%s: Unable to parse %s: %s", __FUNCTION__,
+                 job->key_file_path,
+                 error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      job->item = hd_launcher_item_new_from_keyfile (job->id, job->category,
+                                                     key_file, NULL);
+      hd_launcher_cache_add (data->cache, job->key_file_path,
+                             &key_file_stat, job->item);
+    }
+  g_key_file_free (key_file);
+}
+
+/*
+ * Parse all the collected .desktop files, in parallel if we can, and
+ * turn data->jobs into data->items, keeping the order.
+ */
+static void
+walk_thread_parse (WalkThreadData *data)
+{
+  GThreadPool *pool = NULL;
+  GList *l;
+
+  if (!hd_disable_threads ())
+    {
+      glong ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+      pool = g_thread_pool_new (walk_job_parse, data,
+                                CLAMP (ncpus, 1, 8), TRUE, NULL);
+    }
+
+  for (l = data->jobs; l; l = l->next)
+    if (pool)
+      g_thread_pool_push (pool, l->data, NULL);
+    else
+      walk_job_parse (l->data, data);
+
+  /* This waits for all the jobs to finish. */
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (l = data->jobs; l; l = l->next)
+    {
+      WalkJob *job = l->data;
+
+      if (job->item)
+        data->items = g_list_prepend (data->items, job->item);
+      g_free (job->id);
+      g_free (job->category);
+      g_free (job->key_file_path);
+      g_free (job);
+    }
+  g_list_free (data->jobs);
+  data->jobs = NULL;
+
+  data->items = g_list_reverse (data->items);
+}
+
 /**
- * This function, in a separate thread, builds up a list of items
- * reading their .desktop files.
+ * This function, in a separate thread, collects the .desktop files
+ * of the menu, then has them parsed by a pool of worker threads.
  */
 static gpointer
 walk_thread_func (gpointer user_data)
@@ -158,17 +517,17 @@ walk_thread_func (gpointer user_data)
   GSList *entries;
   GSList *tmp;
 
+  if (data->level == 0)
+    data->cache = hd_launcher_cache_open ();
+
   entries = gmenu_tree_directory_get_contents (data->root);
   tmp = entries;
   while (tmp)
     {
       GMenuTreeItem *tmp_entry = tmp->data;
-      HdLauncherItem *item = NULL;
+      WalkJob *job;
       gchar *id;
       const gchar *key_file_path;
-      GKeyFile *key_file = NULL;
-      struct stat key_file_stat;
-      GError *error = NULL;
 
       switch (gmenu_tree_item_get_type (tmp_entry))
       {
@@ -195,7 +554,7 @@ walk_thread_func (gpointer user_data)
           WalkThreadData *subdata = walk_thread_data_new_level (data, entry_dir);
           subdata->root = entry_dir;
           walk_thread_func ((gpointer)subdata);
-          data->items = g_list_concat (data->items, subdata->items);
+          data->jobs = g_list_concat (data->jobs, subdata->jobs);
           walk_thread_data_free (subdata);
 
           break;
@@ -205,37 +564,12 @@ walk_thread_func (gpointer user_data)
         continue;
       }
 
-      if (stat(key_file_path, &key_file_stat))
-        {
-          g_warning ("%s: Unable to stat %s", __FUNCTION__,
-                               key_file_path);
-        }
-      else
-        {
-          key_file = g_key_file_new ();
-          g_key_file_load_from_file (key_file, key_file_path, 0, &error);
-          if (error)
-            {
-              g_warning ("%s: Unable to parse %s: %s", __FUNCTION__,
-                         key_file_path,
-                         error->message);
-
-              g_error_free (error);
-              g_key_file_free (key_file);
-              key_file = NULL;
-            }
-        }
-
-      if (key_file) {
-        item = hd_launcher_item_new_from_keyfile (id,
-                  gmenu_tree_directory_get_menu_id (data->root),
-                  key_file, NULL);
-	g_key_file_free (key_file);
-      }
-      if (item)
-        data->items = g_list_prepend (data->items, (gpointer)item);
+      job = g_new0 (WalkJob, 1);
+      job->id = id;
+      job->category = g_strdup (gmenu_tree_directory_get_menu_id (data->root));
+      job->key_file_path = g_strdup (key_file_path);
+      data->jobs = g_list_prepend (data->jobs, job);
 
-      g_free (id);
       gmenu_tree_item_unref (tmp->data);
       tmp = tmp->next;
     }
@@ -244,9 +578,15 @@ walk_thread_func (gpointer user_data)
 
   if (data->level == 0)
     {
-      data->items = g_list_reverse (data->items);
+      data->jobs = g_list_reverse (data->jobs);
+      walk_thread_parse (data);
+
+      if (!data->cancelled)
+        hd_launcher_cache_save (data->cache);
+      hd_launcher_cache_free (data->cache);
+      data->cache = NULL;
 
-      clutter_threads_add_idle (walk_thread_done_idle, data);
+      g_idle_add (walk_thread_handoff_idle, data);
     }
 
   return NULL;
@@ -264,6 +604,7 @@ hd_launcher_tree_finalize (GObject *gobject)
       priv->active_walk = NULL;
     }
 
+  hd_launcher_tree_free_indices (HD_LAUNCHER_TREE (gobject));
   g_list_foreach (priv->items_list, (GFunc) g_object_unref, NULL);
   g_list_free (priv->items_list);
   priv->items_list = NULL;
@@ -309,6 +650,27 @@ hd_launcher_tree_class_init (HdLauncherTreeClass *klass)
                   0, NULL, NULL,
                   g_cclosure_marshal_VOID__VOID,
                   G_TYPE_NONE, 0);
+  tree_signals[ITEM_ADDED] =
+    g_signal_new ("item-added",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__OBJECT,
+                  G_TYPE_NONE, 1, HD_TYPE_LAUNCHER_ITEM);
+  tree_signals[ITEM_REMOVED] =
+    g_signal_new ("item-removed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__OBJECT,
+                  G_TYPE_NONE, 1, HD_TYPE_LAUNCHER_ITEM);
+  tree_signals[ITEM_CHANGED] =
+    g_signal_new ("item-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_FIRST,
+                  0, NULL, NULL,
+                  g_cclosure_marshal_VOID__OBJECT,
+                  G_TYPE_NONE, 1, HD_TYPE_LAUNCHER_ITEM);
 }
 
 static void
@@ -351,23 +713,22 @@ hd_launcher_tree_handle_tree_changed (GMenuTree *menu_tree,
       priv->active_walk->cancelled = TRUE;
       priv->active_walk = NULL;
     }
-  else
+  else if (!priv->populated)
     {
-      /* Only signal starting for the first walking. */
+      /* Only signal starting for the first walking, later ones only
+       * change what's different. */
       g_signal_emit (self, tree_signals[STARTING], 0);
     }
 
   data = walk_thread_data_new (self);
   data->root = root;
+  data->rss_before = hd_launcher_tree_get_rss ();
 
   priv->active_walk = data;
   if (hd_disable_threads ())
     walk_thread_func (data);
   else
-    {
-      hd_mutex_enable (TRUE);
-      g_thread_create (walk_thread_func, data, FALSE, NULL);
-    }
+    g_thread_create (walk_thread_func, data, FALSE, NULL);
 }
 
 /* When there's a theme change, tell clients to completely rebuild the
@@ -393,7 +754,9 @@ hd_launcher_tree_handle_theme_changed (HdLauncherTree *tree)
  * to avoid blocking.
  *
  * Emits the #HdLauncherTree::finished
- * when done.
+ * when done.  Later changes to the menu are signalled by
+ * #HdLauncherTree::item-added, #HdLauncherTree::item-removed and
+ * #HdLauncherTree::item-changed, followed by #HdLauncherTree::finished.
  */
 void
 hd_launcher_tree_populate (HdLauncherTree *tree)
@@ -440,46 +803,118 @@ hd_launcher_tree_get_size (HdLauncherTree *tree)
   return g_list_length (tree->priv->items_list);
 }
 
-static gint
-_compare_item_id (gconstpointer a, gconstpointer b)
+HdLauncherItem *
+hd_launcher_tree_find_item (HdLauncherTree *tree, const gchar *id)
 {
-  return g_strcmp0(hd_launcher_item_get_id(HD_LAUNCHER_ITEM (a)),
-                   (const gchar *)b);
+  GQuark quark;
+
+  g_return_val_if_fail (HD_IS_LAUNCHER_TREE (tree), NULL);
+  HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
+
+  /* If there's no quark for it, there's no item with that id. */
+  if (!priv->id_index || !(quark = g_quark_try_string (id)))
+    return NULL;
+  return g_hash_table_lookup (priv->id_index, GUINT_TO_POINTER (quark));
 }
 
-HdLauncherItem *
-hd_launcher_tree_find_item (HdLauncherTree *tree, const gchar *id)
+HdLauncherApp *
+hd_launcher_tree_find_app_by_service (HdLauncherTree *tree, const gchar *service)
 {
   g_return_val_if_fail (HD_IS_LAUNCHER_TREE (tree), NULL);
   HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
 
-  GList *res = g_list_find_custom (priv->items_list, id,
-                                   (GCompareFunc)_compare_item_id);
-  if (res)
-    return res->data;
-  return NULL;
+  if (!priv->service_index || !service)
+    return NULL;
+  return g_hash_table_lookup (priv->service_index, service);
 }
 
-static gint
-_compare_service (gconstpointer a, gconstpointer b)
+/* Keep @app in @best if it comes earlier in the tree. */
+static void
+hd_launcher_tree_earliest (HdLauncherTree *tree, HdLauncherApp *app,
+                           HdLauncherApp **best, guint *best_pos)
 {
-  if (!HD_IS_LAUNCHER_APP(a))
-    return !0;
-  return g_strcmp0(hd_launcher_app_get_service(HD_LAUNCHER_APP (a)),
-                   (const gchar *)b);
+  guint pos;
+
+  if (!app)
+    return;
+  pos = GPOINTER_TO_UINT (g_hash_table_lookup (tree->priv->positions, app));
+  if (pos && pos < *best_pos)
+    {
+      *best = app;
+      *best_pos = pos;
+    }
 }
 
+/**
+ * hd_launcher_tree_find_app_by_window:
+ *
+ * Returns the first application in @tree which
+ * hd_launcher_app_match_window() would match with a window of
+ * @res_name and @res_class, looking it up in the indices instead of
+ * going through every application.
+ */
 HdLauncherApp *
-hd_launcher_tree_find_app_by_service (HdLauncherTree *tree, const gchar *service)
+hd_launcher_tree_find_app_by_window (HdLauncherTree *tree,
+                                     const gchar *res_name,
+                                     const gchar *res_class)
 {
+  HdLauncherTreePrivate *priv;
+  HdLauncherApp *best = NULL;
+  guint best_pos = G_MAXUINT;
+
   g_return_val_if_fail (HD_IS_LAUNCHER_TREE (tree), NULL);
-  HdLauncherTreePrivate *priv = HD_LAUNCHER_TREE_GET_PRIVATE (tree);
+  priv = tree->priv;
 
-  GList *res = g_list_find_custom (priv->items_list, service,
-                                   (GCompareFunc)_compare_service);
-  if (res)
-    return res->data;
-  return NULL;
+  if (!priv->id_index || (!res_name && !res_class))
+    return NULL;
+
+  if (res_class)
+    {
+      gchar *lower;
+      gsize len;
+      guint lo, hi;
+
+      hd_launcher_tree_earliest (tree,
+                             g_hash_table_lookup (priv->wm_class_index,
+                                                  res_class),
+                             &best, &best_pos);
+
+      /* The ids which start with the class, ignoring case, are next to
+       * each other in lower_ids; find the first one. */
+      lower = g_ascii_strdown (res_class, -1);
+      len = strlen (lower);
+      lo = 0;
+      hi = priv->lower_ids->len;
+      while (lo < hi)
+        {
+          guint mid = (lo + hi) / 2;
+
+          if (strcmp (g_array_index (priv->lower_ids,
+                                     HdLauncherTreeLowerId, mid).id,
+                      lower) < 0)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
+      for (; lo < priv->lower_ids->len; lo++)
+        {
+          HdLauncherTreeLowerId *entry;
+
+          entry = &g_array_index (priv->lower_ids, HdLauncherTreeLowerId, lo);
+          if (strncmp (entry->id, lower, len))
+            break;
+          hd_launcher_tree_earliest (tree, entry->app, &best, &best_pos);
+        }
+      g_free (lower);
+    }
+
+  if (res_name)
+    hd_launcher_tree_earliest (tree,
+                               g_hash_table_lookup (priv->exec_index,
+                                                    res_name),
+                               &best, &best_pos);
+
+  return best;
 }
 
 #define CREATE_MODE (S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH)
@@ -43,6 +43,9 @@
 #include "hd-launcher-grid.h"
 #include "hd-launcher-page.h"
 #include "hd-launcher-editor.h"
+#include "hd-launch-image-cache.h"
+#include "hd-launch-trace.h"
+#include "hd-launcher-icons.h"
 #include "hd-gtk-utils.h"
 #include "hd-render-manager.h"
 #include "hd-app-mgr.h"
@@ -98,6 +101,15 @@ struct _HdLauncherPrivate
 
   gboolean portraited;
   gboolean is_editor_in_landscape;
+
+  /* The pages were cleared and need to be built from scratch
+   * when the tree is finished. */
+  gboolean needs_rebuild;
+
+  /* Tiles added and pages changed by the item signals, which are put
+   * in order and laid out when the tree is finished. */
+  GHashTable *added_tiles;
+  GHashTable *changed_pages;
 };
 
 #define HD_LAUNCHER_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), \
@@ -142,6 +154,17 @@ static void hd_launcher_populate_tree_starting (HdLauncherTree *tree,
 static void hd_launcher_populate_tree_finished (HdLauncherTree *tree,
                                                 gpointer data);
 static void hd_launcher_lazy_traverse_cleanup  (gpointer data);
+static void hd_launcher_flush_changes (HdLauncherTree *tree,
+                                       HdLauncher *launcher);
+static void hd_launcher_tree_item_added (HdLauncherTree *tree,
+                                         HdLauncherItem *item,
+                                         gpointer data);
+static void hd_launcher_tree_item_removed (HdLauncherTree *tree,
+                                           HdLauncherItem *item,
+                                           gpointer data);
+static void hd_launcher_tree_item_changed (HdLauncherTree *tree,
+                                           HdLauncherItem *item,
+                                           gpointer data);
 static void hd_launcher_transition_new_frame(ClutterTimeline *timeline,
                                              gint frame_num, gpointer data);
 
@@ -216,6 +239,8 @@ hd_launcher_init (HdLauncher *self)
   self->priv = priv = HD_LAUNCHER_GET_PRIVATE (self);
   priv->gconf_client = gconf_client_get_default ();
   g_datalist_init (&priv->pages);
+  priv->added_tiles = g_hash_table_new (NULL, NULL);
+  priv->changed_pages = g_hash_table_new (NULL, NULL);
 }
 
 static void hd_launcher_constructed (GObject *gobject)
@@ -234,6 +259,15 @@ static void hd_launcher_constructed (GObject *gobject)
   g_signal_connect (priv->tree, "finished",
                     G_CALLBACK (hd_launcher_populate_tree_finished),
                     gobject);
+  g_signal_connect (priv->tree, "item-added",
+                    G_CALLBACK (hd_launcher_tree_item_added),
+                    gobject);
+  g_signal_connect (priv->tree, "item-removed",
+                    G_CALLBACK (hd_launcher_tree_item_removed),
+                    gobject);
+  g_signal_connect (priv->tree, "item-changed",
+                    G_CALLBACK (hd_launcher_tree_item_changed),
+                    gobject);
 
   /* Add callback for clicked background */
   clutter_actor_set_reactive ( self, TRUE );
@@ -275,6 +309,16 @@ hd_launcher_dispose (GObject *gobject)
       priv->gconf_client = NULL;
     }
 
+  if (priv->added_tiles)
+    {
+      g_hash_table_destroy (priv->added_tiles);
+      priv->added_tiles = NULL;
+    }
+  if (priv->changed_pages)
+    {
+      g_hash_table_destroy (priv->changed_pages);
+      priv->changed_pages = NULL;
+    }
   g_datalist_clear (&priv->pages);
 
   G_OBJECT_CLASS (hd_launcher_parent_class)->dispose (gobject);
@@ -337,6 +381,34 @@ hd_launcher_update_orientation (gboolean portraited)
       _hd_launcher_update_orientation_cb, GBOOLEAN_TO_POINTER (portraited));
 }
 
+/* Start loading the launch images of the applications visible
+ * on @page, so they can be shown right away if they're clicked. */
+static void
+hd_launcher_prefetch_page (ClutterActor *page)
+{
+  ClutterActor *grid;
+  GList *tiles, *li;
+  gint top, bottom;
+
+  grid = hd_launcher_page_get_grid (HD_LAUNCHER_PAGE (page));
+  top = CLUTTER_FIXED_TO_INT (
+                    hd_launcher_page_get_scroll_y (HD_LAUNCHER_PAGE (page)));
+  bottom = top + hd_comp_mgr_get_current_screen_height ();
+
+  tiles = clutter_container_get_children (CLUTTER_CONTAINER (grid));
+  for (li = tiles; li; li = li->next)
+    {
+      HdLauncherApp *app;
+      gint y;
+
+      app = g_object_get_data (G_OBJECT (li->data), "HD-LauncherApp");
+      y = clutter_actor_get_y (CLUTTER_ACTOR (li->data));
+      if (app && y + HD_LAUNCHER_TILE_HEIGHT > top && y < bottom)
+        hd_launch_image_cache_prefetch (app);
+    }
+  g_list_free (tiles);
+}
+
 void
 hd_launcher_show (void)
 {
@@ -363,6 +435,7 @@ hd_launcher_show (void)
 
   hd_launcher_page_transition(HD_LAUNCHER_PAGE(priv->active_page),
       HD_LAUNCHER_PAGE_TRANSITION_IN);
+  hd_launcher_prefetch_page (priv->active_page);
   /* We must show *after* starting the transition, because starting a new
    * transition when an old transition is in progress will cause the old
    * transition to be ended - which will in turn hide the launcher if
@@ -375,6 +448,8 @@ hd_launcher_hide (void)
 {
   HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (hd_launcher_get ());
 
+  hd_launch_image_cache_prefetch_frequent ();
+
   if (priv->active_page)
     {
       ClutterActor *top_page = g_datalist_get_data (&priv->pages,
@@ -444,6 +519,7 @@ hd_launcher_category_tile_clicked (HdLauncherTile *tile, gpointer data)
   hd_launcher_page_transition(HD_LAUNCHER_PAGE(page),
         HD_LAUNCHER_PAGE_TRANSITION_IN_SUB);
   priv->active_page = page;
+  hd_launcher_prefetch_page (page);
   g_signal_emit (hd_launcher_get (), launcher_signals[CAT_LAUNCHED],
                  0, NULL);
 }
@@ -467,6 +543,8 @@ hd_launcher_application_tile_clicked (HdLauncherTile *tile,
   else
     priv->launch_tile = NULL;
 
+  hd_launch_trace_mark (hd_launcher_item_get_id (HD_LAUNCHER_ITEM (app)),
+                        HD_LAUNCH_TRACE_CLICK);
   if (!hd_app_mgr_launch (app))
     return;
 
@@ -652,6 +730,9 @@ hd_launcher_populate_tree_starting (HdLauncherTree *tree, gpointer data)
       priv->pages = NULL;
     }
   g_datalist_init(&priv->pages);
+  g_hash_table_remove_all (priv->added_tiles);
+  g_hash_table_remove_all (priv->changed_pages);
+  priv->needs_rebuild = TRUE;
 }
 
 /*
@@ -675,6 +756,71 @@ hd_launcher_create_page (HdLauncherItem *item, gpointer data)
   g_datalist_set_data_full (&priv->pages, hd_launcher_item_get_id (item), newpage, (GDestroyNotify) clutter_actor_destroy);
 }
 
+/* Returns the page the tile of @item goes in. */
+static HdLauncherPage *
+hd_launcher_page_for_item (HdLauncherItem *item)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (hd_launcher_get ());
+  HdLauncherPage *page;
+
+  page = g_datalist_get_data (&priv->pages,
+                              hd_launcher_item_get_category (item));
+  if (!page)
+    /* Put it in the top level. */
+    page = g_datalist_get_data (&priv->pages, HD_LAUNCHER_ITEM_TOP_CATEGORY);
+
+  return page;
+}
+
+/* Create the tile of @item and add it to its page. */
+static HdLauncherTile *
+hd_launcher_add_item_tile (HdLauncherItem *item)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (hd_launcher_get ());
+  HdLauncherTile *tile;
+  HdLauncherPage *page;
+
+  tile = hd_launcher_tile_new (
+      hd_launcher_item_get_icon_name (item),
+      hd_launcher_item_get_local_name (item));
+
+  /* Find in which page it goes.
+   * If we don't have a top level, we're in deep trouble, but we still
+   * check just in case.
+   */
+  if (!(page = hd_launcher_page_for_item (item)))
+    {
+      g_warning ("%s: Couldn't find any page to accept entry %s",
+          __FUNCTION__, hd_launcher_item_get_id (item));
+      g_object_unref (tile);
+      return NULL;
+    }
+
+  hd_launcher_page_add_tile (page, tile);
+  g_object_set_data (G_OBJECT (tile), "HD-LauncherItem", item);
+
+  if (hd_launcher_item_get_item_type(item) == HD_CATEGORY_LAUNCHER)
+    {
+      g_signal_connect (tile, "clicked",
+                        G_CALLBACK (hd_launcher_category_tile_clicked),
+                        g_datalist_get_data (&priv->pages,
+                          hd_launcher_item_get_id (item)));
+    }
+  else if (hd_launcher_item_get_item_type(item) == HD_APPLICATION_LAUNCHER)
+    {
+      g_signal_connect (tile, "clicked",
+                        G_CALLBACK (hd_launcher_application_tile_clicked),
+                        item);
+      g_object_set_data (G_OBJECT (tile), "HD-LauncherApp", item);
+    }
+
+  g_signal_connect (tile, "long-clicked",
+                G_CALLBACK (hd_launcher_application_tile_long_clicked),
+                item);
+
+  return tile;
+}
+
 static gboolean
 hd_launcher_lazy_traverse_tree (gpointer data)
 {
@@ -682,7 +828,6 @@ hd_launcher_lazy_traverse_tree (gpointer data)
   HdLauncherTraverseData *tdata = data;
   HdLauncherItem *item;
   HdLauncherTile *tile;
-  HdLauncherPage *page = NULL;
   guint i;
 
   if (!tdata ||
@@ -692,63 +837,24 @@ hd_launcher_lazy_traverse_tree (gpointer data)
     return FALSE;
 
   /* We're called back with huge latency so let's batch the work
-   * to cut the overall population time. */
-  for (i = 0; i < 5; i++)
+   * to cut the overall population time.  The icons are loaded in the
+   * background, so tiles are cheap to make. */
+  for (i = 0; i < 20; i++)
     {
       if (!tdata->items || !tdata->items->data)
         return FALSE;
       item = tdata->items->data;
 
-      tile = hd_launcher_tile_new (
-          hd_launcher_item_get_icon_name (item),
-          hd_launcher_item_get_local_name (item));
+      tile = hd_launcher_add_item_tile (item);
       /* Signals can be handled during construction, so check this hasn't
        * been cancelled. */
       if (tdata->cancelled)
         {
-          g_object_unref (tile);
+          if (tile)
+            clutter_actor_destroy (CLUTTER_ACTOR (tile));
           return FALSE;
         }
 
-      /* Find in which page it goes */
-      page = g_datalist_get_data (&priv->pages,
-                                  hd_launcher_item_get_category (item));
-      if (!page)
-        /* Put it in the top level. */
-        page = g_datalist_get_data (&priv->pages, HD_LAUNCHER_ITEM_TOP_CATEGORY);
-
-      /* If we don't have a top level, we're in deep trouble, but we still
-       * check just in case.
-       */
-      if (!page)
-        {
-          g_warning ("%s: Couldn't find any page to accept entry %s",
-              __FUNCTION__, hd_launcher_item_get_id (item));
-          g_object_unref (tile);
-        }
-      else
-        {
-          hd_launcher_page_add_tile (page, tile);
-
-          if (hd_launcher_item_get_item_type(item) == HD_CATEGORY_LAUNCHER)
-            {
-              g_signal_connect (tile, "clicked",
-                                G_CALLBACK (hd_launcher_category_tile_clicked),
-                                g_datalist_get_data (&priv->pages,
-                                  hd_launcher_item_get_id (item)));
-            }
-          else if (hd_launcher_item_get_item_type(item) == HD_APPLICATION_LAUNCHER)
-            {
-              g_signal_connect (tile, "clicked",
-                                G_CALLBACK (hd_launcher_application_tile_clicked),
-                                item);
-            }
-
-          g_signal_connect (tile, "long-clicked",
-                        G_CALLBACK (hd_launcher_application_tile_long_clicked),
-                        item);
-        }
-
       g_object_unref (G_OBJECT (item));
       tdata->items = g_list_delete_link (tdata->items, tdata->items);
       if (!tdata->items)
@@ -757,6 +863,7 @@ hd_launcher_lazy_traverse_tree (gpointer data)
 
           /* This traversal has finished. */
           priv->current_traversal = NULL;
+          hd_launch_image_cache_prefetch_frequent ();
 
           /* If the changes came when an editor is present, switch back to
            * launcher
@@ -796,8 +903,19 @@ hd_launcher_populate_tree_finished (HdLauncherTree *tree, gpointer data)
 {
   HdLauncher *launcher = HD_LAUNCHER (data);
   HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
-  HdLauncherTraverseData *tdata = g_new0 (HdLauncherTraverseData, 1);
+  HdLauncherTraverseData *tdata;
 
+  if (!priv->needs_rebuild)
+    {
+      /* The item signals took care of the changes already. */
+      hd_launcher_flush_changes (tree, launcher);
+      if (priv->editor && priv->editor_done)
+        hd_render_manager_set_state (HDRM_STATE_LAUNCHER);
+      return;
+    }
+  priv->needs_rebuild = FALSE;
+
+  tdata = g_new0 (HdLauncherTraverseData, 1);
   /* As we'll be adding these in an idle loop, we need to ensure that they
    * won't disappear while we do this, so we copy the list and ref all the
    * items. */
@@ -830,6 +948,8 @@ hd_launcher_populate_tree_finished (HdLauncherTree *tree, gpointer data)
   clutter_actor_hide (top_page);
   priv->active_page = NULL;
   g_datalist_set_data_full (&priv->pages, HD_LAUNCHER_ITEM_TOP_CATEGORY, top_page, (GDestroyNotify) clutter_actor_destroy);
+  /* Unless the launcher is shown, the first page people see. */
+  hd_launcher_icons_prefer (top_page);
 
   g_list_foreach (tdata->items, (GFunc) hd_launcher_create_page, NULL);
 
@@ -840,6 +960,179 @@ hd_launcher_populate_tree_finished (HdLauncherTree *tree, gpointer data)
                                  hd_launcher_lazy_traverse_cleanup);
 }
 
+/*
+ * Incremental changes of the tree
+ */
+
+/* Returns the tile showing @item in @page, if any. */
+static HdLauncherTile *
+hd_launcher_page_find_tile (HdLauncherPage *page, HdLauncherItem *item)
+{
+  HdLauncherTile *tile = NULL;
+  GList *children, *l;
+
+  children = clutter_container_get_children (
+                        CLUTTER_CONTAINER (hd_launcher_page_get_grid (page)));
+  for (l = children; l && !tile; l = l->next)
+    if (HD_IS_LAUNCHER_TILE (l->data)
+        && g_object_get_data (G_OBJECT (l->data), "HD-LauncherItem") == item)
+      tile = l->data;
+  g_list_free (children);
+
+  return tile;
+}
+
+/* If the tiles are still being created we can't do things piecemeal,
+ * so start over. */
+static gboolean
+hd_launcher_tree_change_needs_rebuild (HdLauncherTree *tree, gpointer data)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (data);
+
+  if (priv->needs_rebuild)
+    return TRUE;
+  if (priv->current_traversal)
+    {
+      hd_launcher_populate_tree_starting (tree, data);
+      return TRUE;
+    }
+  return FALSE;
+}
+
+/* Put the tiles added to @page in the order of the tree, in one go. */
+static void
+hd_launcher_order_page (HdLauncherPage *page, HdLauncherTree *tree,
+                        HdLauncher *launcher)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+  HdLauncherGrid *grid;
+  HdLauncherTile *sibling;
+  GHashTable *tiles;
+  GList *children, *l;
+
+  grid = HD_LAUNCHER_GRID (hd_launcher_page_get_grid (page));
+
+  /* item -> tile */
+  tiles = g_hash_table_new (NULL, NULL);
+  children = clutter_container_get_children (CLUTTER_CONTAINER (grid));
+  for (l = children; l; l = l->next)
+    if (HD_IS_LAUNCHER_TILE (l->data))
+      g_hash_table_insert (tiles,
+                           g_object_get_data (G_OBJECT (l->data),
+                                              "HD-LauncherItem"),
+                           l->data);
+  g_list_free (children);
+
+  /* Walk backwards, so that the sibling is always in its place already.
+   * The tiles which were there before are in order among themselves. */
+  sibling = NULL;
+  for (l = g_list_last (hd_launcher_tree_get_items (tree)); l; l = l->prev)
+    {
+      HdLauncherTile *tile;
+
+      if (!(tile = g_hash_table_lookup (tiles, l->data)))
+        continue;
+      if (g_hash_table_lookup (priv->added_tiles, tile))
+        hd_launcher_grid_move_tile_before (grid, tile, sibling);
+      sibling = tile;
+    }
+  g_hash_table_destroy (tiles);
+
+  hd_launcher_grid_layout (grid);
+}
+
+/* Called when the tree has finished signalling the changes. */
+static void
+hd_launcher_flush_changes (HdLauncherTree *tree, HdLauncher *launcher)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (launcher);
+  GHashTableIter iter;
+  gpointer page;
+
+  g_hash_table_iter_init (&iter, priv->changed_pages);
+  while (g_hash_table_iter_next (&iter, &page, NULL))
+    hd_launcher_order_page (page, tree, launcher);
+
+  g_hash_table_remove_all (priv->added_tiles);
+  g_hash_table_remove_all (priv->changed_pages);
+}
+
+static void
+hd_launcher_tree_item_added (HdLauncherTree *tree, HdLauncherItem *item,
+                             gpointer data)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (data);
+  HdLauncherTile *tile;
+  HdLauncherPage *page;
+
+  if (hd_launcher_tree_change_needs_rebuild (tree, data))
+    return;
+
+  hd_launcher_create_page (item, NULL);
+  if (!(tile = hd_launcher_add_item_tile (item)))
+    return;
+
+  /* It's put in its place by hd_launcher_flush_changes(). */
+  page = hd_launcher_page_for_item (item);
+  g_hash_table_insert (priv->added_tiles, tile, tile);
+  g_hash_table_insert (priv->changed_pages, page, page);
+}
+
+static void
+hd_launcher_tree_item_removed (HdLauncherTree *tree, HdLauncherItem *item,
+                               gpointer data)
+{
+  HdLauncherPrivate *priv = HD_LAUNCHER_GET_PRIVATE (data);
+  HdLauncherTile *tile;
+  HdLauncherPage *page;
+
+  if (hd_launcher_tree_change_needs_rebuild (tree, data))
+    return;
+
+  if ((page = hd_launcher_page_for_item (item))
+      && (tile = hd_launcher_page_find_tile (page, item)))
+    {
+      clutter_actor_destroy (CLUTTER_ACTOR (tile));
+      g_hash_table_insert (priv->changed_pages, page, page);
+    }
+
+  if (hd_launcher_item_get_item_type (item) == HD_CATEGORY_LAUNCHER
+      && (page = g_datalist_get_data (&priv->pages,
+                                      hd_launcher_item_get_id (item))))
+    {
+      if (CLUTTER_ACTOR (page) == priv->active_page)
+        {
+          /* Don't leave the user looking at a page which is gone. */
+          if (STATE_IS_LAUNCHER (hd_render_manager_get_state ()))
+            hd_render_manager_set_state (priv->portraited
+                                         ? HDRM_STATE_HOME_PORTRAIT
+                                         : HDRM_STATE_HOME);
+          priv->active_page = NULL;
+        }
+      g_hash_table_remove (priv->changed_pages, page);
+      g_datalist_remove_data (&priv->pages, hd_launcher_item_get_id (item));
+    }
+}
+
+static void
+hd_launcher_tree_item_changed (HdLauncherTree *tree, HdLauncherItem *item,
+                               gpointer data)
+{
+  HdLauncherTile *tile;
+  HdLauncherPage *page;
+
+  if (hd_launcher_tree_change_needs_rebuild (tree, data))
+    return;
+
+  if ((page = hd_launcher_page_for_item (item))
+      && (tile = hd_launcher_page_find_tile (page, item)))
+    {
+      hd_launcher_tile_set_icon_name (tile,
+                                      hd_launcher_item_get_icon_name (item));
+      hd_launcher_tile_set_text (tile, hd_launcher_item_get_local_name (item));
+    }
+}
+
 /* handle clicks to the fake launch image. If we've been up this long the
    app may have died and we just want to remove ourselves. */
 static gboolean
@@ -913,20 +1206,13 @@ hd_launcher_transition_app_start (HdLauncherApp *item)
   if (item)
     service_name = hd_launcher_app_get_service (item);
 
-  if (service_name &&
-      index(service_name, '/')==NULL &&
-      service_name[0]!='.')
+  if (service_name)
     {
-      if (STATE_IS_PORTRAIT(hd_render_manager_get_state()))
-        cached_image = g_strdup_printf("%s/.cache/launch/%s_portrait.pvr",
-				       getenv("HOME"),
-				       service_name);
-      else
-        cached_image = g_strdup_printf("%s/.cache/launch/%s.pvr",
-				       getenv("HOME"),
-				       service_name);
-
-      if (access (cached_image, R_OK)==0)
+      cached_image = hd_launch_image_cache_get_path (item,
+                          STATE_IS_PORTRAIT(hd_render_manager_get_state()));
+      /* The cache has probably loaded it already. */
+      if (cached_image
+          && (app_image = hd_launch_image_cache_get_texture (cached_image)))
         loading_image = cached_image;
     }
 
@@ -946,7 +1232,8 @@ hd_launcher_transition_app_start (HdLauncherApp *item)
   /* App image - if we had one */
   if (loading_image)
     {
-      app_image = clutter_texture_new_from_file(loading_image, 0);
+      if (!app_image)
+        app_image = clutter_texture_new_from_file(loading_image, 0);
       if (!app_image)
         g_warning("%s: Preload image file '%s' specified for '%s'"
                     " couldn't be loaded",
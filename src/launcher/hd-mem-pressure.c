@@ -0,0 +1,478 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hd-mem-pressure.h"
+#include "hd-transition.h"
+
+#undef  G_LOG_DOMAIN
+#define G_LOG_DOMAIN "hd-mem-pressure"
+
+/*
+ * The source is chosen with HILDON_DESKTOP_MEMORY_MONITOR:
+ *   psi                 PSI triggers on /proc/pressure/memory
+ *   cgroup[:<file>]     memory.events of our cgroup, or of <file>
+ *   fifo:<path>         levels written to a FIFO: none, low or critical
+ *   none                only the lowmem D-Bus signals
+ * By default it's psi, or cgroup if the kernel has no PSI.
+ *
+ * Going up a level happens as soon as the kernel tells us.  Going down
+ * needs a whole release_delay without events and the pressure sampled
+ * below the release thresholds, so we don't flap around a threshold.
+ * We only wake up for that while there is some pressure.
+ */
+#define HD_MEM_PRESSURE_ENV_VAR  "HILDON_DESKTOP_MEMORY_MONITOR"
+#define HD_MEM_PRESSURE_PSI      "/proc/pressure/memory"
+#define HD_MEM_PRESSURE_CGROUPS  "/proc/self/cgroup"
+#define HD_MEM_PRESSURE_CGROUPFS "/sys/fs/cgroup"
+
+#define HD_MEM_PRESSURE_WINDOW \
+  (hd_transition_get_int ("memory_pressure", "window", 2000))
+#define HD_MEM_PRESSURE_LOW_STALL \
+  (hd_transition_get_int ("memory_pressure", "low_stall", 200))
+#define HD_MEM_PRESSURE_CRITICAL_STALL \
+  (hd_transition_get_int ("memory_pressure", "critical_stall", 200))
+#define HD_MEM_PRESSURE_LOW_RELEASE \
+  (hd_transition_get_double ("memory_pressure", "low_release", 5))
+#define HD_MEM_PRESSURE_CRITICAL_RELEASE \
+  (hd_transition_get_double ("memory_pressure", "critical_release", 2))
+#define HD_MEM_PRESSURE_RELEASE_DELAY \
+  (hd_transition_get_int ("memory_pressure", "release_delay", 2000))
+
+typedef struct
+{
+  const gchar          *name;
+  gboolean            (*open)   (const gchar *arg);
+  /* The level the source shows now, for releasing. */
+  HdMemPressureLevel  (*sample) (void);
+} HdMemPressureSource;
+
+static const HdMemPressureSource *source;
+static HdMemPressureLevel         level;
+static HdMemPressureFunc          notify_func;
+static gpointer                   notify_data;
+
+/* Is the release timeout running, and has anything happened since? */
+static guint                      release_id;
+static gboolean                   raised;
+
+static gboolean hd_mem_pressure_release (gpointer data);
+
+static void
+hd_mem_pressure_set_level (HdMemPressureLevel new_level)
+{
+  if (new_level == level)
+    return;
+
+  g_debug ("%s: %s: %d -> %d", __FUNCTION__, source->name, level, new_level);
+  level = new_level;
+
+  if (level > HD_MEM_PRESSURE_NONE && !release_id)
+    release_id = g_timeout_add (HD_MEM_PRESSURE_RELEASE_DELAY,
+                                hd_mem_pressure_release, NULL);
+
+  if (notify_func)
+    notify_func (level, notify_data);
+}
+
+/* The kernel says there is at least @event_level of pressure. */
+static void
+hd_mem_pressure_raise (HdMemPressureLevel event_level)
+{
+  raised = TRUE;
+  if (event_level > level)
+    hd_mem_pressure_set_level (event_level);
+}
+
+static gboolean
+hd_mem_pressure_release (gpointer data)
+{
+  HdMemPressureLevel now;
+
+  if (raised)
+    {
+      raised = FALSE;
+      return TRUE;
+    }
+
+  now = source->sample ();
+  if (now < level)
+    {
+      /* One step at a time, so bgkill follows lowmem off. */
+      release_id = 0;
+      hd_mem_pressure_set_level ((HdMemPressureLevel) (level - 1));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+hd_mem_pressure_watch (gint fd, GIOCondition cond,
+                       GIOFunc func, gpointer data)
+{
+  GIOChannel *channel = g_io_channel_unix_new (fd);
+
+  g_io_add_watch (channel, cond, func, data);
+  g_io_channel_unref (channel);
+}
+
+/* Read the whole of @fd from the start into @buf. */
+static gboolean
+hd_mem_pressure_read (gint fd, gchar *buf, gsize size)
+{
+  gssize n = pread (fd, buf, size - 1, 0);
+
+  if (n < 0)
+    return FALSE;
+  buf[n] = '\0';
+  return TRUE;
+}
+
+/* PSI */
+static gint psi_fds[] = { -1, -1 };  /* some -> LOW, full -> CRITICAL */
+
+static gint
+hd_mem_pressure_psi_trigger (const gchar *kind, gint stall_ms, gint window_ms)
+{
+  gchar trigger[64];
+  gint fd;
+
+  if ((fd = open (HD_MEM_PRESSURE_PSI, O_RDWR | O_NONBLOCK)) < 0)
+    return -1;
+  fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+  /* The kernel wants microseconds and the terminating NUL. */
+  g_snprintf (trigger, sizeof (trigger), "%s %d %d",
+              kind, stall_ms * 1000, window_ms * 1000);
+  if (write (fd, trigger, strlen (trigger) + 1) < 0)
+    {
+      g_warning ("%s: %s: %s", __FUNCTION__, trigger, strerror (errno));
+      close (fd);
+      return -1;
+    }
+
+  return fd;
+}
+
+static gboolean
+hd_mem_pressure_psi_event (GIOChannel *channel, GIOCondition cond,
+                           gpointer data)
+{
+  if (cond & G_IO_ERR)
+    {
+      gint fd = g_io_channel_unix_get_fd (channel);
+      guint i;
+
+      g_warning ("%s: trigger went away", __FUNCTION__);
+      for (i = 0; i < G_N_ELEMENTS (psi_fds); i++)
+        if (psi_fds[i] == fd)
+          psi_fds[i] = -1;
+      close (fd);
+      return FALSE;
+    }
+
+  hd_mem_pressure_raise (GPOINTER_TO_INT (data));
+  return TRUE;
+}
+
+static gboolean
+hd_mem_pressure_psi_open (const gchar *arg)
+{
+  gint window = HD_MEM_PRESSURE_WINDOW;
+
+  psi_fds[0] = hd_mem_pressure_psi_trigger ("some",
+                                            HD_MEM_PRESSURE_LOW_STALL,
+                                            window);
+  if (psi_fds[0] < 0)
+    return FALSE;
+  psi_fds[1] = hd_mem_pressure_psi_trigger ("full",
+                                            HD_MEM_PRESSURE_CRITICAL_STALL,
+                                            window);
+  if (psi_fds[1] < 0)
+    {
+      close (psi_fds[0]);
+      psi_fds[0] = -1;
+      return FALSE;
+    }
+
+  hd_mem_pressure_watch (psi_fds[0], G_IO_PRI, hd_mem_pressure_psi_event,
+                         GINT_TO_POINTER (HD_MEM_PRESSURE_LOW));
+  hd_mem_pressure_watch (psi_fds[1], G_IO_PRI, hd_mem_pressure_psi_event,
+                         GINT_TO_POINTER (HD_MEM_PRESSURE_CRITICAL));
+  return TRUE;
+}
+
+/* Look at the 10s averages to see whether it has calmed down. */
+static HdMemPressureLevel
+hd_mem_pressure_psi_sample (void)
+{
+  gchar buf[256], *line;
+  gdouble some = 0, full = 0;
+
+  if (!hd_mem_pressure_read (psi_fds[0], buf, sizeof (buf)))
+    return level;
+
+  if ((line = strstr (buf, "some avg10=")) != NULL)
+    some = g_ascii_strtod (line + strlen ("some avg10="), NULL);
+  if ((line = strstr (buf, "full avg10=")) != NULL)
+    full = g_ascii_strtod (line + strlen ("full avg10="), NULL);
+
+  if (full >= HD_MEM_PRESSURE_CRITICAL_RELEASE)
+    return HD_MEM_PRESSURE_CRITICAL;
+  if (some >= HD_MEM_PRESSURE_LOW_RELEASE)
+    return HD_MEM_PRESSURE_LOW;
+  return HD_MEM_PRESSURE_NONE;
+}
+
+/* cgroup memory.events */
+static gint    cgroup_fd = -1;
+static guint64 cgroup_high, cgroup_max;
+
+static guint64
+hd_mem_pressure_cgroup_count (const gchar *buf, const gchar *key)
+{
+  gsize len = strlen (key);
+
+  while (buf)
+    {
+      if (!strncmp (buf, key, len) && buf[len] == ' ')
+        return g_ascii_strtoull (buf + len + 1, NULL, 10);
+      if ((buf = strchr (buf, '\n')) != NULL)
+        buf++;
+    }
+  return 0;
+}
+
+/* Returns the level shown by the counters that went up since last time. */
+static HdMemPressureLevel
+hd_mem_pressure_cgroup_update (void)
+{
+  HdMemPressureLevel result = HD_MEM_PRESSURE_NONE;
+  gchar buf[256];
+  guint64 high, max;
+
+  if (!hd_mem_pressure_read (cgroup_fd, buf, sizeof (buf)))
+    return level;
+
+  high = hd_mem_pressure_cgroup_count (buf, "high");
+  /* Hitting the limit, or worse. */
+  max = hd_mem_pressure_cgroup_count (buf, "max")
+    + hd_mem_pressure_cgroup_count (buf, "oom")
+    + hd_mem_pressure_cgroup_count (buf, "oom_kill");
+
+  if (max > cgroup_max)
+    result = HD_MEM_PRESSURE_CRITICAL;
+  else if (high > cgroup_high)
+    result = HD_MEM_PRESSURE_LOW;
+
+  cgroup_high = high;
+  cgroup_max = max;
+  return result;
+}
+
+static gboolean
+hd_mem_pressure_cgroup_event (GIOChannel *channel, GIOCondition cond,
+                              gpointer data)
+{
+  HdMemPressureLevel event_level = hd_mem_pressure_cgroup_update ();
+
+  if (event_level > HD_MEM_PRESSURE_NONE)
+    hd_mem_pressure_raise (event_level);
+  return TRUE;
+}
+
+/* Returns the memory.events of the cgroup we are in. */
+static gchar *
+hd_mem_pressure_cgroup_path (void)
+{
+  gchar *contents, **lines, *path = NULL;
+  guint i;
+
+  if (!g_file_get_contents (HD_MEM_PRESSURE_CGROUPS, &contents, NULL, NULL))
+    return NULL;
+
+  /* The unified hierarchy is "0::/path". */
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i] && !path; i++)
+    if (g_str_has_prefix (lines[i], "0::"))
+      path = g_build_filename (HD_MEM_PRESSURE_CGROUPFS, lines[i] + 3,
+                               "memory.events", NULL);
+
+  g_strfreev (lines);
+  g_free (contents);
+  return path;
+}
+
+static gboolean
+hd_mem_pressure_cgroup_open (const gchar *arg)
+{
+  gchar *path = arg ? g_strdup (arg) : hd_mem_pressure_cgroup_path ();
+
+  if (path)
+    cgroup_fd = open (path, O_RDONLY);
+  g_free (path);
+  if (cgroup_fd < 0)
+    return FALSE;
+  fcntl (cgroup_fd, F_SETFD, FD_CLOEXEC);
+
+  /* Start counting from now.  The file is always readable, but the
+   * kernel raises POLLPRI when it changes. */
+  hd_mem_pressure_cgroup_update ();
+  hd_mem_pressure_watch (cgroup_fd, G_IO_PRI, hd_mem_pressure_cgroup_event,
+                         NULL);
+  return TRUE;
+}
+
+static HdMemPressureLevel
+hd_mem_pressure_cgroup_sample (void)
+{
+  return hd_mem_pressure_cgroup_update ();
+}
+
+/* FIFO, for testing */
+static gint               fifo_fd = -1;
+static HdMemPressureLevel fifo_level;
+
+static gboolean
+hd_mem_pressure_fifo_event (GIOChannel *channel, GIOCondition cond,
+                            gpointer data)
+{
+  gchar buf[256], **words, **word;
+  gssize n;
+
+  while ((n = read (fifo_fd, buf, sizeof (buf) - 1)) > 0)
+    {
+      buf[n] = '\0';
+      words = g_strsplit_set (buf, " \t\n", -1);
+      for (word = words; *word; word++)
+        if (!strcmp (*word, "none") || !strcmp (*word, "0"))
+          fifo_level = HD_MEM_PRESSURE_NONE;
+        else if (!strcmp (*word, "low") || !strcmp (*word, "1"))
+          fifo_level = HD_MEM_PRESSURE_LOW;
+        else if (!strcmp (*word, "critical") || !strcmp (*word, "2"))
+          fifo_level = HD_MEM_PRESSURE_CRITICAL;
+      g_strfreev (words);
+    }
+
+  if (fifo_level > HD_MEM_PRESSURE_NONE)
+    hd_mem_pressure_raise (fifo_level);
+  return TRUE;
+}
+
+static gboolean
+hd_mem_pressure_fifo_open (const gchar *arg)
+{
+  if (!arg)
+    return FALSE;
+
+  /* Keeping it open for writing too means we never see EOF. */
+  if ((fifo_fd = open (arg, O_RDWR | O_NONBLOCK)) < 0)
+    return FALSE;
+  fcntl (fifo_fd, F_SETFD, FD_CLOEXEC);
+
+  hd_mem_pressure_watch (fifo_fd, G_IO_IN, hd_mem_pressure_fifo_event, NULL);
+  return TRUE;
+}
+
+static HdMemPressureLevel
+hd_mem_pressure_fifo_sample (void)
+{
+  return fifo_level;
+}
+
+static const HdMemPressureSource sources[] =
+{
+  { "psi",    hd_mem_pressure_psi_open,    hd_mem_pressure_psi_sample },
+  { "cgroup", hd_mem_pressure_cgroup_open, hd_mem_pressure_cgroup_sample },
+  { "fifo",   hd_mem_pressure_fifo_open,   hd_mem_pressure_fifo_sample },
+};
+
+/*
+ * Start watching memory pressure and call @func in the main loop when
+ * the level changes.  Returns whether there is anything to watch; if
+ * not, only the lowmem signals tell about memory.
+ */
+gboolean
+hd_mem_pressure_start (HdMemPressureFunc func, gpointer user_data)
+{
+  const gchar *env = getenv (HD_MEM_PRESSURE_ENV_VAR);
+  guint i;
+
+  g_return_val_if_fail (!source, TRUE);
+
+  notify_func = func;
+  notify_data = user_data;
+
+  if (env && !strcmp (env, "none"))
+    return FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS (sources); i++)
+    {
+      gsize len = strlen (sources[i].name);
+      const gchar *arg = NULL;
+
+      if (env && *env && strcmp (env, "auto"))
+        {
+          if (strncmp (env, sources[i].name, len)
+              || (env[len] != '\0' && env[len] != ':'))
+            continue;
+          if (env[len] == ':')
+            arg = env + len + 1;
+        }
+      else if (sources[i].open == hd_mem_pressure_fifo_open)
+        continue;
+
+      if (sources[i].open (arg))
+        {
+          source = &sources[i];
+          g_debug ("%s: watching %s", __FUNCTION__, source->name);
+          return TRUE;
+        }
+    }
+
+  if (env && *env && strcmp (env, "auto"))
+    g_warning ("%s: cannot watch %s", __FUNCTION__, env);
+  return FALSE;
+}
+
+HdMemPressureLevel
+hd_mem_pressure_get_level (void)
+{
+  return level;
+}
+
+/* Returns the name of the source we watch, or %NULL. */
+const gchar *
+hd_mem_pressure_get_source (void)
+{
+  return source ? source->name : NULL;
+}
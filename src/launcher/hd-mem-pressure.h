@@ -0,0 +1,52 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/*
+ * Watches memory pressure without polling.  The kernel wakes us up
+ * through PSI triggers or cgroup memory.events, or a FIFO for testing,
+ * and we tell HdAppMgr when the pressure level goes up or down.
+ */
+
+#ifndef __HD_MEM_PRESSURE_H__
+#define __HD_MEM_PRESSURE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  HD_MEM_PRESSURE_NONE = 0,
+  HD_MEM_PRESSURE_LOW,      /* Like bgkill_on: start hibernating. */
+  HD_MEM_PRESSURE_CRITICAL, /* Like lowmem_on: kill what we can. */
+} HdMemPressureLevel;
+
+typedef void (*HdMemPressureFunc) (HdMemPressureLevel level,
+                                   gpointer           user_data);
+
+gboolean           hd_mem_pressure_start      (HdMemPressureFunc func,
+                                               gpointer          user_data);
+HdMemPressureLevel hd_mem_pressure_get_level  (void);
+const gchar       *hd_mem_pressure_get_source (void);
+
+G_END_DECLS
+
+#endif /* __HD_MEM_PRESSURE_H__ */
@@ -40,6 +40,12 @@ struct _HdRunningAppPrivate
   HdRunningAppState state;
   GPid pid;
   time_t last_launch;
+  time_t last_used;
+
+  /* When the launch we are waiting for started, and how long they
+   * took on average, in ms. */
+  GTimeVal launch_started;
+  guint launch_cost;
 };
 
 G_DEFINE_TYPE (HdRunningApp, hd_running_app, G_TYPE_OBJECT);
@@ -144,6 +150,56 @@ hd_running_app_set_last_launch (HdRunningApp *app, time_t time)
   priv->last_launch = time;
 }
 
+time_t
+hd_running_app_get_last_used (HdRunningApp *app)
+{
+  HdRunningAppPrivate *priv = HD_RUNNING_APP_GET_PRIVATE (app);
+  return priv->last_used;
+}
+
+void
+hd_running_app_set_last_used (HdRunningApp *app, time_t time)
+{
+  HdRunningAppPrivate *priv = HD_RUNNING_APP_GET_PRIVATE (app);
+  priv->last_used = time;
+}
+
+void
+hd_running_app_launch_started (HdRunningApp *app)
+{
+  HdRunningAppPrivate *priv = HD_RUNNING_APP_GET_PRIVATE (app);
+  g_get_current_time (&priv->launch_started);
+}
+
+/* The app has appeared; add the time it took to the average. */
+void
+hd_running_app_launch_finished (HdRunningApp *app)
+{
+  HdRunningAppPrivate *priv = HD_RUNNING_APP_GET_PRIVATE (app);
+  GTimeVal now;
+  glong ms;
+
+  if (!priv->launch_started.tv_sec)
+    return;
+
+  g_get_current_time (&now);
+  ms = (now.tv_sec - priv->launch_started.tv_sec) * 1000
+    + (now.tv_usec - priv->launch_started.tv_usec) / 1000;
+  priv->launch_started.tv_sec = 0;
+  if (ms < 0)
+    return;
+
+  priv->launch_cost = priv->launch_cost
+    ? (3 * priv->launch_cost + ms) / 4 : (guint) ms;
+}
+
+guint
+hd_running_app_get_launch_cost (HdRunningApp *app)
+{
+  HdRunningAppPrivate *priv = HD_RUNNING_APP_GET_PRIVATE (app);
+  return priv->launch_cost;
+}
+
 HdLauncherApp  *
 hd_running_app_get_launcher_app  (HdRunningApp *app)
 {
@@ -85,6 +85,12 @@ GPid hd_running_app_get_pid (HdRunningApp *app);
 void hd_running_app_set_pid (HdRunningApp *app, GPid pid);
 time_t hd_running_app_get_last_launch (HdRunningApp *app);
 void   hd_running_app_set_last_launch (HdRunningApp *app, time_t time);
+time_t hd_running_app_get_last_used (HdRunningApp *app);
+void   hd_running_app_set_last_used (HdRunningApp *app, time_t time);
+
+void   hd_running_app_launch_started  (HdRunningApp *app);
+void   hd_running_app_launch_finished (HdRunningApp *app);
+guint  hd_running_app_get_launch_cost (HdRunningApp *app);
 
 /* Some convenience functions. */
 const gchar *hd_running_app_get_service (HdRunningApp *app);
@@ -49,7 +49,9 @@
 #include "hd-theme.h"
 #include "hd-util.h"
 #include "hd-dbus.h"
+#include "hd-screenshot.h"
 #include "launcher/hd-app-mgr.h"
+#include "launcher/hd-launch-helper.h"
 #include "home/hd-render-manager.h"
 #include "hd-transition.h"
 
@@ -124,7 +126,16 @@ hd_mutex_init (void)
   clutter_threads_set_lock_functions (hd_mutex_lock, hd_mutex_unlock);
 }
 
-/* Take screenshot */
+static void
+screenshot_saved (const gchar *filename, gboolean saved, gpointer unused)
+{
+  if (saved)
+    g_debug ("Screenshot '%s' saved.", filename);
+  else
+    g_warning ("Screenshot '%s' could not be saved.", filename);
+}
+
+/* Take screenshot.  It's encoded and saved in the background. */
 static void
 take_screenshot (void)
 {
@@ -132,11 +143,9 @@ take_screenshot (void)
   static gchar datestamp[255];
   static time_t secs = 0;
   struct tm *tm = NULL;
-  GdkDrawable *window;
-  int width, height;
-  GdkPixbuf *image;
-  GError *error = NULL;
-  gboolean ret;
+  Display *dpy;
+  Window root;
+  XWindowAttributes attrs;
 
   if (!getenv("HOME")) {
     g_warning ("Screenshot failed, environment variable HOME missing.");
@@ -160,23 +169,11 @@ take_screenshot (void)
 			      datestamp);
   g_free (path);
 
-  window = gdk_get_default_root_window();
-  gdk_drawable_get_size(window, &width, &height);
-  image = gdk_pixbuf_get_from_drawable(NULL,
-				       window,
-				       gdk_drawable_get_colormap(window),
-				       0, 0,
-				       0, 0,
-				       width, height);
-  ret = gdk_pixbuf_save (image, filename, "png", &error, NULL);
-  g_object_unref(image);
-
-  if (ret) {
-    g_debug ("Screenshot '%s' saved.", filename);
-  } else if (error) {
-    g_warning ("%s: Image saving failed: %s", __func__, error->message);
-    g_error_free (error);
-  }
+  dpy = clutter_x11_get_default_display ();
+  root = clutter_x11_get_root_window ();
+  if (XGetWindowAttributes (dpy, root, &attrs))
+    hd_screenshot_save (dpy, root, attrs.depth, attrs.width, attrs.height,
+                        filename, HD_SCREENSHOT_PNG, screenshot_saved, NULL);
   g_free (filename);
 }
 
@@ -315,12 +312,8 @@ key_binding_func (MBWindowManager   *wm,
         take_screenshot();
 	break;
     case KEY_ACTION_XTERMINAL:
-      {
-        GPid pid;
-        if (hd_app_mgr_execute ("/usr/bin/osso-xterm", &pid, TRUE))
-          g_spawn_close_pid (pid);
-        break;
-      }
+      hd_app_mgr_execute ("/usr/bin/osso-xterm", TRUE, NULL, NULL);
+      break;
     case KEY_ACTION_TOGGLE_PORTRAITABLE:
         toggle_portraitable(wm);
         break;
@@ -644,6 +637,9 @@ main (int argc, char **argv)
   XEventClass eclass[64];
   Atom touchscreen_type;
 
+  /* Before we have grown big and started threads. */
+  hd_launch_helper_start ();
+
   signal (SIGUSR1, dump_debug_info_sighand);
   signal (SIGHUP,  relaunch);
   signal (SIGTERM, terminating);
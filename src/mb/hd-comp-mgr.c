@@ -26,6 +26,7 @@
 #include "hd-switcher.h"
 #include "hd-task-navigator.h"
 #include "hd-home.h"
+#include "hd-home-view-container.h"
 #include "hd-dbus.h"
 #include "hd-atoms.h"
 #include "hd-util.h"
@@ -40,6 +41,7 @@
 #include "hd-title-bar.h"
 #include "launcher/hd-app-mgr.h"
 #include "launcher/hd-launcher-editor.h"
+#include "launcher/hd-launch-trace.h"
 
 #include <matchbox/core/mb-wm.h>
 #include <matchbox/core/mb-window-manager.h>
@@ -143,6 +145,19 @@ struct HdCompMgrClientPrivate
   gboolean              can_hibernate : 1;
 
   gboolean              has_video_overlay;
+
+  /* Whether the client has drawn anything since it was mapped. */
+  gboolean              damaged : 1;
+
+  /* Live background throttling: damage collected since the last repaint
+   * (in root coordinates), the timeout which will repaint it, and whether
+   * we have stopped tracking damage because the live bg is not shown. */
+  ClutterGeometry       live_bg_damage;
+  gboolean              live_bg_damaged : 1;
+  gboolean              live_bg_frozen : 1;
+  guint                 live_bg_flush;
+  GTimeVal              live_bg_last_flush;
+  ClutterActor         *live_bg_texture;
 };
 
 extern gboolean hd_dbus_display_is_off;
@@ -356,6 +371,9 @@ hd_comp_mgr_client_destroy (MBWMObject* obj)
       priv->app = NULL;
     }
 
+  if (priv->live_bg_flush)
+    g_source_remove (priv->live_bg_flush);
+
   g_free (priv);
 }
 
@@ -1407,8 +1425,237 @@ hd_comp_mgr_get_client_transient_for (MBWindowManagerClient *c)
     : NULL;
 }
 
+static void hd_comp_mgr_texture_redraw_area (HdCompMgr *hmgr,
+                                             int x, int y,
+                                             int width, int height,
+                                             ClutterActor *actor);
+
+/* How often may the live background be repainted in the current state. */
+static gint
+hd_comp_mgr_live_bg_fps (void)
+{
+  HDRMStateEnum state = hd_render_manager_get_state ();
+
+  if (STATE_IN_EDIT_MODE (state))
+    return hd_transition_get_int ("live_bg", "fps_edit", 10);
+  if (STATE_IS_LAUNCHER (state))
+    return hd_transition_get_int ("live_bg", "fps_launcher", 5);
+  if (STATE_IS_TASK_NAV (state))
+    return hd_transition_get_int ("live_bg", "fps_task_nav", 10);
+  return hd_transition_get_int ("live_bg", "fps_home", 25);
+}
+
+/* Is the live background @c visible on the screen at all?  If not there's
+ * no point in even tracking its damage. */
+static gboolean
+hd_comp_mgr_live_bg_is_shown (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                              ClutterActor *texture)
+{
+  HDRMStateEnum state = hd_render_manager_get_state ();
+  ClutterActor *stage;
+
+  if (hd_dbus_display_is_off || STATE_IS_APP (state)
+      || STATE_IS_LOADING (state) || hd_comp_mgr_live_bg_fps () <= 0)
+    return FALSE;
+
+  /* HDRM hides whatever is covered by applications, and the view container
+   * hides the views which are off the screen. */
+  stage = clutter_actor_get_stage (texture);
+  if (!stage)
+    return FALSE;
+  for (; texture && texture != stage;
+       texture = clutter_actor_get_parent (texture))
+    if (!CLUTTER_ACTOR_IS_VISIBLE (texture))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* Subtract the opaque applets of the current view from @area (in root
+ * coordinates).  Returns FALSE if nothing remains to be repainted. */
+static gboolean
+hd_comp_mgr_live_bg_clip_damage (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                                 ClutterGeometry *area)
+{
+  HdHome *home = HD_HOME (hmgr->priv->home);
+  MBWindowManagerClient *above;
+  GdkRegion *region;
+  GdkRectangle clip;
+  gboolean empty;
+
+  /* Applets are below these, and they move while swiping. */
+  if (c->window->live_background > 100 || c->window->live_background == -101
+      || hd_home_view_container_is_scrolling (
+                                    hd_home_get_view_container (home)))
+    return TRUE;
+
+  region = gdk_region_rectangle ((GdkRectangle *)(void *)area);
+  for (above = c->stacked_above; above && !gdk_region_empty (region);
+       above = above->stacked_above)
+    {
+      GdkRegion *applet;
+      ClutterActor *actor;
+
+      if (MB_WM_CLIENT_CLIENT_TYPE (above)
+            != (MBWMClientType) HdWmClientTypeHomeApplet
+          || !above->cm_client || !above->window || above->is_argb32
+          || HD_HOME_APPLET (above)->view_id
+                != hd_home_get_current_view_id (home))
+        continue;
+
+      actor = mb_wm_comp_mgr_clutter_client_get_actor (
+                              MB_WM_COMP_MGR_CLUTTER_CLIENT (above->cm_client));
+      if (!actor || !CLUTTER_ACTOR_IS_VISIBLE (actor)
+          || clutter_actor_get_paint_opacity (actor) != 0xff)
+        continue;
+
+      applet = gdk_region_rectangle (
+                          (GdkRectangle *)(void *)&above->window->geometry);
+      gdk_region_subtract (region, applet);
+      gdk_region_destroy (applet);
+    }
+
+  /* Clutter can only take one damaged rectangle, so use the bounding box
+   * of what is left. */
+  empty = gdk_region_empty (region);
+  if (!empty)
+    {
+      gdk_region_get_clipbox (region, &clip);
+      area->x = clip.x;
+      area->y = clip.y;
+      area->width = clip.width;
+      area->height = clip.height;
+    }
+  gdk_region_destroy (region);
+
+  return !empty;
+}
+
+static gboolean
+hd_comp_mgr_live_bg_flush (HdCompMgrClient *hclient)
+{
+  HdCompMgrClientPrivate *priv = hclient->priv;
+  MBWindowManagerClient *c = MB_WM_COMP_MGR_CLIENT (hclient)->wm_client;
+  ClutterGeometry area;
+
+  priv->live_bg_flush = 0;
+  if (!priv->live_bg_damaged || !c->window->live_background
+      || !priv->live_bg_texture)
+    return FALSE;
+
+  g_get_current_time (&priv->live_bg_last_flush);
+  priv->live_bg_damaged = FALSE;
+  area = priv->live_bg_damage;
+
+  if (!hd_comp_mgr_live_bg_clip_damage (HD_COMP_MGR (c->wmref->comp_mgr),
+                                        c, &area))
+    return FALSE;
+
+  /* Back to texture coordinates. */
+  hd_comp_mgr_texture_redraw_area (HD_COMP_MGR (c->wmref->comp_mgr),
+                                   area.x - c->window->geometry.x,
+                                   area.y - c->window->geometry.y,
+                                   area.width, area.height,
+                                   priv->live_bg_texture);
+
+  return FALSE;
+}
+
+/* Damage of a live background: accumulate it and repaint it no more often
+ * than the current state allows, or stop tracking it if it can't be seen. */
 static void
-hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
+hd_comp_mgr_live_bg_damaged (HdCompMgr *hmgr, MBWindowManagerClient *c,
+                             ClutterGeometry *area, ClutterActor *texture)
+{
+  HdCompMgrClient *hclient = HD_COMP_MGR_CLIENT (c->cm_client);
+  HdCompMgrClientPrivate *priv = hclient->priv;
+  ClutterGeometry damage;
+  GTimeVal now;
+  glong elapsed, interval;
+
+  priv->live_bg_texture = texture;
+
+  if (!hd_comp_mgr_live_bg_is_shown (hmgr, c, texture))
+    {
+      /* hd_comp_mgr_update_live_bgs() will resume it. */
+      mb_wm_comp_mgr_clutter_client_track_damage (
+                        MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client), False);
+      priv->live_bg_frozen = TRUE;
+      priv->live_bg_damaged = FALSE;
+      if (priv->live_bg_flush)
+        {
+          g_source_remove (priv->live_bg_flush);
+          priv->live_bg_flush = 0;
+        }
+      return;
+    }
+
+  damage = *area;
+  damage.x += c->window->geometry.x;
+  damage.y += c->window->geometry.y;
+  if (priv->live_bg_damaged)
+    {
+      gint x2, y2;
+
+      x2 = MAX (priv->live_bg_damage.x + priv->live_bg_damage.width,
+                damage.x + damage.width);
+      y2 = MAX (priv->live_bg_damage.y + priv->live_bg_damage.height,
+                damage.y + damage.height);
+      damage.x = MIN (priv->live_bg_damage.x, damage.x);
+      damage.y = MIN (priv->live_bg_damage.y, damage.y);
+      damage.width  = x2 - damage.x;
+      damage.height = y2 - damage.y;
+    }
+  priv->live_bg_damage = damage;
+  priv->live_bg_damaged = TRUE;
+
+  if (priv->live_bg_flush)
+    return;
+
+  g_get_current_time (&now);
+  interval = 1000 / hd_comp_mgr_live_bg_fps ();
+  elapsed = (now.tv_sec - priv->live_bg_last_flush.tv_sec) * 1000
+          + (now.tv_usec - priv->live_bg_last_flush.tv_usec) / 1000;
+  if (elapsed < 0 || elapsed >= interval)
+    hd_comp_mgr_live_bg_flush (hclient);
+  else
+    priv->live_bg_flush = g_timeout_add (interval - elapsed,
+                              (GSourceFunc)hd_comp_mgr_live_bg_flush, hclient);
+}
+
+/* Resume the live backgrounds we stopped in hd_comp_mgr_live_bg_damaged()
+ * if they are visible again.  Called when the state, the stacking, the
+ * current view or the display changes. */
+void
+hd_comp_mgr_update_live_bgs (HdCompMgr *hmgr)
+{
+  MBWindowManagerClient *c;
+
+  for (c = MB_WM_COMP_MGR (hmgr)->wm->stack_bottom; c; c = c->stacked_above)
+    {
+      HdCompMgrClientPrivate *priv;
+
+      if (!c->cm_client || !c->window || !c->window->live_background)
+        continue;
+
+      priv = HD_COMP_MGR_CLIENT (c->cm_client)->priv;
+      if (!priv->live_bg_frozen
+          || !hd_comp_mgr_live_bg_is_shown (hmgr, c, priv->live_bg_texture))
+        continue;
+
+      priv->live_bg_frozen = FALSE;
+      mb_wm_comp_mgr_clutter_client_track_damage (
+                        MB_WM_COMP_MGR_CLUTTER_CLIENT (c->cm_client), True);
+
+      /* Catch up with what we missed while frozen. */
+      clutter_x11_texture_pixmap_update_area (
+                  CLUTTER_X11_TEXTURE_PIXMAP (priv->live_bg_texture), 0, 0,
+                  c->window->geometry.width, c->window->geometry.height);
+    }
+}
+
+static void
+hd_comp_mgr_texture_redraw_area(HdCompMgr *hmgr,
                                 int x, int y, int width, int height,
                                 ClutterActor* actor)
 {
@@ -1481,6 +1728,47 @@ hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
   }
 }
 
+static void
+hd_comp_mgr_texture_update_area(HdCompMgr *hmgr,
+                                int x, int y, int width, int height,
+                                ClutterActor* actor)
+{
+  ClutterActor *parent;
+  MBWMCompMgrClient *cclient;
+
+  if (!actor || !CLUTTER_ACTOR_IS_VISIBLE(actor) || hmgr == 0)
+    return;
+
+  /* Live backgrounds are repainted at their own pace. */
+  parent = clutter_actor_get_parent (actor);
+  cclient = parent ? g_object_get_data (G_OBJECT (parent),
+                                        "HD-MBWMCompMgrClutterClient")
+                   : NULL;
+  if (cclient && cclient->wm_client && cclient->wm_client->window
+      && cclient->wm_client->window->live_background)
+    {
+      ClutterGeometry area = {x, y, width, height};
+      hd_comp_mgr_live_bg_damaged (hmgr, cclient->wm_client, &area, actor);
+      return;
+    }
+
+  if (cclient && !HD_COMP_MGR_CLIENT (cclient)->priv->damaged)
+    {
+      HdRunningApp *app = HD_COMP_MGR_CLIENT (cclient)->priv->app;
+
+      HD_COMP_MGR_CLIENT (cclient)->priv->damaged = TRUE;
+      if (app)
+        hd_launch_trace_mark (hd_running_app_get_id (app),
+                              HD_LAUNCH_TRACE_DAMAGE);
+    }
+
+  /* The switcher may be showing a snapshot of it instead. */
+  if (parent && hd_task_navigator_window_damaged (hd_task_navigator, parent))
+    return;
+
+  hd_comp_mgr_texture_redraw_area (hmgr, x, y, width, height, actor);
+}
+
 /* Hook onto and X11 texture pixmap children of this actor */
 static void
 hd_comp_mgr_hook_update_area(HdCompMgr *hmgr, ClutterActor *actor)
@@ -2185,9 +2473,13 @@ hd_comp_mgr_map_notify (MBWMCompMgr *mgr, MBWindowManagerClient *c)
   actor = mb_wm_comp_mgr_clutter_client_get_actor (cclient);
 
   if (hclient->priv->app)
-    g_object_set_data (G_OBJECT (actor),
-           "HD-ApplicationId",
-           (gchar *)hd_running_app_get_id (hclient->priv->app));
+    {
+      g_object_set_data (G_OBJECT (actor),
+             "HD-ApplicationId",
+             (gchar *)hd_running_app_get_id (hclient->priv->app));
+      hd_launch_trace_mark (hd_running_app_get_id (hclient->priv->app),
+                            HD_LAUNCH_TRACE_MAP);
+    }
 
   hd_comp_mgr_hook_update_area(HD_COMP_MGR (mgr), actor);
 
@@ -3131,6 +3423,17 @@ hd_comp_mgr_restack (MBWMCompMgr * mgr)
                 hd_app_mgr_hibernatable (new_current_app, FALSE);
             }
 
+          /* Let the switcher snapshot the one going to the background. */
+          hd_switcher_current_window_actor_changed (priv->switcher_group,
+                priv->current_hclient
+                  ? mb_wm_comp_mgr_clutter_client_get_actor (
+                      MB_WM_COMP_MGR_CLUTTER_CLIENT (priv->current_hclient))
+                  : NULL,
+                new_current_hclient
+                  ? mb_wm_comp_mgr_clutter_client_get_actor (
+                      MB_WM_COMP_MGR_CLUTTER_CLIENT (new_current_hclient))
+                  : NULL);
+
           priv->current_hclient = new_current_hclient;
         }
 
@@ -3786,6 +4089,8 @@ hd_comp_mgr_update_applets_on_current_desktop_property (HdCompMgr *hmgr)
   g_slist_free (views);
 
   mb_wm_util_async_untrap_x_errors ();
+
+  hd_comp_mgr_update_live_bgs (hmgr);
 }
 
 gboolean
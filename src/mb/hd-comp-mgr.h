@@ -215,6 +215,7 @@ hd_comp_mgr_client_is_maximized (MBGeometry geom)
 gint hd_comp_mgr_time_since_last_map(HdCompMgr *hmgr);
 
 void hd_comp_mgr_update_applets_on_current_desktop_property (HdCompMgr *hmgr);
+void hd_comp_mgr_update_live_bgs (HdCompMgr *hmgr);
 void hd_comp_mgr_unredirect_topmost_client (MBWindowManager *wm,
                                             gboolean force);
 gboolean hd_comp_mgr_reconsider_compositing (MBWMCompMgr *mgr);
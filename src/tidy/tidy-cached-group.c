@@ -310,4 +310,27 @@ void tidy_cached_group_changed(ClutterActor *cached_group)
   priv->source_changed = TRUE;
 }
 
+/**
+ * Frees the cached texture and offscreen buffer. Useful for groups which
+ * are only cached for the duration of an animation - they are recreated
+ * the next time the cache is rendered.
+ */
+void tidy_cached_group_release_cache(ClutterActor *cached_group)
+{
+  TidyCachedGroupPrivate *priv;
+
+  if (!TIDY_IS_CACHED_GROUP(cached_group))
+    return;
+
+  priv = TIDY_CACHED_GROUP(cached_group)->priv;
+  if (priv->fbo)
+    {
+      cogl_offscreen_unref(priv->fbo);
+      cogl_texture_unref(priv->tex);
+      priv->fbo = 0;
+      priv->tex = 0;
+    }
+  priv->source_changed = TRUE;
+}
+
 
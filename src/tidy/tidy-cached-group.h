@@ -38,6 +38,7 @@ void tidy_cached_group_set_render_cache(ClutterActor *cached_group, float amount
 void tidy_cached_group_set_downsampling_factor(ClutterActor *cached_group,
                                                float downsample);
 void tidy_cached_group_changed(ClutterActor *cached_group);
+void tidy_cached_group_release_cache(ClutterActor *cached_group);
 
 
 G_END_DECLS
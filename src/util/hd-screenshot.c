@@ -0,0 +1,415 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "hd-screenshot.h"
+
+#include <errno.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include <glib/gstdio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <matchbox/core/mb-wm.h>
+#include <libhildondesktop/hd-pvr-texture.h>
+
+#include "hildon-desktop.h"
+
+/*
+ * Screenshots are taken in two steps.  In the main thread we copy the
+ * contents of the drawable through MIT-SHM (falling back to XGetImage()
+ * if it's not available), which only takes a memcpy() on our side.
+ * Converting the pixels and encoding them, which is what takes time,
+ * is done by a worker thread, which then calls back in the main thread.
+ */
+typedef struct
+{
+  guchar               *data;
+  guint                 width, height;
+  guint                 bytes_per_line, bits_per_pixel;
+  gint                  byte_order;
+  gulong                red_mask, green_mask, blue_mask;
+
+  /* Saving to a file... */
+  gchar                *filename;
+  HdScreenshotFormat    format;
+  gboolean              saved;
+  HdScreenshotCallback  callback;
+
+  /* ...or scaling down in memory if @filename is %NULL. */
+  guint                 snap_width, snap_height;
+  GdkPixbuf            *snapshot;
+  HdSnapshotCallback    snap_callback;
+
+  gpointer              user_data;
+} HdScreenshotJob;
+
+/* filename -> HdScreenshotJob being saved.  Only used in the main thread. */
+static GHashTable *pending;
+
+/* Copy the contents and pixel layout of @image into @job. */
+static void
+hd_screenshot_copy_image (HdScreenshotJob *job, const XImage *image)
+{
+  job->data = g_memdup (image->data, image->bytes_per_line * image->height);
+  job->bytes_per_line = image->bytes_per_line;
+  job->bits_per_pixel = image->bits_per_pixel;
+  job->byte_order     = image->byte_order;
+}
+
+/* Through MIT-SHM the X server writes the pixels right into our memory
+ * instead of sending them through the socket. */
+static gboolean
+hd_screenshot_grab_shm (HdScreenshotJob *job, Display *xdpy,
+                        Drawable drawable, Visual *visual, guint depth)
+{
+  XImage *image;
+  XShmSegmentInfo shminfo;
+  gboolean isok;
+
+  if (!XShmQueryExtension (xdpy))
+    return FALSE;
+
+  image = XShmCreateImage (xdpy, visual, depth, ZPixmap, NULL, &shminfo,
+                           job->width, job->height);
+  if (!image)
+    return FALSE;
+
+  shminfo.shmid = shmget (IPC_PRIVATE, image->bytes_per_line * image->height,
+                          IPC_CREAT | 0600);
+  if (shminfo.shmid < 0)
+    {
+      XDestroyImage (image);
+      return FALSE;
+    }
+  shminfo.shmaddr = image->data = shmat (shminfo.shmid, NULL, 0);
+  if (shminfo.shmaddr == (char *)-1)
+    { /* Out of address space or not allowed; XGetImage() may still work. */
+      g_debug ("%s: shmat: %s", __FUNCTION__, g_strerror (errno));
+      image->data = NULL;
+      shmctl (shminfo.shmid, IPC_RMID, NULL);
+      XDestroyImage (image);
+      return FALSE;
+    }
+  shminfo.readOnly = False;
+
+  mb_wm_util_trap_x_errors ();
+  XShmAttach (xdpy, &shminfo);
+  XSync (xdpy, False);
+  /* The segment goes away as soon as both of us have detached it. */
+  shmctl (shminfo.shmid, IPC_RMID, NULL);
+  isok = XShmGetImage (xdpy, drawable, image, 0, 0, AllPlanes);
+  XShmDetach (xdpy, &shminfo);
+  if (mb_wm_util_untrap_x_errors ())
+    isok = FALSE;
+
+  if (isok)
+    hd_screenshot_copy_image (job, image);
+
+  XDestroyImage (image);
+  shmdt (shminfo.shmaddr);
+  return isok;
+}
+
+/* Copy @drawable into @job. */
+static gboolean
+hd_screenshot_grab (HdScreenshotJob *job, Display *xdpy, Drawable drawable,
+                    guint depth)
+{
+  Visual *visual;
+
+  visual = DefaultVisual (xdpy, DefaultScreen (xdpy));
+  if (!hd_screenshot_grab_shm (job, xdpy, drawable, visual, depth))
+    {
+      XImage *image;
+
+      g_debug ("%s: MIT-SHM failed, using XGetImage()", __FUNCTION__);
+      mb_wm_util_trap_x_errors ();
+      image = XGetImage (xdpy, drawable, 0, 0, job->width, job->height,
+                         AllPlanes, ZPixmap);
+      mb_wm_util_untrap_x_errors ();
+      if (!image)
+        return FALSE;
+      hd_screenshot_copy_image (job, image);
+      XDestroyImage (image);
+    }
+
+  if (depth == DefaultDepth (xdpy, DefaultScreen (xdpy)))
+    {
+      job->red_mask   = visual->red_mask;
+      job->green_mask = visual->green_mask;
+      job->blue_mask  = visual->blue_mask;
+    }
+  else
+    { /* ARGB windows */
+      job->red_mask   = 0xff0000;
+      job->green_mask = 0x00ff00;
+      job->blue_mask  = 0x0000ff;
+    }
+
+  return TRUE;
+}
+
+/* Scale the @mask bits of @pixel to 0..255. */
+static inline guchar
+hd_screenshot_channel (guint32 pixel, gulong mask, guint shift, guint max)
+{
+  return ((pixel & mask) >> shift) * 255 / max;
+}
+
+static GdkPixbuf *
+hd_screenshot_to_pixbuf (const HdScreenshotJob *job)
+{
+  GdkPixbuf *pixbuf;
+  guchar *dst;
+  guint x, y, stride, bpp;
+  guint rshift, gshift, bshift;
+  guint rmax, gmax, bmax;
+
+  if (!job->red_mask || !job->green_mask || !job->blue_mask
+      || (job->bits_per_pixel != 16 && job->bits_per_pixel != 24
+          && job->bits_per_pixel != 32))
+    {
+      g_warning ("%s: unsupported pixel format (%u bpp)", __FUNCTION__,
+                 job->bits_per_pixel);
+      return NULL;
+    }
+
+  rshift = g_bit_nth_lsf (job->red_mask, -1);
+  gshift = g_bit_nth_lsf (job->green_mask, -1);
+  bshift = g_bit_nth_lsf (job->blue_mask, -1);
+  rmax = job->red_mask >> rshift;
+  gmax = job->green_mask >> gshift;
+  bmax = job->blue_mask >> bshift;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8,
+                           job->width, job->height);
+  dst = gdk_pixbuf_get_pixels (pixbuf);
+  stride = gdk_pixbuf_get_rowstride (pixbuf);
+  bpp = job->bits_per_pixel / 8;
+
+  for (y = 0; y < job->height; y++)
+    {
+      const guchar *src = job->data + y * job->bytes_per_line;
+      guchar *row = dst + y * stride;
+
+      for (x = 0; x < job->width; x++, src += bpp, row += 3)
+        {
+          guint32 pixel;
+          guint i;
+
+          pixel = 0;
+          if (job->byte_order == LSBFirst)
+            for (i = bpp; i > 0; i--)
+              pixel = (pixel << 8) | src[i - 1];
+          else
+            for (i = 0; i < bpp; i++)
+              pixel = (pixel << 8) | src[i];
+
+          row[0] = hd_screenshot_channel (pixel, job->red_mask, rshift, rmax);
+          row[1] = hd_screenshot_channel (pixel, job->green_mask, gshift,
+                                          gmax);
+          row[2] = hd_screenshot_channel (pixel, job->blue_mask, bshift, bmax);
+        }
+    }
+
+  return pixbuf;
+}
+
+static gboolean
+hd_screenshot_done_idle (gpointer user_data)
+{
+  HdScreenshotJob *job = user_data;
+
+  if (!job->filename)
+    job->snap_callback (job->snapshot, job->user_data);
+  else
+    {
+      g_hash_table_remove (pending, job->filename);
+      if (job->callback)
+        job->callback (job->filename, job->saved, job->user_data);
+    }
+
+  g_free (job->filename);
+  g_free (job);
+  return FALSE;
+}
+
+/* Runs in the worker thread, except if threads are disabled. */
+static void
+hd_screenshot_encode (gpointer data, gpointer unused)
+{
+  HdScreenshotJob *job = data;
+  GdkPixbuf *pixbuf;
+  GError *error = NULL;
+  gchar *tmp;
+
+  pixbuf = hd_screenshot_to_pixbuf (job);
+  g_free (job->data);
+  job->data = NULL;
+
+  if (!job->filename)
+    {
+      if (pixbuf)
+        {
+          job->snapshot = gdk_pixbuf_scale_simple (pixbuf, job->snap_width,
+                                                   job->snap_height,
+                                                   GDK_INTERP_BILINEAR);
+          g_object_unref (pixbuf);
+        }
+    }
+  else if (pixbuf)
+    {
+      /* Write it under a temporary name, so nobody reads it half-done. */
+      tmp = g_strconcat (job->filename, ".tmp", NULL);
+      if (job->format == HD_SCREENSHOT_PVR)
+        job->saved = hd_pvr_texture_save (tmp, pixbuf, &error);
+      else
+        job->saved = gdk_pixbuf_save (pixbuf, tmp, "png", &error, NULL);
+      g_object_unref (pixbuf);
+
+      if (job->saved && g_rename (tmp, job->filename) != 0)
+        {
+          g_warning ("%s: couldn't rename '%s'", __FUNCTION__, tmp);
+          job->saved = FALSE;
+        }
+      if (!job->saved)
+        g_unlink (tmp);
+      g_free (tmp);
+
+      if (error)
+        {
+          g_warning ("%s: saving '%s' failed: %s", __FUNCTION__,
+                     job->filename, error->message);
+          g_error_free (error);
+        }
+    }
+
+  g_idle_add (hd_screenshot_done_idle, job);
+}
+
+/* Have @job finished by the worker thread. */
+static void
+hd_screenshot_push (HdScreenshotJob *job)
+{
+  static GThreadPool *pool;
+
+  /* One thread is enough, we don't want to compete with the compositor. */
+  if (!pool && !hd_disable_threads ())
+    pool = g_thread_pool_new (hd_screenshot_encode, NULL, 1, FALSE, NULL);
+  if (pool)
+    g_thread_pool_push (pool, job, NULL);
+  else
+    hd_screenshot_encode (job, NULL);
+}
+
+/*
+ * Save the contents of @drawable (@width x @height, @depth bits deep) to
+ * @filename in @format.  The pixels are captured right away, the rest is
+ * done in the background and @callback is called when it's finished.
+ * Returns %FALSE if the drawable couldn't be captured or @filename is
+ * already being saved; @callback is not called then.
+ */
+gboolean
+hd_screenshot_save (Display *xdpy, Drawable drawable,
+                    guint depth, guint width, guint height,
+                    const gchar *filename, HdScreenshotFormat format,
+                    HdScreenshotCallback callback, gpointer user_data)
+{
+  HdScreenshotJob *job;
+
+  if (hd_screenshot_is_pending (filename))
+    {
+      g_debug ("%s: '%s' is already being saved", __FUNCTION__, filename);
+      return FALSE;
+    }
+
+  job = g_new0 (HdScreenshotJob, 1);
+  job->width  = width;
+  job->height = height;
+  if (!hd_screenshot_grab (job, xdpy, drawable, depth))
+    {
+      g_warning ("%s: couldn't capture drawable 0x%lx", __FUNCTION__,
+                 drawable);
+      g_free (job);
+      return FALSE;
+    }
+
+  job->filename  = g_strdup (filename);
+  job->format    = format;
+  job->callback  = callback;
+  job->user_data = user_data;
+
+  if (!pending)
+    pending = g_hash_table_new (g_str_hash, g_str_equal);
+  g_hash_table_insert (pending, job->filename, job);
+
+  hd_screenshot_push (job);
+  return TRUE;
+}
+
+/*
+ * Scale down the contents of @drawable to @snap_width x @snap_height
+ * in memory and hand them to @callback.  Like hd_screenshot_save() the
+ * pixels are captured right away and the scaling is done in the
+ * background.  Returns %FALSE if the drawable couldn't be captured,
+ * in which case @callback is not called.
+ */
+gboolean
+hd_screenshot_snapshot (Display *xdpy, Drawable drawable,
+                        guint depth, guint width, guint height,
+                        guint snap_width, guint snap_height,
+                        HdSnapshotCallback callback, gpointer user_data)
+{
+  HdScreenshotJob *job;
+
+  g_return_val_if_fail (callback != NULL, FALSE);
+  g_return_val_if_fail (snap_width > 0 && snap_height > 0, FALSE);
+
+  job = g_new0 (HdScreenshotJob, 1);
+  job->width  = width;
+  job->height = height;
+  if (!hd_screenshot_grab (job, xdpy, drawable, depth))
+    {
+      g_debug ("%s: couldn't capture drawable 0x%lx", __FUNCTION__,
+               drawable);
+      g_free (job);
+      return FALSE;
+    }
+
+  job->snap_width    = snap_width;
+  job->snap_height   = snap_height;
+  job->snap_callback = callback;
+  job->user_data     = user_data;
+
+  hd_screenshot_push (job);
+  return TRUE;
+}
+
+/* Is @filename being written by hd_screenshot_save()? */
+gboolean
+hd_screenshot_is_pending (const gchar *filename)
+{
+  return pending && g_hash_table_lookup (pending, filename) != NULL;
+}
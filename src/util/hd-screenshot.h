@@ -0,0 +1,67 @@
+/*
+ * This file is part of hildon-desktop
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef __HD_SCREENSHOT_H__
+#define __HD_SCREENSHOT_H__
+
+#include <X11/Xlib.h>
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+typedef enum
+{
+  HD_SCREENSHOT_PNG,
+  HD_SCREENSHOT_PVR,
+} HdScreenshotFormat;
+
+/* Called in the main thread when the screenshot has been written to
+ * @filename, or writing it failed. */
+typedef void (*HdScreenshotCallback) (const gchar *filename,
+                                      gboolean     saved,
+                                      gpointer     user_data);
+
+/* Called in the main thread with the downscaled snapshot, which is yours,
+ * or %NULL if it couldn't be made. */
+typedef void (*HdSnapshotCallback) (GdkPixbuf *pixbuf,
+                                    gpointer   user_data);
+
+gboolean hd_screenshot_save (Display              *xdpy,
+                             Drawable              drawable,
+                             guint                 depth,
+                             guint                 width,
+                             guint                 height,
+                             const gchar          *filename,
+                             HdScreenshotFormat    format,
+                             HdScreenshotCallback  callback,
+                             gpointer              user_data);
+gboolean hd_screenshot_is_pending (const gchar *filename);
+
+gboolean hd_screenshot_snapshot (Display              *xdpy,
+                                 Drawable              drawable,
+                                 guint                 depth,
+                                 guint                 width,
+                                 guint                 height,
+                                 guint                 snap_width,
+                                 guint                 snap_height,
+                                 HdSnapshotCallback    callback,
+                                 gpointer              user_data);
+
+#endif
@@ -47,6 +47,7 @@
 #include "hd-app.h"
 #include "hd-util.h"
 #include "hd-dbus.h"
+#include "launcher/hd-launch-trace.h"
 
 /* The master of puppets */
 #define TRANSITIONS_INI             "/usr/share/hildon-desktop/transitions.ini"
@@ -1029,6 +1030,14 @@ hd_transition_fade(HdCompMgr                  *mgr,
   on_fade_timeline_new_frame(data->timeline, 0, data);
   clutter_timeline_start (data->timeline);
 }
+
+/* The application being started is on the screen now. */
+static void
+hd_transition_loading_screen_gone (ClutterTimeline *timeline, gpointer data)
+{
+  hd_launch_trace_mark (NULL, HD_LAUNCH_TRACE_SHOWN);
+}
+
 void
 hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
 {
@@ -1039,7 +1048,10 @@ hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
     /* If duration is <=0 we just return as the loading screen is already
      * removed */
     if (duration<=0)
-      return;
+      {
+        hd_launch_trace_mark (NULL, HD_LAUNCH_TRACE_SHOWN);
+        return;
+      }
 
     data = g_new0 (HDEffectData, 1);
     data->event = MBWMCompMgrClientEventUnmap;
@@ -1063,6 +1075,8 @@ hd_transition_fade_out_loading_screen(ClutterActor *loading_image)
 
     g_signal_connect (data->timeline, "new-frame",
                           G_CALLBACK (on_fade_timeline_new_frame), data);
+    g_signal_connect (data->timeline, "completed",
+                          G_CALLBACK (hd_transition_loading_screen_gone), NULL);
     g_signal_connect (data->timeline, "completed",
                           G_CALLBACK (hd_transition_completed), data);
     clutter_container_add_actor (
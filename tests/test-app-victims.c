@@ -0,0 +1,276 @@
+/*
+ * This file is part of hildon-desktop tests
+ *
+ * Copyright (C) 2008 Nokia Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+/* Checks how hd-app-victims.c scores applications and orders them,
+ * with made-up smaps_rollup and statm files instead of /proc.
+ * The running applications are faked by the stubs below. */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* mkdtemp() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "hd-app-victims.h"
+
+#define PAGE_SIZE 4096
+
+typedef struct
+{
+  GPid         pid;
+  time_t       last_used;
+  guint        launch_cost;
+  const gchar *id;
+} FakeApp;
+
+HdLauncherApp *
+hd_running_app_get_launcher_app (HdRunningApp *app)
+{
+  return NULL;
+}
+
+GPid
+hd_running_app_get_pid (HdRunningApp *app)
+{
+  return ((FakeApp *) app)->pid;
+}
+
+time_t
+hd_running_app_get_last_used (HdRunningApp *app)
+{
+  return ((FakeApp *) app)->last_used;
+}
+
+guint
+hd_running_app_get_launch_cost (HdRunningApp *app)
+{
+  return ((FakeApp *) app)->launch_cost;
+}
+
+const gchar *
+hd_running_app_get_id (HdRunningApp *app)
+{
+  return ((FakeApp *) app)->id;
+}
+
+gint
+hd_launcher_app_get_priority (HdLauncherApp *app)
+{
+  return 0;
+}
+
+static const gchar *rollup_fmt =
+  "00008000-bef3c000 ---p 00000000 00:00 0                [rollup]\n"
+  "Rss:               %u kB\n"
+  "Pss:               %u kB\n"
+  "Shared_Clean:       812 kB\n";
+
+static void
+test_parse (void)
+{
+  gchar *rollup;
+
+  rollup = g_strdup_printf (rollup_fmt, 9000, 12345);
+  g_assert (hd_app_victims_parse_footprint (rollup, NULL, PAGE_SIZE)
+            == 12345);
+  /* smaps_rollup wins over statm */
+  g_assert (hd_app_victims_parse_footprint (rollup, "1000 600 200",
+                                            PAGE_SIZE) == 12345);
+  g_free (rollup);
+
+  /* (resident - shared) pages */
+  g_assert (hd_app_victims_parse_footprint (NULL, "1000 600 200 10 0 300 0\n",
+                                            PAGE_SIZE) == 400 * 4);
+  rollup = g_strdup_printf (rollup_fmt, 0, 0);
+  g_assert (hd_app_victims_parse_footprint (rollup, "1000 600 200",
+                                            PAGE_SIZE) == 400 * 4);
+  g_free (rollup);
+
+  g_assert (hd_app_victims_parse_footprint (NULL, "1000 200 600",
+                                            PAGE_SIZE) == 0);
+  g_assert (hd_app_victims_parse_footprint ("garbage", "garbage",
+                                            PAGE_SIZE) == 0);
+  g_assert (hd_app_victims_parse_footprint (NULL, NULL, PAGE_SIZE) == 0);
+}
+
+static void
+test_score (void)
+{
+  time_t now = 1000000;
+
+  /* More memory is better. */
+  g_assert (hd_app_victims_compute_score (20000, 1000, now - 60, now, 0)
+            > hd_app_victims_compute_score (10000, 1000, now - 60, now, 0));
+  /* Left alone for longer is better. */
+  g_assert (hd_app_victims_compute_score (10000, 1000, now - 600, now, 0)
+            > hd_app_victims_compute_score (10000, 1000, now - 60, now, 0));
+  g_assert (hd_app_victims_compute_score (10000, 1000, 0, now, 0)
+            > hd_app_victims_compute_score (10000, 1000, now - 600, now, 0));
+  /* Cheaper to start again is better. */
+  g_assert (hd_app_victims_compute_score (10000, 500, now - 60, now, 0)
+            > hd_app_victims_compute_score (10000, 5000, now - 60, now, 0));
+  /* Higher priority is worse. */
+  g_assert (hd_app_victims_compute_score (10000, 1000, now - 60, now, 0)
+            > hd_app_victims_compute_score (10000, 1000, now - 60, now, 2));
+  /* Unknown cost is taken as the default. */
+  g_assert (hd_app_victims_compute_score (10000, 0, now - 60, now, 0)
+            == hd_app_victims_compute_score (10000, 2000, now - 60, now, 0));
+  /* Used in the future (clock changes) is like just used. */
+  g_assert (hd_app_victims_compute_score (10000, 1000, now + 60, now, 0)
+            == hd_app_victims_compute_score (10000, 1000, now, now, 0));
+  g_assert (hd_app_victims_compute_score (0, 1000, now, now, 0) == 0);
+}
+
+/* Write the made-up /proc/@pid/@fname. */
+static void
+write_proc (const gchar *root, GPid pid, const gchar *fname,
+            const gchar *contents)
+{
+  gchar *dir, *path;
+
+  dir = g_strdup_printf ("%s/%d", root, pid);
+  g_mkdir (dir, 0700);
+  path = g_build_filename (dir, fname, NULL);
+  g_assert (g_file_set_contents (path, contents, -1, NULL));
+  g_free (path);
+  g_free (dir);
+}
+
+static void
+remove_proc (const gchar *root, GPid pid)
+{
+  gchar *path;
+
+  path = g_strdup_printf ("%s/%d/smaps_rollup", root, pid);
+  g_remove (path);
+  g_free (path);
+  path = g_strdup_printf ("%s/%d/statm", root, pid);
+  g_remove (path);
+  g_free (path);
+  path = g_strdup_printf ("%s/%d", root, pid);
+  g_rmdir (path);
+  g_free (path);
+}
+
+static void
+test_heap (void)
+{
+  /* In the order they should be picked.  "never-used" goes before
+   * "big", which was used ten minutes ago, and "recent", which was just
+   * used, goes last. */
+  static FakeApp apps[] =
+    {
+      { 101, 0, 1000, "never-used" },
+      { 102, 0, 1000, "big" },
+      { 103, 0, 1000, "medium" },
+      { 104, 0, 1000, "small" },
+      { 105, 0, 1000, "tiny" },
+      { 106, 0, 1000, "recent" },
+    };
+  static const guint pss[] = { 30000, 40000, 20000, 10000, 5000, 0 };
+  gchar root[] = "/tmp/test-app-victims-XXXXXX";
+  HdAppVictims *victims;
+  time_t now;
+  guint i;
+
+  g_assert (mkdtemp (root) != NULL);
+  hd_app_victims_set_proc_root (root);
+
+  now = time (NULL);
+  for (i = 0; i < G_N_ELEMENTS (apps); i++)
+    {
+      gchar *contents;
+
+      if (i > 0)
+        apps[i].last_used = now - 600;
+      if (pss[i])
+        {
+          contents = g_strdup_printf (rollup_fmt, pss[i] * 2, pss[i]);
+          write_proc (root, apps[i].pid, "smaps_rollup", contents);
+        }
+      else
+        { /* Only statm, 8 MB unshared, more than "tiny", but just used. */
+          apps[i].last_used = now;
+          contents = g_strdup ("30000 2200 200 10 0 9000 0\n");
+          write_proc (root, apps[i].pid, "statm", contents);
+        }
+      g_free (contents);
+    }
+
+  /* Added in a scrambled order. */
+  victims = hd_app_victims_new ();
+  for (i = 0; i < G_N_ELEMENTS (apps); i++)
+    hd_app_victims_add (victims,
+                (HdRunningApp *) &apps[(i * 5 + 3) % G_N_ELEMENTS (apps)]);
+  /* Adding twice does nothing. */
+  hd_app_victims_add (victims, (HdRunningApp *) &apps[2]);
+
+  /* The footprints read for scoring are kept. */
+  g_assert (hd_app_victims_get_app_footprint (victims,
+                                              (HdRunningApp *) &apps[1])
+            == 40000);
+  g_assert (hd_app_victims_get_app_footprint (victims,
+                                              (HdRunningApp *) &apps[5])
+            == (2200 - 200) * (sysconf (_SC_PAGESIZE) / 1024));
+
+  /* Removing from the middle keeps the heap in order. */
+  hd_app_victims_remove (victims, (HdRunningApp *) &apps[3]);
+  g_assert (hd_app_victims_get_app_footprint (victims,
+                                              (HdRunningApp *) &apps[3])
+            == 0);
+  for (i = 0; i < G_N_ELEMENTS (apps); i++)
+    {
+      HdRunningApp *victim;
+
+      if (i == 3)
+        continue;
+      victim = hd_app_victims_peek (victims);
+      if (victim != (HdRunningApp *) &apps[i])
+        {
+          fprintf (stderr, "expected %s, got %s\n", apps[i].id,
+                   victim ? hd_running_app_get_id (victim) : "nothing");
+          exit (1);
+        }
+      hd_app_victims_remove (victims, victim);
+    }
+  g_assert (hd_app_victims_peek (victims) == NULL);
+  hd_app_victims_free (victims);
+
+  for (i = 0; i < G_N_ELEMENTS (apps); i++)
+    remove_proc (root, apps[i].pid);
+  g_rmdir (root);
+  hd_app_victims_set_proc_root (NULL);
+}
+
+int
+main (int argc, char **argv)
+{
+  test_parse ();
+  test_score ();
+  test_heap ();
+
+  printf ("test-app-victims: all passed\n");
+  return 0;
+}